@@ -0,0 +1,163 @@
+/**************************************************************
+
+   candidate_table.cpp - Column storage for get_mode candidates
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#include "candidate_table.h"
+
+//============================================================
+//  candidate_table::clear
+//============================================================
+
+void candidate_table::clear()
+{
+	m_hactive.clear();
+	m_vactive.clear();
+	m_vfreq.clear();
+	m_interlace.clear();
+	m_type.clear();
+}
+
+//============================================================
+//  candidate_table::add
+//============================================================
+
+void candidate_table::add(int hactive, int vactive, double vfreq, int interlace, int type)
+{
+	m_hactive.push_back(hactive);
+	m_vactive.push_back(vactive);
+	m_vfreq.push_back(vfreq);
+	m_interlace.push_back(interlace);
+	m_type.push_back(type);
+}
+
+//============================================================
+//  candidate_table::compute_bounds
+//============================================================
+
+void candidate_table::compute_bounds(const modeline *s_mode, const monitor_range *range, const generator_settings *cs)
+{
+	size_t n = size();
+
+	m_bounds.resize(MAX_RANGES * n);
+	m_v_scale.resize(n);
+	m_y_progressive.resize(n);
+	m_y_interlaced.resize(n);
+	m_y_scale.resize(n);
+	m_yres.resize(n);
+	m_borders.resize(n);
+	m_scan_factor.resize(n);
+	m_vfreq_max.resize(n);
+
+	for (int i = 0; i < MAX_RANGES; i++)
+		if (range[i].hfreq_min != 0)
+			range_bounds(s_mode, &range[i], cs, &m_bounds[i * n]);
+}
+
+//============================================================
+//  candidate_table::range_bounds
+//============================================================
+
+void candidate_table::range_bounds(const modeline *s_mode, const monitor_range *range, const generator_settings *cs, int *bound)
+{
+	// This is modeline_lower_bound turned inside out: each step runs for all the entries,
+	// computing both branches where the scalar code would only take one
+	size_t n = size();
+
+	scale_into_range_batch(m_vfreq.data(), range->vfreq_min, range->vfreq_max, m_v_scale.data(), n);
+	scale_into_range_batch(m_vactive.data(), range->progressive_lines_min, range->progressive_lines_max, m_y_progressive.data(), n);
+	scale_into_range_batch(m_vactive.data(), range->interlaced_lines_min, range->interlaced_lines_max, m_y_interlaced.data(), n);
+
+	// Pick the scan, and the height we'd need to reach the refresh at
+	for (size_t i = 0; i < n; i++)
+	{
+		int type = m_type[i];
+		int y_scale = 0;
+		double interlace = 1;
+		double doublescan = 1;
+
+		if (range->progressive_lines_min && (!m_interlace[i] || (type & SCAN_EDITABLE)))
+			y_scale = m_y_progressive[i];
+
+		if (!y_scale && range->interlaced_lines_min && cs->interlace && (m_interlace[i] || (type & SCAN_EDITABLE)))
+		{
+			y_scale = m_y_interlaced[i];
+			interlace = 2;
+		}
+		m_y_scale[i] = y_scale;
+
+		if (cs->doublescan && y_scale % 2 == 0)
+		{
+			y_scale /= 2;
+			doublescan = 0.5;
+		}
+
+		m_borders[i] = cs->v_shift_correct? (range->progressive_lines_max - m_vactive[i] * y_scale / interlace) * (1.0 / range->hfreq_min) / 2 : 0;
+		m_yres[i] = m_vactive[i] * y_scale;
+		m_scan_factor[i] = interlace * doublescan;
+	}
+
+	max_vfreq_for_yres_batch(m_yres.data(), range, m_borders.data(), m_scan_factor.data(), m_vfreq_max.data(), n);
+
+	for (size_t i = 0; i < n; i++)
+	{
+		int type = m_type[i];
+		int y_scale = m_y_scale[i];
+		int weight = 0;
+
+		if (m_v_scale[i] != 1 && !(type & V_FREQ_EDITABLE))
+		{
+			bound[i] = R_OUT_OF_RANGE;
+			continue;
+		}
+
+		if (y_scale == 1 || (y_scale > 1 && (type & Y_RES_EDITABLE)))
+		{
+			if (!(type & V_FREQ_EDITABLE))
+			{
+				double vfreq = m_vfreq[i] * m_v_scale[i];
+				double vfreq_real = vfreq < m_vfreq_max[i]? vfreq : m_vfreq_max[i];
+				if (vfreq_real != vfreq)
+				{
+					bound[i] = R_OUT_OF_RANGE;
+					continue;
+				}
+			}
+
+			if (!(type & Y_RES_EDITABLE))
+			{
+				double y_ratio = double(m_vactive[i]) * y_scale / s_mode->vactive;
+				if (!(y_ratio >= 1.0 && y_ratio < 16.0))
+					weight |= R_RES_STRETCH;
+			}
+		}
+		else if (type & Y_RES_EDITABLE)
+			weight |= R_RES_STRETCH;
+		else
+		{
+			bound[i] = R_OUT_OF_RANGE;
+			continue;
+		}
+
+		if (!(type & X_RES_EDITABLE) && m_hactive[i] < s_mode->hactive)
+			weight |= R_RES_STRETCH;
+
+		if (!(type & V_FREQ_EDITABLE))
+		{
+			double v_diff = m_vfreq[i] - s_mode->vfreq;
+			if (v_diff < -cs->refresh_tolerance || (!(type & Y_RES_EDITABLE) && fabs(v_diff) > cs->refresh_tolerance))
+				weight |= R_V_FREQ_OFF;
+		}
+
+		bound[i] = weight;
+	}
+}
@@ -0,0 +1,60 @@
+/**************************************************************
+
+   candidate_table.h - Column storage for get_mode candidates
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#ifndef __CANDIDATE_TABLE_H__
+#define __CANDIDATE_TABLE_H__
+
+#include <vector>
+#include "modeline.h"
+
+// The fields of each mode that matter before modeline_create, one contiguous array
+// per field, so the range checks can run in batches instead of mode by mode
+class candidate_table
+{
+public:
+
+	void clear();
+	void add(int hactive, int vactive, double vfreq, int interlace, int type);
+	size_t size() const { return m_type.size(); }
+
+	// modeline_lower_bound of every entry, for all the ranges in use
+	void compute_bounds(const modeline *s_mode, const monitor_range *range, const generator_settings *cs);
+	int bound(int range, size_t i) const { return m_bounds[range * size() + i]; }
+
+private:
+
+	// columns
+	std::vector<int> m_hactive;
+	std::vector<int> m_vactive;
+	std::vector<double> m_vfreq;
+	std::vector<int> m_interlace;
+	std::vector<int> m_type;
+
+	// results, MAX_RANGES rows of size() entries
+	std::vector<int> m_bounds;
+
+	// scratch columns for the kernels
+	std::vector<int> m_v_scale;
+	std::vector<int> m_y_progressive;
+	std::vector<int> m_y_interlaced;
+	std::vector<int> m_y_scale;
+	std::vector<int> m_yres;
+	std::vector<double> m_borders;
+	std::vector<double> m_scan_factor;
+	std::vector<double> m_vfreq_max;
+
+	void range_bounds(const modeline *s_mode, const monitor_range *range, const generator_settings *cs, int *bound);
+};
+
+#endif
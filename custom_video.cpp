@@ -132,6 +132,28 @@ bool custom_video::get_timing(modeline *mode)
 	return false;
 }
 
+//============================================================
+//  custom_video::get_timings
+//============================================================
+
+bool custom_video::get_timings(std::vector<modeline> &modes)
+{
+	// Generic fallback: loop through all modes until NULL mode type is received
+	for (;;)
+	{
+		modeline mode = {};
+
+		// get next mode
+		get_timing(&mode);
+		if (mode.type == 0)
+			break;
+
+		modes.push_back(mode);
+	}
+
+	return true;
+}
+
 //============================================================
 //  custom_video::set_timing
 //============================================================
@@ -141,6 +163,26 @@ bool custom_video::set_timing(modeline *)
 	return false;
 }
 
+//============================================================
+//  custom_video::update_timing
+//============================================================
+
+bool custom_video::update_timing(modeline *mode)
+{
+	// No cheaper path than a full mode switch
+	return set_timing(mode);
+}
+
+//============================================================
+//  custom_video::test_mode
+//============================================================
+
+bool custom_video::test_mode(modeline *)
+{
+	// Backends that can't validate timings accept everything
+	return true;
+}
+
 //============================================================
 //  custom_video::add_mode
 //============================================================
@@ -177,6 +219,100 @@ bool custom_video::process_modelist(std::vector<modeline *>)
 	return false;
 }
 
+//============================================================
+//  custom_video::apply_modelist
+//============================================================
+
+// Applies the whole change set or none of it: on the first failure, the changes
+// already made are undone in reverse order, leaving the driver as it was
+bool custom_video::apply_modelist(std::vector<modeline *> &modelist)
+{
+	std::vector<modeline> previous(modelist.size());
+	bool saved = false;
+	bool result = true;
+	size_t applied;
+
+	m_modelist_results.clear();
+	m_modelist_results.reserve(modelist.size());
+	for (auto &mode : modelist)
+		m_modelist_results.push_back({ mode, MODELIST_SKIPPED });
+
+	for (applied = 0; applied < modelist.size(); applied++)
+	{
+		modeline *mode = modelist[applied];
+
+		if (mode->type & MODE_DELETE)
+			result = delete_mode(mode);
+
+		else if (mode->type & MODE_ADD)
+			result = add_mode(mode);
+
+		// Don't update a mode unless we know how to put it back
+		else if (mode->type & MODE_UPDATE)
+			result = (saved = save_mode(mode, &previous[applied])) && update_mode(mode);
+
+		if (!result)
+			break;
+
+		mode->type &= ~MODE_ERROR;
+		m_modelist_results[applied].status = MODELIST_APPLIED;
+	}
+
+	if (result)
+		return true;
+
+	modeline *failed = modelist[applied];
+	failed->type |= MODE_ERROR;
+	m_modelist_results[applied].status = MODELIST_FAILED;
+	log_error("%s: mode %dx%d@%.6f failed, rolling back %d changes\n", api_name(), failed->hactive, failed->vactive, failed->vfreq, (int)applied);
+
+	// An update can fail halfway, with the old timings already gone
+	if ((failed->type & MODE_UPDATE) && !(failed->type & (MODE_DELETE | MODE_ADD)) && saved && !restore_mode(failed, &previous[applied]))
+		log_error("%s: could not restore mode %dx%d@%.6f\n", api_name(), previous[applied].hactive, previous[applied].vactive, previous[applied].vfreq);
+
+	while (applied-- > 0)
+	{
+		modeline *mode = modelist[applied];
+		bool undone;
+
+		if (mode->type & MODE_DELETE)
+			undone = add_mode(mode);
+
+		else if (mode->type & MODE_ADD)
+			undone = delete_mode(mode);
+
+		else
+			undone = restore_mode(mode, &previous[applied]);
+
+		if (undone)
+			m_modelist_results[applied].status = MODELIST_ROLLED_BACK;
+		else
+			log_error("%s: could not roll back mode %dx%d@%.6f\n", api_name(), mode->hactive, mode->vactive, mode->vfreq);
+	}
+
+	return false;
+}
+
+//============================================================
+//  custom_video::save_mode
+//============================================================
+
+// Backends using apply_modelist report here the timings the driver has for a mode
+// about to be updated, so the update can be undone
+bool custom_video::save_mode(modeline *, modeline *)
+{
+	return false;
+}
+
+//============================================================
+//  custom_video::restore_mode
+//============================================================
+
+bool custom_video::restore_mode(modeline *, modeline *previous)
+{
+	return update_mode(previous);
+}
+
 //============================================================
 //  custom_video::get_resource
 //============================================================
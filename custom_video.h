@@ -41,12 +41,27 @@
 #define TIMING_UPDATE      0x004
 #define TIMING_UPDATE_LIST 0x008
 
+// Outcome of each mode in the last process_modelist call
+#define MODELIST_APPLIED     0
+#define MODELIST_FAILED      1
+#define MODELIST_ROLLED_BACK 2
+#define MODELIST_SKIPPED     3
+
+typedef struct modelist_result
+{
+	modeline *mode;
+	int status;
+} modelist_result;
+
 typedef struct custom_video_settings
 {
 	bool screen_compositing;
 	bool screen_reordering;
 	bool allow_hardware_refresh;
 	bool kms_modesetting;
+	int kms_fb_pool_size;
+	bool kms_atomic;
+	char kms_vrr[32];
 	char device_reg_key[128];
 	char custom_timing[256];
 } custom_video_settings;
@@ -69,21 +84,32 @@ public:
 	virtual const char *api_name() { return "empty"; }
 	virtual bool init();
 	virtual int caps() { return 0; }
+	virtual uint64_t pclock_step() { return 0; }
 
 	virtual bool add_mode(modeline *mode);
 	virtual bool delete_mode(modeline *mode);
 	virtual bool update_mode(modeline *mode);
 
 	virtual bool get_timing(modeline *mode);
+	virtual bool get_timings(std::vector<modeline> &modes);
 	virtual bool set_timing(modeline *mode);
+	// Switch to timings with the same active size and scan as the ones on screen
+	virtual bool update_timing(modeline *mode);
+	virtual bool test_mode(modeline *mode);
+	// Refresh window of variable refresh, when the backend has turned it on
+	virtual bool vrr_range(double *, double *) { return false; }
 
 	virtual bool process_modelist(std::vector<modeline *>);
+	const std::vector<modelist_result> &modelist_results() { return m_modelist_results; }
 
 	// getters
 	bool screen_compositing() { return m_vs.screen_compositing; }
 	bool screen_reordering() { return m_vs.screen_reordering; }
 	bool allow_hardware_refresh() { return m_vs.allow_hardware_refresh; }
 	const char *custom_timing() { return (const char*) &m_vs.custom_timing; }
+	int kms_fb_pool_size() { return m_vs.kms_fb_pool_size; }
+	bool kms_atomic() { return m_vs.kms_atomic; }
+	const char *kms_vrr() { return (const char*) &m_vs.kms_vrr; }
 	virtual void *get_resource(const char *resource);
 
 	// setters
@@ -91,6 +117,9 @@ public:
 	void set_screen_reordering(bool value) { m_vs.screen_reordering = value; }
 	void set_allow_hardware_refresh(bool value) { m_vs.allow_hardware_refresh = value; }
 	void set_custom_timing(const char *custom_timing) { strncpy(m_vs.custom_timing, custom_timing, sizeof(m_vs.custom_timing)-1); }
+	void set_kms_fb_pool_size(int value) { m_vs.kms_fb_pool_size = value; }
+	void set_kms_atomic(bool value) { m_vs.kms_atomic = value; }
+	void set_kms_vrr(const char *value) { strncpy(m_vs.kms_vrr, value, sizeof(m_vs.kms_vrr)-1); }
 
 	// options
 	custom_video_settings m_vs = {};
@@ -98,6 +127,13 @@ public:
 	modeline m_user_mode = {};
 	modeline m_backup_mode = {};
 
+protected:
+	bool apply_modelist(std::vector<modeline *> &modelist);
+	virtual bool save_mode(modeline *mode, modeline *previous);
+	virtual bool restore_mode(modeline *mode, modeline *previous);
+
+	std::vector<modelist_result> m_modelist_results;
+
 private:
 
 	custom_video *m_custom_video = 0;
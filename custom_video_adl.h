@@ -148,6 +148,7 @@ class adl_timing : public custom_video
 		bool init();
 		void close();
 		int caps() { return allow_hardware_refresh()? CUSTOM_VIDEO_CAPS_UPDATE | CUSTOM_VIDEO_CAPS_ADD | CUSTOM_VIDEO_CAPS_DESKTOP_EDITABLE : is_patched? CUSTOM_VIDEO_CAPS_UPDATE : 0; }
+		uint64_t pclock_step() { return 10000; } // sPixelClock is in 10 kHz units
 
 		bool add_mode(modeline *mode);
 		bool delete_mode(modeline *mode);
@@ -28,6 +28,7 @@ class ati_timing : public custom_video
 		const char *api_name() { return "ATI Legacy"; }
 		bool init();
 		int caps() { return CUSTOM_VIDEO_CAPS_UPDATE | CUSTOM_VIDEO_CAPS_SCAN_EDITABLE; }
+		uint64_t pclock_step() { return 10000; } // the pixel clock is stored in 10 kHz units
 
 		bool update_mode(modeline *mode);
 
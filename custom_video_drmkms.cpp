@@ -21,7 +21,9 @@
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <dirent.h>
+#include <errno.h>
 #include "custom_video_drmkms.h"
+#include "edid.h"
 #include "log.h"
 #include "switchres_defines.h"
 
@@ -52,6 +54,21 @@
 #define drmIsMaster p_drmIsMaster
 #define drmSetMaster p_drmSetMaster
 #define drmDropMaster p_drmDropMaster
+#define drmSetClientCap p_drmSetClientCap
+#define drmModeGetPlane p_drmModeGetPlane
+#define drmModeFreePlane p_drmModeFreePlane
+#define drmModeObjectGetProperties p_drmModeObjectGetProperties
+#define drmModeFreeObjectProperties p_drmModeFreeObjectProperties
+#define drmModeGetProperty p_drmModeGetProperty
+#define drmModeFreeProperty p_drmModeFreeProperty
+#define drmModeCreatePropertyBlob p_drmModeCreatePropertyBlob
+#define drmModeDestroyPropertyBlob p_drmModeDestroyPropertyBlob
+#define drmModeAtomicAlloc p_drmModeAtomicAlloc
+#define drmModeAtomicFree p_drmModeAtomicFree
+#define drmModeAtomicAddProperty p_drmModeAtomicAddProperty
+#define drmModeAtomicCommit p_drmModeAtomicCommit
+#define drmModeGetPropertyBlob p_drmModeGetPropertyBlob
+#define drmModeFreePropertyBlob p_drmModeFreePropertyBlob
 
 # define MAX_CARD_ID 10
 # define MAX_DRM_DEVICES 16
@@ -84,6 +101,21 @@ static int s_shared_count[MAX_CARD_ID] = {};
 
 static unsigned int s_shared_conn[MAX_CARD_ID] = {};
 
+//============================================================
+//  compare the timings of two drm modes
+//============================================================
+
+static bool drm_same_htimings(const drmModeModeInfo *a, const drmModeModeInfo *b)
+{
+	return a->clock == b->clock && a->hdisplay == b->hdisplay && a->hsync_start == b->hsync_start && a->hsync_end == b->hsync_end
+		&& a->htotal == b->htotal && a->hskew == b->hskew && a->vdisplay == b->vdisplay && a->flags == b->flags;
+}
+
+static bool drm_same_timings(const drmModeModeInfo *a, const drmModeModeInfo *b)
+{
+	return drm_same_htimings(a, b) && a->vsync_start == b->vsync_start && a->vsync_end == b->vsync_end && a->vtotal == b->vtotal && a->vscan == b->vscan;
+}
+
 //============================================================
 //  id for class object (static)
 //============================================================
@@ -296,6 +328,12 @@ drmkms_timing::~drmkms_timing()
 		}
 	}
 
+	// Release pooled frame buffers, except the one on screen if any
+	for (int i = 0; i < (int)m_fb_pool.size(); i++)
+		if (i != m_fb_current)
+			free_framebuffer(&m_fb_pool[i]);
+	m_fb_pool.clear();
+
 	// Free the connector used
 	s_shared_conn[m_id] = -1;
 
@@ -617,6 +655,19 @@ bool drmkms_timing::init()
 							{
 								m_crtc_idx = e;
 								log_verbose("DRM/KMS: <%d> (init) desktop mode name %s crtc %d crtc_idx %d fb %d valid %d\n", m_id, mp_crtc_desktop->mode.name, mp_crtc_desktop->crtc_id, m_crtc_idx, mp_crtc_desktop->buffer_id, mp_crtc_desktop->mode_valid);
+
+								// Our frame buffers take the format of the desktop one. It's missing when
+								// the console is not active on the output, then use the usual format
+								drmModeFB *pframebuffer = drmModeGetFB(m_drm_fd, mp_crtc_desktop->buffer_id);
+								if (pframebuffer)
+								{
+									m_desktop_bpp = pframebuffer->bpp;
+									m_desktop_depth = pframebuffer->depth;
+									drmModeFreeFB(pframebuffer);
+								}
+								else
+									log_verbose("DRM/KMS: <%d> (init) <debug> can't get the desktop frame buffer, using defaults\n", m_id);
+								log_verbose("DRM/KMS: <%d> (init) frame buffers bpp %d depth %d\n", m_id, m_desktop_bpp, m_desktop_depth);
 								break;
 							}
 							drmModeFreeCrtc(mp_crtc_desktop);
@@ -711,12 +762,294 @@ bool drmkms_timing::init()
 	else if (test_kernel_user_modes())
 		m_caps |= CUSTOM_VIDEO_CAPS_ADD;
 
+	// Atomic modesetting is only used when we set modes ourselves, variable refresh needs it
+	bool vrr_requested = m_vs.kms_vrr[0] && strcmp(m_vs.kms_vrr, "0");
+	if ((m_vs.kms_atomic || vrr_requested) && (m_caps & CUSTOM_VIDEO_CAPS_ADD))
+		m_atomic = init_atomic();
+
+	if (vrr_requested)
+	{
+		if (m_atomic)
+			m_vrr = init_vrr();
+		else
+			log_verbose("DRM/KMS: <%d> (init) [WARNING] variable refresh needs atomic modesetting, disabled\n", m_id);
+	}
+
 	if (drmIsMaster(m_drm_fd) and m_drm_fd != m_hook_fd)
 		drmDropMaster(m_drm_fd);
 
 	return true;
 }
 
+//============================================================
+//  drmkms_timing::init_atomic
+//============================================================
+
+bool drmkms_timing::init_atomic()
+{
+	p_drmSetClientCap = (__typeof__(drmSetClientCap)) dlsym(mp_drm_handle, "drmSetClientCap");
+	p_drmModeGetPlane = (__typeof__(drmModeGetPlane)) dlsym(mp_drm_handle, "drmModeGetPlane");
+	p_drmModeFreePlane = (__typeof__(drmModeFreePlane)) dlsym(mp_drm_handle, "drmModeFreePlane");
+	p_drmModeObjectGetProperties = (__typeof__(drmModeObjectGetProperties)) dlsym(mp_drm_handle, "drmModeObjectGetProperties");
+	p_drmModeFreeObjectProperties = (__typeof__(drmModeFreeObjectProperties)) dlsym(mp_drm_handle, "drmModeFreeObjectProperties");
+	p_drmModeGetProperty = (__typeof__(drmModeGetProperty)) dlsym(mp_drm_handle, "drmModeGetProperty");
+	p_drmModeFreeProperty = (__typeof__(drmModeFreeProperty)) dlsym(mp_drm_handle, "drmModeFreeProperty");
+	p_drmModeCreatePropertyBlob = (__typeof__(drmModeCreatePropertyBlob)) dlsym(mp_drm_handle, "drmModeCreatePropertyBlob");
+	p_drmModeDestroyPropertyBlob = (__typeof__(drmModeDestroyPropertyBlob)) dlsym(mp_drm_handle, "drmModeDestroyPropertyBlob");
+	p_drmModeAtomicAlloc = (__typeof__(drmModeAtomicAlloc)) dlsym(mp_drm_handle, "drmModeAtomicAlloc");
+	p_drmModeAtomicFree = (__typeof__(drmModeAtomicFree)) dlsym(mp_drm_handle, "drmModeAtomicFree");
+	p_drmModeAtomicAddProperty = (__typeof__(drmModeAtomicAddProperty)) dlsym(mp_drm_handle, "drmModeAtomicAddProperty");
+	p_drmModeAtomicCommit = (__typeof__(drmModeAtomicCommit)) dlsym(mp_drm_handle, "drmModeAtomicCommit");
+
+	if (!p_drmSetClientCap || !p_drmModeGetPlane || !p_drmModeFreePlane || !p_drmModeObjectGetProperties || !p_drmModeFreeObjectProperties ||
+		!p_drmModeGetProperty || !p_drmModeFreeProperty || !p_drmModeCreatePropertyBlob || !p_drmModeDestroyPropertyBlob ||
+		!p_drmModeAtomicAlloc || !p_drmModeAtomicFree || !p_drmModeAtomicAddProperty || !p_drmModeAtomicCommit)
+	{
+		log_verbose("DRM/KMS: <%d> (init_atomic) [WARNING] atomic functions missing in %s, using legacy modesetting\n", m_id, "DRM_LIBRARY");
+		return false;
+	}
+
+	if (drmSetClientCap(m_drm_fd, DRM_CLIENT_CAP_UNIVERSAL_PLANES, 1) || drmSetClientCap(m_drm_fd, DRM_CLIENT_CAP_ATOMIC, 1))
+	{
+		log_verbose("DRM/KMS: <%d> (init_atomic) [WARNING] driver doesn't support atomic modesetting, using legacy modesetting\n", m_id);
+		return false;
+	}
+
+	// Find the primary plane of our crtc
+	drmModePlaneRes *pplanes = drmModeGetPlaneResources(m_drm_fd);
+	for (unsigned int i = 0; pplanes && i < pplanes->count_planes && !m_plane_id; i++)
+	{
+		drmModePlane *pplane = drmModeGetPlane(m_drm_fd, pplanes->planes[i]);
+		if (!pplane)
+			continue;
+
+		if (pplane->possible_crtcs & (1 << m_crtc_idx))
+		{
+			drmModeObjectProperties *pprops = drmModeObjectGetProperties(m_drm_fd, pplane->plane_id, DRM_MODE_OBJECT_PLANE);
+			for (unsigned int p = 0; pprops && p < pprops->count_props; p++)
+			{
+				drmModePropertyRes *pprop = drmModeGetProperty(m_drm_fd, pprops->props[p]);
+				if (pprop && !strcmp(pprop->name, "type") && pprops->prop_values[p] == DRM_PLANE_TYPE_PRIMARY)
+					m_plane_id = pplane->plane_id;
+				drmModeFreeProperty(pprop);
+			}
+			drmModeFreeObjectProperties(pprops);
+		}
+		drmModeFreePlane(pplane);
+	}
+	drmModeFreePlaneResources(pplanes);
+
+	if (!m_plane_id)
+	{
+		log_verbose("DRM/KMS: <%d> (init_atomic) [WARNING] no primary plane found for crtc %d, using legacy modesetting\n", m_id, mp_crtc_desktop->crtc_id);
+		return false;
+	}
+
+	m_prop_conn_crtc_id = get_property_id(m_desktop_output, DRM_MODE_OBJECT_CONNECTOR, "CRTC_ID");
+	m_prop_crtc_mode_id = get_property_id(mp_crtc_desktop->crtc_id, DRM_MODE_OBJECT_CRTC, "MODE_ID");
+	m_prop_crtc_active = get_property_id(mp_crtc_desktop->crtc_id, DRM_MODE_OBJECT_CRTC, "ACTIVE");
+	m_prop_plane_fb_id = get_property_id(m_plane_id, DRM_MODE_OBJECT_PLANE, "FB_ID");
+	m_prop_plane_crtc_id = get_property_id(m_plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_ID");
+	m_prop_plane_src_x = get_property_id(m_plane_id, DRM_MODE_OBJECT_PLANE, "SRC_X");
+	m_prop_plane_src_y = get_property_id(m_plane_id, DRM_MODE_OBJECT_PLANE, "SRC_Y");
+	m_prop_plane_src_w = get_property_id(m_plane_id, DRM_MODE_OBJECT_PLANE, "SRC_W");
+	m_prop_plane_src_h = get_property_id(m_plane_id, DRM_MODE_OBJECT_PLANE, "SRC_H");
+	m_prop_plane_crtc_x = get_property_id(m_plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_X");
+	m_prop_plane_crtc_y = get_property_id(m_plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_Y");
+	m_prop_plane_crtc_w = get_property_id(m_plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_W");
+	m_prop_plane_crtc_h = get_property_id(m_plane_id, DRM_MODE_OBJECT_PLANE, "CRTC_H");
+
+	if (!m_prop_conn_crtc_id || !m_prop_crtc_mode_id || !m_prop_crtc_active || !m_prop_plane_fb_id || !m_prop_plane_crtc_id ||
+		!m_prop_plane_src_x || !m_prop_plane_src_y || !m_prop_plane_src_w || !m_prop_plane_src_h ||
+		!m_prop_plane_crtc_x || !m_prop_plane_crtc_y || !m_prop_plane_crtc_w || !m_prop_plane_crtc_h)
+	{
+		log_verbose("DRM/KMS: <%d> (init_atomic) [WARNING] missing atomic properties, using legacy modesetting\n", m_id);
+		return false;
+	}
+
+	log_verbose("DRM/KMS: <%d> (init_atomic) atomic modesetting enabled, crtc %d plane %d\n", m_id, mp_crtc_desktop->crtc_id, m_plane_id);
+	return true;
+}
+
+//============================================================
+//  drmkms_timing::init_vrr
+//============================================================
+
+bool drmkms_timing::init_vrr()
+{
+	uint64_t vrr_capable = 0;
+	uint32_t edid_blob_id = 0;
+
+	drmModeObjectProperties *pprops = drmModeObjectGetProperties(m_drm_fd, m_desktop_output, DRM_MODE_OBJECT_CONNECTOR);
+	for (unsigned int p = 0; pprops && p < pprops->count_props; p++)
+	{
+		drmModePropertyRes *pprop = drmModeGetProperty(m_drm_fd, pprops->props[p]);
+		if (pprop && !strcmp(pprop->name, "vrr_capable"))
+			vrr_capable = pprops->prop_values[p];
+		else if (pprop && !strcmp(pprop->name, "EDID"))
+			edid_blob_id = pprops->prop_values[p];
+		drmModeFreeProperty(pprop);
+	}
+	drmModeFreeObjectProperties(pprops);
+
+	if (!vrr_capable)
+	{
+		log_verbose("DRM/KMS: <%d> (init_vrr) [WARNING] connector %d isn't vrr_capable, variable refresh disabled\n", m_id, m_desktop_output);
+		return false;
+	}
+
+	m_prop_crtc_vrr_enabled = get_property_id(mp_crtc_desktop->crtc_id, DRM_MODE_OBJECT_CRTC, "VRR_ENABLED");
+	if (!m_prop_crtc_vrr_enabled)
+		return false;
+
+	// The refresh window, given by hand or from the monitor range limits of the EDID
+	if (strcmp(m_vs.kms_vrr, "auto"))
+	{
+		if (sscanf(m_vs.kms_vrr, "%lf-%lf", &m_vrr_min, &m_vrr_max) != 2)
+			log_error("DRM/KMS: <%d> (init_vrr) [ERROR] bad variable refresh window %s\n", m_id, m_vs.kms_vrr);
+	}
+	else
+	{
+		p_drmModeGetPropertyBlob = (__typeof__(drmModeGetPropertyBlob)) dlsym(mp_drm_handle, "drmModeGetPropertyBlob");
+		p_drmModeFreePropertyBlob = (__typeof__(drmModeFreePropertyBlob)) dlsym(mp_drm_handle, "drmModeFreePropertyBlob");
+
+		drmModePropertyBlobRes *pblob = edid_blob_id && p_drmModeGetPropertyBlob && p_drmModeFreePropertyBlob ? drmModeGetPropertyBlob(m_drm_fd, edid_blob_id) : NULL;
+		if (!pblob || !edid_get_vfreq_range((const uint8_t *)pblob->data, pblob->length, &m_vrr_min, &m_vrr_max))
+			log_error("DRM/KMS: <%d> (init_vrr) [ERROR] no refresh range in the monitor EDID, use kms_vrr min-max\n", m_id);
+		if (pblob)
+			drmModeFreePropertyBlob(pblob);
+	}
+
+	if (m_vrr_min <= 0 || m_vrr_max <= m_vrr_min)
+	{
+		m_vrr_min = m_vrr_max = 0;
+		return false;
+	}
+
+	log_verbose("DRM/KMS: <%d> (init_vrr) variable refresh enabled, %.3f-%.3f Hz\n", m_id, m_vrr_min, m_vrr_max);
+	return true;
+}
+
+//============================================================
+//  drmkms_timing::set_vrr_enabled
+//============================================================
+
+bool drmkms_timing::set_vrr_enabled(bool enabled)
+{
+	drmModeAtomicReq *req = drmModeAtomicAlloc();
+	drmModeAtomicAddProperty(req, mp_crtc_desktop->crtc_id, m_prop_crtc_vrr_enabled, enabled);
+
+	// Some drivers need a modeset to change it
+	int ret = drmModeAtomicCommit(m_drm_fd, req, 0, NULL);
+	if (ret)
+		ret = drmModeAtomicCommit(m_drm_fd, req, DRM_MODE_ATOMIC_ALLOW_MODESET, NULL);
+	drmModeAtomicFree(req);
+
+	if (ret)
+		log_verbose("DRM/KMS: <%d> (set_vrr_enabled) [WARNING] can't set VRR_ENABLED to %d (ret=%d)\n", m_id, enabled, ret);
+
+	return ret == 0;
+}
+
+//============================================================
+//  drmkms_timing::vrr_range
+//============================================================
+
+bool drmkms_timing::vrr_range(double *vfreq_min, double *vfreq_max)
+{
+	if (!m_vrr)
+		return false;
+
+	*vfreq_min = m_vrr_min;
+	*vfreq_max = m_vrr_max;
+	return true;
+}
+
+//============================================================
+//  drmkms_timing::get_property_id
+//============================================================
+
+uint32_t drmkms_timing::get_property_id(uint32_t object_id, uint32_t object_type, const char *name)
+{
+	uint32_t prop_id = 0;
+
+	drmModeObjectProperties *pprops = drmModeObjectGetProperties(m_drm_fd, object_id, object_type);
+	for (unsigned int p = 0; pprops && p < pprops->count_props && !prop_id; p++)
+	{
+		drmModePropertyRes *pprop = drmModeGetProperty(m_drm_fd, pprops->props[p]);
+		if (pprop && !strcmp(pprop->name, name))
+			prop_id = pprop->prop_id;
+		drmModeFreeProperty(pprop);
+	}
+	drmModeFreeObjectProperties(pprops);
+
+	if (!prop_id)
+		log_verbose("DRM/KMS: <%d> (get_property_id) [WARNING] property %s not found on object %d\n", m_id, name, object_id);
+
+	return prop_id;
+}
+
+//============================================================
+//  drmkms_timing::atomic_commit
+//============================================================
+
+bool drmkms_timing::atomic_commit(drmModeModeInfo *dmode, unsigned int framebuffer_id, uint32_t flags, bool allow_modeset)
+{
+	uint32_t blob_id = 0;
+	if (drmModeCreatePropertyBlob(m_drm_fd, dmode, sizeof(drmModeModeInfo), &blob_id))
+	{
+		log_error("DRM/KMS: <%d> (atomic_commit) [ERROR] cannot create mode blob for %s\n", m_id, dmode->name);
+		return false;
+	}
+
+	uint32_t crtc_id = mp_crtc_desktop->crtc_id;
+
+	drmModeAtomicReq *req = drmModeAtomicAlloc();
+	drmModeAtomicAddProperty(req, m_desktop_output, m_prop_conn_crtc_id, crtc_id);
+	drmModeAtomicAddProperty(req, crtc_id, m_prop_crtc_mode_id, blob_id);
+	drmModeAtomicAddProperty(req, crtc_id, m_prop_crtc_active, 1);
+	drmModeAtomicAddProperty(req, m_plane_id, m_prop_plane_fb_id, framebuffer_id);
+	drmModeAtomicAddProperty(req, m_plane_id, m_prop_plane_crtc_id, crtc_id);
+	drmModeAtomicAddProperty(req, m_plane_id, m_prop_plane_src_x, 0);
+	drmModeAtomicAddProperty(req, m_plane_id, m_prop_plane_src_y, 0);
+	drmModeAtomicAddProperty(req, m_plane_id, m_prop_plane_src_w, (uint64_t)dmode->hdisplay << 16);
+	drmModeAtomicAddProperty(req, m_plane_id, m_prop_plane_src_h, (uint64_t)dmode->vdisplay << 16);
+	drmModeAtomicAddProperty(req, m_plane_id, m_prop_plane_crtc_x, 0);
+	drmModeAtomicAddProperty(req, m_plane_id, m_prop_plane_crtc_y, 0);
+	drmModeAtomicAddProperty(req, m_plane_id, m_prop_plane_crtc_w, dmode->hdisplay);
+	drmModeAtomicAddProperty(req, m_plane_id, m_prop_plane_crtc_h, dmode->vdisplay);
+
+	// Our modes run with variable refresh, the frame pacing sets the refresh within the window
+	if (m_vrr)
+		drmModeAtomicAddProperty(req, crtc_id, m_prop_crtc_vrr_enabled, 1);
+
+	if (allow_modeset)
+		flags |= DRM_MODE_ATOMIC_ALLOW_MODESET;
+
+	int ret = drmModeAtomicCommit(m_drm_fd, req, flags, NULL);
+
+	// A previous non-blocking commit is still pending, wait for it this time
+	if (ret == -EBUSY && (flags & DRM_MODE_ATOMIC_NONBLOCK))
+		ret = drmModeAtomicCommit(m_drm_fd, req, flags & ~DRM_MODE_ATOMIC_NONBLOCK, NULL);
+
+	drmModeAtomicFree(req);
+
+	if (ret || (flags & DRM_MODE_ATOMIC_TEST_ONLY))
+	{
+		if (ret)
+			log_verbose("DRM/KMS: <%d> (atomic_commit) %s %s failed (ret=%d)\n", m_id, flags & DRM_MODE_ATOMIC_TEST_ONLY ? "test" : "commit", dmode->name, ret);
+		drmModeDestroyPropertyBlob(m_drm_fd, blob_id);
+		return ret == 0;
+	}
+
+	// The kernel keeps its own reference to the active mode, release our previous blob
+	if (m_mode_blob_id)
+		drmModeDestroyPropertyBlob(m_drm_fd, m_mode_blob_id);
+	m_mode_blob_id = blob_id;
+
+	return true;
+}
+
 //============================================================
 //  drmkms_timing::get_master_fd
 //============================================================
@@ -992,121 +1325,315 @@ bool drmkms_timing::set_timing(modeline *mode)
 
 	mode->type |= CUSTOM_VIDEO_TIMING_DRMKMS;
 
+	bool result = true;
 	if (mode->type & MODE_DESKTOP)
 	{
 		log_verbose("DRM/KMS: <%d> (set_timing) <debug> restore desktop mode\n", m_id);
-		drmModeSetCrtc(m_drm_fd, mp_crtc_desktop->crtc_id, mp_crtc_desktop->buffer_id, mp_crtc_desktop->x, mp_crtc_desktop->y, &m_desktop_output, 1, &mp_crtc_desktop->mode);
-		if (m_dumb_handle)
-		{
-			int ret = ioctl(m_drm_fd, DRM_IOCTL_MODE_DESTROY_DUMB, &m_dumb_handle);
-			if (ret)
-				log_verbose("DRM/KMS: <%d> (set_timing) [ERROR] ioctl DRM_IOCTL_MODE_DESTROY_DUMB %d\n", m_id, ret);
-			m_dumb_handle = 0;
-		}
-		if (m_framebuffer_id && m_framebuffer_id != mp_crtc_desktop->buffer_id)
+		result = drmModeSetCrtc(m_drm_fd, mp_crtc_desktop->crtc_id, mp_crtc_desktop->buffer_id, mp_crtc_desktop->x, mp_crtc_desktop->y, &m_desktop_output, 1, &mp_crtc_desktop->mode) == 0;
+		if (!result)
+			log_error("DRM/KMS: <%d> (set_timing) [ERROR] cannot restore the desktop mode on the crtc %d\n", m_id, mp_crtc_desktop->crtc_id);
+		else
 		{
-			if (drmModeRmFB(m_drm_fd, m_framebuffer_id))
-				log_verbose("DRM/KMS: <%d> (set_timing) [ERROR] remove frame buffer\n", m_id);
-			m_framebuffer_id = 0;
+			// The desktop gets its fixed refresh back
+			if (m_vrr)
+				set_vrr_enabled(false);
+
+			if (m_mode_blob_id)
+			{
+				drmModeDestroyPropertyBlob(m_drm_fd, m_mode_blob_id);
+				m_mode_blob_id = 0;
+			}
+
+			// Pooled frame buffers are kept for later use, just release the memory above the limit
+			m_fb_current = -1;
+			m_crtc_mode = {};
+			trim_framebuffer_pool();
 		}
 	}
 	else
 	{
-		unsigned int old_dumb_handle = m_dumb_handle;
+		// Get a frame buffer from the pool, a new one is only created if no buffer matches size and bpp
+		int fb_index = get_mode_framebuffer(dmode.hdisplay, dmode.vdisplay);
 
-		drmModeFB *pframebuffer = drmModeGetFB(m_drm_fd, mp_crtc_desktop->buffer_id);
+		unsigned int framebuffer_id = fb_index != -1 ? m_fb_pool[fb_index].fb_id : mp_crtc_desktop->buffer_id;
 
-		// This condition happens when the console is not active on the output, use a dummy buffer instead
-		if (pframebuffer == nullptr)
+		// set the mode on the crtc
+		result = m_atomic ? atomic_commit(&dmode, framebuffer_id, DRM_MODE_ATOMIC_NONBLOCK) : drmModeSetCrtc(m_drm_fd, mp_crtc_desktop->crtc_id, framebuffer_id, 0, 0, &m_desktop_output, 1, &dmode) == 0;
+		if (!result)
+			log_error("DRM/KMS: <%d> (set_timing) [ERROR] cannot attach the mode to the crtc %d frame buffer %d\n", m_id, mp_crtc_desktop->crtc_id, framebuffer_id);
+		else
 		{
-			log_verbose("DRM/KMS: <%d> (set_timing) <debug> can't get framebuffer, using dummy size\n", m_id);
-			pframebuffer = new drmModeFB;
-			pframebuffer->width = 640;
-			pframebuffer->height = 480;
-			pframebuffer->depth = 24;
-			pframebuffer->bpp = 32;
+			m_fb_current = fb_index;
+			m_crtc_mode = dmode;
+			if (fb_index != -1)
+			{
+				m_map = m_fb_pool[fb_index].map;
+				m_pitch = m_fb_pool[fb_index].pitch;
+				m_bpp = m_fb_pool[fb_index].bpp;
+			}
+			trim_framebuffer_pool();
 		}
+	}
+	if (can_drop_master)
+		drmDropMaster(m_drm_fd);
 
-		log_verbose("DRM/KMS: <%d> (set_timing) <debug> existing frame buffer id %d size %dx%d bpp %d\n", m_id, mp_crtc_desktop->buffer_id, pframebuffer->width, pframebuffer->height, pframebuffer->bpp);
-		//drmModePlaneRes *pplanes = drmModeGetPlaneResources(m_drm_fd);
-		//log_verbose("DRM/KMS: <%d> (add_mode) <debug> total planes %d\n", m_id, pplanes->count_planes);
-		//drmModeFreePlaneResources(pplanes);
+	return result;
+}
 
-		unsigned int framebuffer_id = mp_crtc_desktop->buffer_id;
+//============================================================
+//  drmkms_timing::update_timing
+//============================================================
 
-		//if (pframebuffer->width < dmode.hdisplay || pframebuffer->height < dmode.vdisplay)
-		if (1)
-		{
-			log_verbose("DRM/KMS: <%d> (set_timing) <debug> creating new frame buffer with size %dx%d\n", m_id, dmode.hdisplay, dmode.vdisplay);
+bool drmkms_timing::update_timing(modeline *mode)
+{
+	// Only our own frame buffer on screen can be kept, and only for the same size
+	if (!mode || (mode->type & MODE_DESKTOP) || !m_desktop_output || m_fb_current == -1 ||
+		m_fb_pool[m_fb_current].width != mode->hactive || m_fb_pool[m_fb_current].height != mode->vactive)
+		return set_timing(mode);
 
-			// create a new dumb fb (not driver specefic)
-			drm_mode_create_dumb create_dumb = {};
-			create_dumb.width = dmode.hdisplay;
-			create_dumb.height = dmode.vdisplay;
-			create_dumb.bpp = pframebuffer->bpp;
+	drmSetMaster(m_drm_fd);
+	if (!drmIsMaster(m_drm_fd))
+		return false;
 
-			int ret = ioctl(m_drm_fd, DRM_IOCTL_MODE_CREATE_DUMB, &create_dumb);
-			if (ret)
-				log_verbose("DRM/KMS: <%d> (set_timing) [ERROR] ioctl DRM_IOCTL_MODE_CREATE_DUMB %d\n", m_id, ret);
+	drm_framebuffer *fb = &m_fb_pool[m_fb_current];
+	drmModeModeInfo dmode;
+	modeline_to_drm_modeline(m_id, mode, &dmode);
+	dmode.type = DRM_MODE_TYPE_USERDEF;
 
-			if (drmModeAddFB(m_drm_fd, dmode.hdisplay, dmode.vdisplay, pframebuffer->depth, pframebuffer->bpp, create_dumb.pitch, create_dumb.handle, &framebuffer_id))
-				log_error("DRM/KMS: <%d> (set_timing) [ERROR] cannot add frame buffer\n", m_id);
-			else
-				m_dumb_handle = create_dumb.handle;
+	mode->type |= CUSTOM_VIDEO_TIMING_DRMKMS;
 
-			drm_mode_map_dumb map_dumb = {};
-			map_dumb.handle = create_dumb.handle;
-			m_pitch = create_dumb.pitch;
-			m_bpp = create_dumb.bpp;
+	// Keep the frame buffer on screen. Drivers that stretch the vertical blanking, like for variable
+	// refresh, may take a new vertical total without a modeset, anything else needs one
+	bool result = true;
+	if (drm_same_timings(&dmode, &m_crtc_mode))
+		log_verbose("DRM/KMS: <%d> (update_timing) mode %s is on screen already\n", m_id, dmode.name);
 
-			ret = drmIoctl(m_drm_fd, DRM_IOCTL_MODE_MAP_DUMB, &map_dumb);
-			if (ret)
-				log_verbose("DRM/KMS: <%d> (set_timing) [ERROR] ioctl DRM_IOCTL_MODE_MAP_DUMB %d\n", m_id, ret);
+	else if (m_atomic)
+		result = (drm_same_htimings(&dmode, &m_crtc_mode) && atomic_commit(&dmode, fb->fb_id, DRM_MODE_ATOMIC_NONBLOCK, false))
+			|| atomic_commit(&dmode, fb->fb_id, DRM_MODE_ATOMIC_NONBLOCK);
+	else
+		result = drmModeSetCrtc(m_drm_fd, mp_crtc_desktop->crtc_id, fb->fb_id, 0, 0, &m_desktop_output, 1, &dmode) == 0;
 
-			m_map = mmap(0, create_dumb.size, PROT_READ | PROT_WRITE, MAP_SHARED, m_drm_fd, map_dumb.offset);
-			if (m_map != MAP_FAILED)
-			{
-				// clear the frame buffer
-				memset(m_map, 0, create_dumb.size);
-			}
-			else
-				log_verbose("DRM/KMS: <%d> (set_timing) [ERROR] failed to map frame buffer %p\n", m_id, m_map);
-		}
-		else
-			log_verbose("DRM/KMS: <%d> (set_timing) <debug> use existing frame buffer\n", m_id);
+	if (!result)
+		log_error("DRM/KMS: <%d> (update_timing) [ERROR] cannot attach the mode to the crtc %d frame buffer %d\n", m_id, mp_crtc_desktop->crtc_id, fb->fb_id);
+	else
+	{
+		log_verbose("DRM/KMS: <%d> (update_timing) mode %s kept frame buffer %d\n", m_id, dmode.name, fb->fb_id);
+		fb->last_used = ++m_fb_clock;
+		m_crtc_mode = dmode;
+	}
 
-		drmModeFreeFB(pframebuffer);
+	if (can_drop_master)
+		drmDropMaster(m_drm_fd);
 
-		pframebuffer = drmModeGetFB(m_drm_fd, framebuffer_id);
-		log_verbose("DRM/KMS: <%d> (set_timing) <debug> frame buffer id %d size %dx%d bpp %d\n", m_id, framebuffer_id, pframebuffer->width, pframebuffer->height, pframebuffer->bpp);
-		drmModeFreeFB(pframebuffer);
+	return result;
+}
 
-		// set the mode on the crtc
-		if (drmModeSetCrtc(m_drm_fd, mp_crtc_desktop->crtc_id, framebuffer_id, 0, 0, &m_desktop_output, 1, &dmode))
-			log_error("DRM/KMS: <%d> (set_timing) [ERROR] cannot attach the mode to the crtc %d frame buffer %d\n", m_id, mp_crtc_desktop->crtc_id, framebuffer_id);
-		else
-		{
-			if (old_dumb_handle)
-			{
-				log_verbose("DRM/KMS: <%d> (set_timing) <debug> remove old dumb %d\n", m_id, old_dumb_handle);
-				int ret = ioctl(m_drm_fd, DRM_IOCTL_MODE_DESTROY_DUMB, &old_dumb_handle);
-				if (ret)
-					log_verbose("DRM/KMS: <%d> (set_timing) [ERROR] ioctl DRM_IOCTL_MODE_DESTROY_DUMB %d\n", m_id, ret);
-				old_dumb_handle = 0;
-			}
-			if (m_framebuffer_id && framebuffer_id != mp_crtc_desktop->buffer_id)
-			{
-				log_verbose("DRM/KMS: <%d> (set_timing) <debug> remove old frame buffer %d\n", m_id, m_framebuffer_id);
-				drmModeRmFB(m_drm_fd, m_framebuffer_id);
-				m_framebuffer_id = 0;
-			}
-			m_framebuffer_id = framebuffer_id;
-		}
+//============================================================
+//  drmkms_timing::test_mode
+//============================================================
+
+bool drmkms_timing::test_mode(modeline *mode)
+{
+	// Without atomic support we can't validate anything
+	if (!m_atomic)
+		return true;
+
+	if (mode->hactive == 0 || mode->vactive == 0)
+		return false;
+
+	drmModeModeInfo tested;
+	modeline_to_drm_modeline(m_id, mode, &tested);
+	if (is_tested_mode(&tested))
+		return true;
+
+	// If we can't be master, don't reject the mode for that
+	drmSetMaster(m_drm_fd);
+	if (!drmIsMaster(m_drm_fd))
+		return true;
+
+	drmModeModeInfo dmode;
+	modeline_to_drm_modeline(m_id, mode, &dmode);
+	dmode.type = DRM_MODE_TYPE_USERDEF;
+
+	// The test needs a frame buffer with the mode size, it's pooled for the actual switch
+	bool result = true;
+	int fb_index = get_mode_framebuffer(dmode.hdisplay, dmode.vdisplay);
+	if (fb_index != -1)
+	{
+		result = atomic_commit(&dmode, m_fb_pool[fb_index].fb_id, DRM_MODE_ATOMIC_TEST_ONLY);
+		if (result)
+			m_tested_modes.push_back(dmode);
 	}
+
+	trim_framebuffer_pool();
+
 	if (can_drop_master)
 		drmDropMaster(m_drm_fd);
 
-	return true;
+	log_verbose("DRM/KMS: <%d> (test_mode) mode %s %s by the driver\n", m_id, dmode.name, result ? "accepted" : "rejected");
+
+	return result;
+}
+
+//============================================================
+//  drmkms_timing::is_tested_mode
+//============================================================
+
+bool drmkms_timing::is_tested_mode(drmModeModeInfo *dmode)
+{
+	for (auto &t : m_tested_modes)
+		if (drm_same_timings(&t, dmode))
+			return true;
+
+	return false;
+}
+
+//============================================================
+//  drmkms_timing::get_mode_framebuffer
+//============================================================
+
+int drmkms_timing::get_mode_framebuffer(int width, int height)
+{
+	return get_framebuffer(width, height, m_desktop_bpp, m_desktop_depth);
+}
+
+//============================================================
+//  drmkms_timing::get_framebuffer
+//============================================================
+
+int drmkms_timing::get_framebuffer(int width, int height, int bpp, int depth)
+{
+	// Reuse a pooled frame buffer if possible, its contents are already clear
+	for (int i = 0; i < (int)m_fb_pool.size(); i++)
+	{
+		drm_framebuffer *fb = &m_fb_pool[i];
+		if (fb->width == width && fb->height == height && fb->bpp == bpp && fb->depth == depth)
+		{
+			log_verbose("DRM/KMS: <%d> (get_framebuffer) <debug> reuse frame buffer %d with size %dx%d\n", m_id, fb->fb_id, width, height);
+			fb->last_used = ++m_fb_clock;
+			return i;
+		}
+	}
+
+	log_verbose("DRM/KMS: <%d> (get_framebuffer) <debug> creating new frame buffer with size %dx%d\n", m_id, width, height);
+
+	// create a new dumb fb (not driver specefic)
+	drm_mode_create_dumb create_dumb = {};
+	create_dumb.width = width;
+	create_dumb.height = height;
+	create_dumb.bpp = bpp;
+
+	int ret = drmIoctl(m_drm_fd, DRM_IOCTL_MODE_CREATE_DUMB, &create_dumb);
+	if (ret)
+	{
+		log_verbose("DRM/KMS: <%d> (get_framebuffer) [ERROR] ioctl DRM_IOCTL_MODE_CREATE_DUMB %d\n", m_id, ret);
+		return -1;
+	}
+
+	drm_framebuffer fb = {};
+	fb.width = width;
+	fb.height = height;
+	fb.bpp = bpp;
+	fb.depth = depth;
+	fb.dumb_handle = create_dumb.handle;
+	fb.pitch = create_dumb.pitch;
+	fb.size = create_dumb.size;
+
+	if (drmModeAddFB(m_drm_fd, width, height, depth, bpp, create_dumb.pitch, create_dumb.handle, &fb.fb_id))
+	{
+		log_error("DRM/KMS: <%d> (get_framebuffer) [ERROR] cannot add frame buffer\n", m_id);
+		free_framebuffer(&fb);
+		return -1;
+	}
+
+	drm_mode_map_dumb map_dumb = {};
+	map_dumb.handle = create_dumb.handle;
+
+	ret = drmIoctl(m_drm_fd, DRM_IOCTL_MODE_MAP_DUMB, &map_dumb);
+	if (ret)
+		log_verbose("DRM/KMS: <%d> (get_framebuffer) [ERROR] ioctl DRM_IOCTL_MODE_MAP_DUMB %d\n", m_id, ret);
+
+	fb.map = mmap(0, create_dumb.size, PROT_READ | PROT_WRITE, MAP_SHARED, m_drm_fd, map_dumb.offset);
+	if (fb.map != MAP_FAILED)
+	{
+		// clear the frame buffer, only done once for a new buffer
+		memset(fb.map, 0, create_dumb.size);
+	}
+	else
+	{
+		log_verbose("DRM/KMS: <%d> (get_framebuffer) [ERROR] failed to map frame buffer %p\n", m_id, fb.map);
+		fb.map = nullptr;
+	}
+
+	fb.last_used = ++m_fb_clock;
+	m_fb_pool.push_back(fb);
+
+	return m_fb_pool.size() - 1;
+}
+
+//============================================================
+//  drmkms_timing::free_framebuffer
+//============================================================
+
+void drmkms_timing::free_framebuffer(drm_framebuffer *fb)
+{
+	log_verbose("DRM/KMS: <%d> (free_framebuffer) <debug> remove frame buffer %d dumb %d\n", m_id, fb->fb_id, fb->dumb_handle);
+
+	if (fb->map)
+		munmap(fb->map, fb->size);
+
+	if (fb->fb_id && fb->fb_id != mp_crtc_desktop->buffer_id)
+	{
+		if (drmModeRmFB(m_drm_fd, fb->fb_id))
+			log_verbose("DRM/KMS: <%d> (free_framebuffer) [ERROR] remove frame buffer\n", m_id);
+	}
+
+	if (fb->dumb_handle)
+	{
+		drm_mode_destroy_dumb destroy_dumb = {};
+		destroy_dumb.handle = fb->dumb_handle;
+		int ret = drmIoctl(m_drm_fd, DRM_IOCTL_MODE_DESTROY_DUMB, &destroy_dumb);
+		if (ret)
+			log_verbose("DRM/KMS: <%d> (free_framebuffer) [ERROR] ioctl DRM_IOCTL_MODE_DESTROY_DUMB %d\n", m_id, ret);
+	}
+
+	if (m_map == fb->map)
+		m_map = nullptr;
+
+	*fb = {};
+}
+
+//============================================================
+//  drmkms_timing::trim_framebuffer_pool
+//============================================================
+
+void drmkms_timing::trim_framebuffer_pool()
+{
+	uint64_t pool_size = 0;
+	for (auto &fb : m_fb_pool)
+		pool_size += fb.size;
+
+	uint64_t pool_limit = (uint64_t)kms_fb_pool_size() << 20;
+
+	// Release least recently used buffers until we're below the limit, never the one on screen
+	while (pool_size > pool_limit)
+	{
+		int lru = -1;
+		for (int i = 0; i < (int)m_fb_pool.size(); i++)
+			if (i != m_fb_current && (lru == -1 || m_fb_pool[i].last_used < m_fb_pool[lru].last_used))
+				lru = i;
+
+		if (lru == -1)
+			break;
+
+		pool_size -= m_fb_pool[lru].size;
+		free_framebuffer(&m_fb_pool[lru]);
+		m_fb_pool.erase(m_fb_pool.begin() + lru);
+
+		if (m_fb_current > lru)
+			m_fb_current--;
+	}
 }
 
 //============================================================
@@ -1177,73 +1704,113 @@ bool drmkms_timing::get_timing(modeline *mode)
 	}
 
 	// INFO: not used vrefresh, hskew, vscan
-	drmModeRes *p_res = drmModeGetResources(m_drm_fd);
+	drmModeConnector *p_connector = drmModeGetConnectorCurrent(m_drm_fd, m_desktop_output);
+	if (!p_connector)
+	{
+		log_error("DRM/KMS: <%d> (get_timing) [ERROR] can't get connector %d\n", m_id, m_desktop_output);
+		return false;
+	}
 
-	for (int i = 0; i < p_res->count_connectors; i++)
+	// Cycle through the modelines and report them back to the display manager
+	if (m_video_modes_position < p_connector->count_modes)
 	{
-		drmModeConnector *p_connector = drmModeGetConnectorCurrent(m_drm_fd, p_res->connectors[i]);
+		drm_mode_to_modeline(&p_connector->modes[m_video_modes_position], m_video_modes_position, mode);
+		m_video_modes_position++;
+	}
+	else
+	{
+		// Inititalise the position for the modeline list
+		m_video_modes_position = 0;
+	}
+	drmModeFreeConnector(p_connector);
 
-		// Cycle through the modelines and report them back to the display manager
-		if (p_connector && m_desktop_output == p_connector->connector_id)
-		{
-			if (m_video_modes_position < p_connector->count_modes)
-			{
-				drmModeModeInfo *pdmode = &p_connector->modes[m_video_modes_position++];
+	return true;
+}
 
-				// Use mode position as index
-				mode->platform_data = m_video_modes_position - 1;
+//============================================================
+//  drmkms_timing::get_timings
+//============================================================
 
-				mode->pclock        = pdmode->clock * 1000;
-				mode->hactive       = pdmode->hdisplay;
-				mode->hbegin        = pdmode->hsync_start;
-				mode->hend          = pdmode->hsync_end;
-				mode->htotal        = pdmode->htotal;
-				mode->vactive       = pdmode->vdisplay;
-				mode->vbegin        = pdmode->vsync_start;
-				mode->vend          = pdmode->vsync_end;
-				mode->vtotal        = pdmode->vtotal;
-				mode->interlace     = (pdmode->flags & DRM_MODE_FLAG_INTERLACE) ? 1 : 0;
-				mode->doublescan    = (pdmode->flags & DRM_MODE_FLAG_DBLSCAN) ? 1 : 0;
-				mode->hsync         = (pdmode->flags & DRM_MODE_FLAG_PHSYNC) ? 1 : 0;
-				mode->vsync         = (pdmode->flags & DRM_MODE_FLAG_PVSYNC) ? 1 : 0;
+bool drmkms_timing::get_timings(std::vector<modeline> &modes)
+{
+	// Handle no screen detected case
+	if (!m_desktop_output)
+	{
+		log_error("DRM/KMS: <%d> (get_timings) [ERROR] no screen detected\n", m_id);
+		return false;
+	}
 
-				mode->hfreq         = mode->pclock / mode->htotal;
-				mode->vfreq         = mode->hfreq / mode->vtotal * (mode->interlace ? 2 : 1);
+	// Take a single snapshot of the connector and report all its modelines at once
+	drmModeConnector *p_connector = drmModeGetConnectorCurrent(m_drm_fd, m_desktop_output);
+	if (!p_connector)
+	{
+		log_error("DRM/KMS: <%d> (get_timings) [ERROR] can't get connector %d\n", m_id, m_desktop_output);
+		return false;
+	}
 
-				// Store drm's integer refresh to make sure we use the same rounding
-				mode->refresh       = pdmode->vrefresh;
+	modes.reserve(modes.size() + p_connector->count_modes);
 
-				mode->width         = pdmode->hdisplay;
-				mode->height        = pdmode->vdisplay;
+	for (int i = 0; i < p_connector->count_modes; i++)
+	{
+		modeline mode = {};
+		drm_mode_to_modeline(&p_connector->modes[i], i, &mode);
+		modes.push_back(mode);
+	}
+	drmModeFreeConnector(p_connector);
 
-				// Add the rotation flag from the plane (DRM_MODE_ROTATE_xxx)
-				// TODO: mode->type |= MODE_ROTATED;
+	log_verbose("DRM/KMS: <%d> (get_timings) %d modes found on connector %d\n", m_id, (int)modes.size(), m_desktop_output);
 
-				mode->type |= CUSTOM_VIDEO_TIMING_DRMKMS;
+	return true;
+}
 
-				// Check if this is a dummy mode
-				if (pdmode->type & (1<<7)) mode->type |= XYV_EDITABLE | SCAN_EDITABLE;
+//============================================================
+//  drmkms_timing::drm_mode_to_modeline
+//============================================================
 
-				if (strncmp(pdmode->name, "SR-", 3) == 0)
-					log_verbose("DRM/KMS: <%d> (get_timing) [WARNING] modeline %s detected\n", m_id, pdmode->name);
-				else if (!strcmp(pdmode->name, mp_crtc_desktop->mode.name) && pdmode->clock == mp_crtc_desktop->mode.clock && pdmode->vrefresh == mp_crtc_desktop->mode.vrefresh)
-				{
-					// Add the desktop flag to desktop modeline
-					log_verbose("DRM/KMS: <%d> (get_timing) desktop mode name %s refresh %d found\n", m_id, mp_crtc_desktop->mode.name, mp_crtc_desktop->mode.vrefresh);
-					mode->type |= MODE_DESKTOP;
-				}
-			}
-			else
-			{
-				// Inititalise the position for the modeline list
-				m_video_modes_position = 0;
-			}
-		}
-		drmModeFreeConnector(p_connector);
-	}
-	drmModeFreeResources(p_res);
+void drmkms_timing::drm_mode_to_modeline(drmModeModeInfo *pdmode, int index, modeline *mode)
+{
+	// Use mode position as index
+	mode->platform_data = index;
+
+	mode->pclock        = pdmode->clock * 1000;
+	mode->hactive       = pdmode->hdisplay;
+	mode->hbegin        = pdmode->hsync_start;
+	mode->hend          = pdmode->hsync_end;
+	mode->htotal        = pdmode->htotal;
+	mode->vactive       = pdmode->vdisplay;
+	mode->vbegin        = pdmode->vsync_start;
+	mode->vend          = pdmode->vsync_end;
+	mode->vtotal        = pdmode->vtotal;
+	mode->interlace     = (pdmode->flags & DRM_MODE_FLAG_INTERLACE) ? 1 : 0;
+	mode->doublescan    = (pdmode->flags & DRM_MODE_FLAG_DBLSCAN) ? 1 : 0;
+	mode->hsync         = (pdmode->flags & DRM_MODE_FLAG_PHSYNC) ? 1 : 0;
+	mode->vsync         = (pdmode->flags & DRM_MODE_FLAG_PVSYNC) ? 1 : 0;
+
+	mode->hfreq         = mode->pclock / mode->htotal;
+	mode->vfreq         = mode->hfreq / mode->vtotal * (mode->interlace ? 2 : 1);
+
+	// Store drm's integer refresh to make sure we use the same rounding
+	mode->refresh       = pdmode->vrefresh;
+
+	mode->width         = pdmode->hdisplay;
+	mode->height        = pdmode->vdisplay;
+
+	// Add the rotation flag from the plane (DRM_MODE_ROTATE_xxx)
+	// TODO: mode->type |= MODE_ROTATED;
 
-	return true;
+	mode->type |= CUSTOM_VIDEO_TIMING_DRMKMS;
+
+	// Check if this is a dummy mode
+	if (pdmode->type & (1<<7)) mode->type |= XYV_EDITABLE | SCAN_EDITABLE;
+
+	if (strncmp(pdmode->name, "SR-", 3) == 0)
+		log_verbose("DRM/KMS: <%d> (get_timing) [WARNING] modeline %s detected\n", m_id, pdmode->name);
+	else if (!strcmp(pdmode->name, mp_crtc_desktop->mode.name) && pdmode->clock == mp_crtc_desktop->mode.clock && pdmode->vrefresh == mp_crtc_desktop->mode.vrefresh)
+	{
+		// Add the desktop flag to desktop modeline
+		log_verbose("DRM/KMS: <%d> (get_timing) desktop mode name %s refresh %d found\n", m_id, mp_crtc_desktop->mode.name, mp_crtc_desktop->mode.vrefresh);
+		mode->type |= MODE_DESKTOP;
+	}
 }
 
 //============================================================
@@ -1252,31 +1819,91 @@ bool drmkms_timing::get_timing(modeline *mode)
 
 bool drmkms_timing::process_modelist(std::vector<modeline *> modelist)
 {
-	bool error = false;
-	bool result = false;
+	bool rejected = false;
 
+	// The connector's mode list can't be committed at once, so stage the whole set
+	// instead: the driver must accept all the new timings before we touch the list.
+	// Those get_mode had tested are known already. Without atomic support nothing
+	// can be tested, and a failed set relies on the rollback alone
+	m_modelist_results.clear();
 	for (auto &mode : modelist)
 	{
-		if (mode->type & MODE_DELETE)
-			result = delete_mode(mode);
+		bool accepted = (mode->type & MODE_DELETE) || !(mode->type & (MODE_ADD | MODE_UPDATE)) || test_mode(mode);
+		if (!accepted)
+		{
+			mode->type |= MODE_ERROR;
+			rejected = true;
+		}
+		m_modelist_results.push_back({ mode, accepted? MODELIST_SKIPPED : MODELIST_FAILED });
+	}
+
+	// The tests only hold for the change set they were done for
+	m_tested_modes.clear();
+
+	if (rejected)
+	{
+		log_error("DRM/KMS: <%d> (process_modelist) [ERROR] modes rejected by the driver, nothing applied\n", m_id);
+		return false;
+	}
 
-		else if (mode->type & MODE_ADD)
-			result = add_mode(mode);
+	return apply_modelist(modelist);
+}
 
-		else if (mode->type & MODE_UPDATE)
-			result = update_mode(mode);
+//============================================================
+//  drmkms_timing::save_mode
+//============================================================
 
-		if (!result)
+bool drmkms_timing::save_mode(modeline *mode, modeline *previous)
+{
+	*previous = {};
+
+	drmModeConnector *conn = drmModeGetConnectorCurrent(m_drm_fd, m_desktop_output);
+	if (!conn)
+		return false;
+
+	// With the libdrm hook, the mode is updated in place at its index
+	if (m_caps & CUSTOM_VIDEO_CAPS_UPDATE)
+	{
+		bool found = mode->platform_data < (uint64_t)conn->count_modes;
+		if (found)
 		{
-			mode->type |= MODE_ERROR;
-			error = true;
+			*previous = *mode;
+			drm_mode_to_modeline(&conn->modes[mode->platform_data], mode->platform_data, previous);
 		}
-		else
-			// succeed
-			mode->type &= ~MODE_ERROR;
+		drmModeFreeConnector(conn);
+		return found;
 	}
 
-	return !error;
+	// Otherwise, the kernel mode we'll delete is the one with the same name, if any
+	drmModeModeInfo srmode;
+	modeline_to_drm_modeline(m_id, mode, &srmode);
+	for (int i = 0; i < conn->count_modes; i++)
+		if (!strcmp(conn->modes[i].name, srmode.name))
+		{
+			*previous = *mode;
+			drm_mode_to_modeline(&conn->modes[i], i, previous);
+			// Keep the name it had
+			previous->vfreq = mode->vfreq;
+			break;
+		}
+
+	drmModeFreeConnector(conn);
+	return true;
+}
+
+//============================================================
+//  drmkms_timing::restore_mode
+//============================================================
+
+bool drmkms_timing::restore_mode(modeline *mode, modeline *previous)
+{
+	if (m_caps & CUSTOM_VIDEO_CAPS_UPDATE)
+		return update_mode(previous);
+
+	if (!delete_mode(mode))
+		return false;
+
+	return previous->htotal == 0 || add_mode(previous);
 }
 
 void drmkms_timing::list_drm_modes()
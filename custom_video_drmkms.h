@@ -20,6 +20,20 @@
 #include <xf86drmMode.h>
 #include "custom_video.h"
 
+typedef struct drm_framebuffer
+{
+	int width;
+	int height;
+	int bpp;
+	int depth;
+	int pitch;
+	uint64_t size;
+	unsigned int dumb_handle;
+	unsigned int fb_id;
+	void *map;
+	unsigned int last_used;
+} drm_framebuffer;
+
 class drmkms_timing : public custom_video
 {
 	public:
@@ -27,6 +41,7 @@ class drmkms_timing : public custom_video
 		~drmkms_timing();
 		const char *api_name() { return "DRMKMS"; }
 		int caps() { return m_caps; }
+		uint64_t pclock_step() { return 1000; } // drmModeModeInfo.clock is in kHz
 		bool init();
 
 		bool add_mode(modeline *mode);
@@ -34,9 +49,15 @@ class drmkms_timing : public custom_video
 		bool update_mode(modeline *mode);
 
 		bool process_modelist(std::vector<modeline *>);
+		bool save_mode(modeline *mode, modeline *previous);
+		bool restore_mode(modeline *mode, modeline *previous);
 
 		bool get_timing(modeline *mode);
+		bool get_timings(std::vector<modeline> &modes);
 		bool set_timing(modeline *mode);
+		bool update_timing(modeline *mode);
+		bool test_mode(modeline *mode);
+		bool vrr_range(double *vfreq_min, double *vfreq_max);
 
 		void *get_resource(const char *resource);
 
@@ -57,6 +78,8 @@ class drmkms_timing : public custom_video
 		void *m_map = nullptr;
 		int m_pitch = 0;
 		int m_bpp = 0;
+		int m_desktop_bpp = 32;
+		int m_desktop_depth = 24;
 
 		char m_device_name[32];
 		char m_drm_name[32];
@@ -64,8 +87,39 @@ class drmkms_timing : public custom_video
 		int m_video_modes_position = 0;
 
 		void *mp_drm_handle = NULL;
-		unsigned int m_dumb_handle = 0;
-		unsigned int m_framebuffer_id = 0;
+
+		// Frame buffer pool, reused across mode switches
+		std::vector<drm_framebuffer> m_fb_pool;
+		int m_fb_current = -1;
+		drmModeModeInfo m_crtc_mode = {};
+		unsigned int m_fb_clock = 0;
+
+		// Atomic modesetting
+		bool m_atomic = false;
+		uint32_t m_plane_id = 0;
+		uint32_t m_mode_blob_id = 0;
+		uint32_t m_prop_conn_crtc_id = 0;
+		uint32_t m_prop_crtc_mode_id = 0;
+		uint32_t m_prop_crtc_active = 0;
+		uint32_t m_prop_plane_fb_id = 0;
+		uint32_t m_prop_plane_crtc_id = 0;
+		uint32_t m_prop_plane_src_x = 0;
+		uint32_t m_prop_plane_src_y = 0;
+		uint32_t m_prop_plane_src_w = 0;
+		uint32_t m_prop_plane_src_h = 0;
+		uint32_t m_prop_plane_crtc_x = 0;
+		uint32_t m_prop_plane_crtc_y = 0;
+		uint32_t m_prop_plane_crtc_w = 0;
+		uint32_t m_prop_plane_crtc_h = 0;
+
+		// Timings the driver accepted in a test commit since the last mode list flush, so they aren't tested again
+		std::vector<drmModeModeInfo> m_tested_modes;
+
+		// Variable refresh, on top of atomic modesetting
+		bool m_vrr = false;
+		double m_vrr_min = 0;
+		double m_vrr_max = 0;
+		uint32_t m_prop_crtc_vrr_enabled = 0;
 
 		__typeof__(drmGetVersion) *p_drmGetVersion;
 		__typeof__(drmFreeVersion) *p_drmFreeVersion;
@@ -94,9 +148,35 @@ class drmkms_timing : public custom_video
 		__typeof__(drmIsMaster) *p_drmIsMaster;
 		__typeof__(drmSetMaster) *p_drmSetMaster;
 		__typeof__(drmDropMaster) *p_drmDropMaster;
+		__typeof__(drmSetClientCap) *p_drmSetClientCap;
+		__typeof__(drmModeGetPlane) *p_drmModeGetPlane;
+		__typeof__(drmModeFreePlane) *p_drmModeFreePlane;
+		__typeof__(drmModeObjectGetProperties) *p_drmModeObjectGetProperties;
+		__typeof__(drmModeFreeObjectProperties) *p_drmModeFreeObjectProperties;
+		__typeof__(drmModeGetProperty) *p_drmModeGetProperty;
+		__typeof__(drmModeFreeProperty) *p_drmModeFreeProperty;
+		__typeof__(drmModeCreatePropertyBlob) *p_drmModeCreatePropertyBlob;
+		__typeof__(drmModeDestroyPropertyBlob) *p_drmModeDestroyPropertyBlob;
+		__typeof__(drmModeAtomicAlloc) *p_drmModeAtomicAlloc;
+		__typeof__(drmModeAtomicFree) *p_drmModeAtomicFree;
+		__typeof__(drmModeAtomicAddProperty) *p_drmModeAtomicAddProperty;
+		__typeof__(drmModeAtomicCommit) *p_drmModeAtomicCommit;
+		__typeof__(drmModeGetPropertyBlob) *p_drmModeGetPropertyBlob;
+		__typeof__(drmModeFreePropertyBlob) *p_drmModeFreePropertyBlob;
 
 		bool test_kernel_user_modes();
 		bool kms_has_mode(modeline*);
+		void drm_mode_to_modeline(drmModeModeInfo *pdmode, int index, modeline *mode);
+		int get_framebuffer(int width, int height, int bpp, int depth);
+		void free_framebuffer(drm_framebuffer *fb);
+		void trim_framebuffer_pool();
+		int get_mode_framebuffer(int width, int height);
+		bool init_atomic();
+		bool init_vrr();
+		bool set_vrr_enabled(bool enabled);
+		uint32_t get_property_id(uint32_t object_id, uint32_t object_type, const char *name);
+		bool atomic_commit(drmModeModeInfo *dmode, unsigned int framebuffer_id, uint32_t flags, bool allow_modeset = true);
+		bool is_tested_mode(drmModeModeInfo *dmode);
 		void list_drm_modes();
 		int get_master_fd();
 
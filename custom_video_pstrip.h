@@ -51,6 +51,7 @@ class pstrip_timing : public custom_video
 		const char *api_name() { return "PowerStrip"; }
 		bool init();
 		int caps() { return CUSTOM_VIDEO_CAPS_UPDATE | CUSTOM_VIDEO_CAPS_SCAN_EDITABLE | CUSTOM_VIDEO_CAPS_DESKTOP_EDITABLE; }
+		uint64_t pclock_step() { return 1000; } // PixelClockInKiloHertz
 
 		bool update_mode(modeline *mode);
 
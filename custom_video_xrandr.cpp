@@ -40,6 +40,8 @@
 #define XRRSetCrtcConfig p_XRRSetCrtcConfig
 #define XRRSetScreenSize p_XRRSetScreenSize
 #define XRRGetScreenSizeRange p_XRRGetScreenSizeRange
+#define XRRQueryExtension p_XRRQueryExtension
+#define XRRSelectInput p_XRRSelectInput
 
 #define XCloseDisplay p_XCloseDisplay
 #define XGrabServer p_XGrabServer
@@ -50,6 +52,8 @@
 #define XClearWindow p_XClearWindow
 #define XFillRectangle p_XFillRectangle
 #define XCreateGC p_XCreateGC
+#define XPending p_XPending
+#define XNextEvent p_XNextEvent
 
 //============================================================
 //  error_handler
@@ -173,9 +177,12 @@ xrandr_timing::~xrandr_timing()
 		XClearWindow(m_pdisplay, m_root);
 	}
 
-	// Free the display
+	// Free the cached resources and the display
 	if (m_pdisplay != NULL)
+	{
+		invalidate_resources();
 		XCloseDisplay(m_pdisplay);
+	}
 
 	// close Xrandr library
 	if (m_xrandr_handle)
@@ -315,6 +322,20 @@ bool xrandr_timing::init()
 			log_error("XRANDR: <%d> (init) [ERROR] missing func %s in %s", m_id, "XRRSetScreenSize", "XRANDR_LIBRARY");
 			return false;
 		}
+
+		p_XRRQueryExtension = (__typeof__(XRRQueryExtension)) dlsym(m_xrandr_handle, "XRRQueryExtension");
+		if (p_XRRQueryExtension == NULL)
+		{
+			log_error("XRANDR: <%d> (init) [ERROR] missing func %s in %s", m_id, "XRRQueryExtension", "XRANDR_LIBRARY");
+			return false;
+		}
+
+		p_XRRSelectInput = (__typeof__(XRRSelectInput)) dlsym(m_xrandr_handle, "XRRSelectInput");
+		if (p_XRRSelectInput == NULL)
+		{
+			log_error("XRANDR: <%d> (init) [ERROR] missing func %s in %s", m_id, "XRRSelectInput", "XRANDR_LIBRARY");
+			return false;
+		}
 	}
 	else
 	{
@@ -396,6 +417,20 @@ bool xrandr_timing::init()
 			log_error("XRANDR: <%d> (init) [ERROR] missing func %s in %s", m_id, "XCreateGC", "X11_LIBRARY");
 			return false;
 		}
+
+		p_XPending = (__typeof__(XPending)) dlsym(m_x11_handle, "XPending");
+		if (p_XPending == NULL)
+		{
+			log_error("XRANDR: <%d> (init) [ERROR] missing func %s in %s", m_id, "XPending", "X11_LIBRARY");
+			return false;
+		}
+
+		p_XNextEvent = (__typeof__(XNextEvent)) dlsym(m_x11_handle, "XNextEvent");
+		if (p_XNextEvent == NULL)
+		{
+			log_error("XRANDR: <%d> (init) [ERROR] missing func %s in %s", m_id, "XNextEvent", "X11_LIBRARY");
+			return false;
+		}
 	}
 	else
 	{
@@ -535,7 +570,14 @@ bool xrandr_timing::init()
 	if (!detected)
 		log_error("XRANDR: <%d> (init) [ERROR] no screen detected\n", m_id);
 
-	else if (m_enable_screen_reordering)
+	// Get notified of RandR changes so cached resources can be invalidated
+	int error_base = 0;
+	if (detected && XRRQueryExtension(m_pdisplay, &m_event_base, &error_base))
+		XRRSelectInput(m_pdisplay, m_root, RRScreenChangeNotifyMask | RRCrtcChangeNotifyMask | RROutputChangeNotifyMask);
+	else
+		m_event_base = 0;
+
+	if (detected && m_enable_screen_reordering)
 	{
 		// Global screen placement
 		modeline mode = {};
@@ -562,6 +604,25 @@ bool xrandr_timing::update_mode(modeline *mode)
 		return false;
 	}
 
+	// The mode on screen can't be deleted without restoring the desktop mode first, so if the
+	// size is kept, add the new timings under a new id and move the crtc over before the delete
+	XRRModeInfo *pxmode = mode->platform_data != 0 && get_resources() ? find_mode(mode) : NULL;
+	if (pxmode != NULL && pxmode->id == m_last_crtc.mode && pxmode->width == (unsigned int)mode->hactive && pxmode->height == (unsigned int)mode->vactive)
+	{
+		modeline old_mode = *mode;
+		mode->platform_data = 0;
+
+		// The same name gives us the old mode back, use the slow path then
+		if (add_mode(mode) && mode->platform_data != old_mode.platform_data)
+		{
+			if (update_timing(mode))
+				return delete_mode(&old_mode);
+
+			delete_mode(mode);
+		}
+		mode->platform_data = old_mode.platform_data;
+	}
+
 	if (!delete_mode(mode))
 	{
 		log_error("XRANDR: <%d> (update_mode) [ERROR] delete operation not successful", m_id);
@@ -599,6 +660,10 @@ bool xrandr_timing::add_mode(modeline *mode)
 		return false;
 	}
 
+	XRRScreenResources *resources = get_resources();
+	if (!resources)
+		return false;
+
 	// Check if mode is available from the plaftform_data mode id
 	XRRModeInfo *pxmode = find_mode(mode);
 	if (pxmode != NULL)
@@ -657,17 +722,15 @@ bool xrandr_timing::add_mode(modeline *mode)
 
 	mode->platform_data = gmid;
 
-	// Add new modeline to primary output
-	XRRScreenResources *resources = XRRGetScreenResourcesCurrent(m_pdisplay, m_root);
-
-	XSync(m_pdisplay, False);
+	// Add new modeline to primary output, the queue was just synced
 	ms_xerrors_flag = 0x02;
 	old_error_handler = XSetErrorHandler(error_handler);
 	XRRAddOutputMode(m_pdisplay, resources->outputs[m_desktop_output], mode->platform_data);
 	XSync(m_pdisplay, False);
 	XSetErrorHandler(old_error_handler);
 
-	XRRFreeScreenResources(resources);
+	// Our own change, resources need to be fetched again
+	invalidate_resources();
 
 	if (ms_xerrors & ms_xerrors_flag)
 	{
@@ -694,7 +757,10 @@ bool xrandr_timing::add_mode(modeline *mode)
 XRRModeInfo *xrandr_timing::find_mode_by_name(char *name)
 {
 	XRRModeInfo *pxmode = NULL;
-	XRRScreenResources *resources = XRRGetScreenResourcesCurrent(m_pdisplay, m_root);
+	XRRScreenResources *resources = mp_resources;
+
+	if (!resources)
+		return NULL;
 
 	// use SR name to return the mode
 	for (int m = 0; m < resources->nmode; m++)
@@ -706,8 +772,6 @@ XRRModeInfo *xrandr_timing::find_mode_by_name(char *name)
 		}
 	}
 
-	XRRFreeScreenResources(resources);
-
 	return pxmode;
 }
 
@@ -717,22 +781,83 @@ XRRModeInfo *xrandr_timing::find_mode_by_name(char *name)
 
 XRRModeInfo *xrandr_timing::find_mode(modeline *mode)
 {
-	XRRModeInfo *pxmode = NULL;
-	XRRScreenResources *resources = XRRGetScreenResourcesCurrent(m_pdisplay, m_root);
+	// use platform_data (mode id) to return the mode from the cached resources
+	auto it = m_mode_map.find(mode->platform_data);
+	if (it == m_mode_map.end())
+		return NULL;
 
-	// use platform_data (mode id) to return the mode
-	for (int m = 0; m < resources->nmode; m++)
+	return it->second;
+}
+
+//============================================================
+//  xrandr_timing::get_resources
+//============================================================
+
+XRRScreenResources *xrandr_timing::get_resources()
+{
+	// Drop the cached resources if the server notified any RandR change
+	if (m_event_base)
 	{
-		if (mode->platform_data == resources->modes[m].id)
+		XEvent event;
+		while (XPending(m_pdisplay))
 		{
-			pxmode = &resources->modes[m];
-			break;
+			XNextEvent(m_pdisplay, &event);
+			if ((event.type == m_event_base + RRScreenChangeNotify || event.type == m_event_base + RRNotify) && mp_resources)
+			{
+				log_verbose("XRANDR: <%d> (get_resources) RandR change notified, dropping cached resources\n", m_id);
+				invalidate_resources();
+			}
 		}
 	}
+	else
+		// No notification available, the cache can't be trusted
+		invalidate_resources();
 
-	XRRFreeScreenResources(resources);
+	if (mp_resources)
+		return mp_resources;
 
-	return pxmode;
+	mp_resources = XRRGetScreenResourcesCurrent(m_pdisplay, m_root);
+	if (!mp_resources)
+	{
+		log_error("XRANDR: <%d> (get_resources) [ERROR] could not get screen resources\n", m_id);
+		return NULL;
+	}
+
+	mp_output_info = XRRGetOutputInfo(m_pdisplay, mp_resources, mp_resources->outputs[m_desktop_output]);
+	if (!mp_output_info)
+	{
+		log_error("XRANDR: <%d> (get_resources) [ERROR] could not get output 0x%x information\n", m_id, (unsigned int)mp_resources->outputs[m_desktop_output]);
+		invalidate_resources();
+		return NULL;
+	}
+
+	// Index modes by id
+	m_mode_map.reserve(mp_resources->nmode);
+	for (int m = 0; m < mp_resources->nmode; m++)
+		m_mode_map[mp_resources->modes[m].id] = &mp_resources->modes[m];
+
+	return mp_resources;
+}
+
+//============================================================
+//  xrandr_timing::invalidate_resources
+//============================================================
+
+void xrandr_timing::invalidate_resources()
+{
+	m_mode_map.clear();
+
+	if (mp_output_info)
+	{
+		XRRFreeOutputInfo(mp_output_info);
+		mp_output_info = NULL;
+	}
+
+	if (mp_resources)
+	{
+		XRRFreeScreenResources(mp_resources);
+		mp_resources = NULL;
+	}
 }
 
 //============================================================
@@ -769,6 +894,10 @@ bool xrandr_timing::set_timing(modeline *mode, int flags)
 	if (m_id != 1 && (flags & XRANDR_ENABLE_SCREEN_REORDERING))
 		flags = XRANDR_DISABLE_CRTC_RELOCATION; // only master can do global screen preparation
 
+	XRRScreenResources *resources = get_resources();
+	if (!resources)
+		return false;
+
 	XRRModeInfo *pxmode = NULL;
 
 	if (mode->type & MODE_DESKTOP)
@@ -783,7 +912,6 @@ bool xrandr_timing::set_timing(modeline *mode, int flags)
 	}
 
 	// Use xrandr to switch to new mode.
-	XRRScreenResources *resources = XRRGetScreenResourcesCurrent(m_pdisplay, m_root);
 	XRROutputInfo *output_info = XRRGetOutputInfo(m_pdisplay, resources, resources->outputs[m_desktop_output]);
 	XRRCrtcInfo *crtc_info = XRRGetCrtcInfo(m_pdisplay, resources, output_info->crtc);
 
@@ -801,7 +929,7 @@ bool xrandr_timing::set_timing(modeline *mode, int flags)
 	}
 
 	// Grab X server to prevent unwanted interaction from the window manager
-	XGrabServer(m_pdisplay);
+	grab_server();
 
 	unsigned int width = m_min_width;
 	unsigned int height = m_min_height;
@@ -992,7 +1120,7 @@ bool xrandr_timing::set_timing(modeline *mode, int flags)
 	delete[]global_crtc;
 
 	// Release X server, events can be processed now
-	XUngrabServer(m_pdisplay);
+	ungrab_server();
 
 	if (ms_xerrors & ms_xerrors_flag)
 		log_error("XRANDR: <%d> (set_timing) [ERROR] in %s\n", m_id, "XRRSetCrtcConfig");
@@ -1010,11 +1138,76 @@ bool xrandr_timing::set_timing(modeline *mode, int flags)
 
 	XRRFreeCrtcInfo(crtc_info);
 	XRRFreeOutputInfo(output_info);
-	XRRFreeScreenResources(resources);
+
+	// Our own change, resources need to be fetched again
+	invalidate_resources();
 
 	return (ms_xerrors == 0 && crtc_info->mode != 0);
 }
 
+//============================================================
+//  xrandr_timing::update_timing
+//============================================================
+
+bool xrandr_timing::update_timing(modeline *mode)
+{
+	if (!mode || (mode->type & MODE_DESKTOP) || m_desktop_output == -1 || !m_managed)
+		return set_timing(mode);
+
+	XRRScreenResources *resources = get_resources();
+	if (!resources)
+		return false;
+
+	XRRModeInfo *pxmode = find_mode(mode);
+	if (pxmode == NULL)
+	{
+		log_error("XRANDR: <%d> (update_timing) [ERROR] mode not found\n", m_id);
+		return false;
+	}
+
+	XRRCrtcInfo *crtc_info = XRRGetCrtcInfo(m_pdisplay, resources, mp_output_info->crtc);
+	auto active = m_mode_map.find(crtc_info->mode);
+
+	// Without a size change, the crtc stays where it is and neither the screen nor the other
+	// crtcs have to be relocated
+	if (active == m_mode_map.end() || active->second->width != pxmode->width || active->second->height != pxmode->height)
+	{
+		XRRFreeCrtcInfo(crtc_info);
+		return set_timing(mode);
+	}
+
+	if (crtc_info->mode == pxmode->id)
+	{
+		log_verbose("XRANDR: <%d> (update_timing) mode [%04lx] is already active\n", m_id, pxmode->id);
+		XRRFreeCrtcInfo(crtc_info);
+		return true;
+	}
+
+	XSync(m_pdisplay, False);
+	ms_xerrors = 0;
+	ms_xerrors_flag = 0x01;
+	old_error_handler = XSetErrorHandler(error_handler);
+	Status status = XRRSetCrtcConfig(m_pdisplay, resources, mp_output_info->crtc, CurrentTime, crtc_info->x, crtc_info->y, pxmode->id, crtc_info->rotation, crtc_info->outputs, crtc_info->noutput);
+	XSync(m_pdisplay, False);
+	XSetErrorHandler(old_error_handler);
+
+	bool result = status == RRSetConfigSuccess && !(ms_xerrors & ms_xerrors_flag);
+	if (!result)
+		log_error("XRANDR: <%d> (update_timing) [ERROR] in %s\n", m_id, "XRRSetCrtcConfig");
+	else
+	{
+		log_verbose("XRANDR: <%d> (update_timing) mode [%04lx] set in place %ux%u+%d+%d\n", m_id, pxmode->id, crtc_info->width, crtc_info->height, crtc_info->x, crtc_info->y);
+		m_last_crtc = *crtc_info;
+		m_last_crtc.mode = pxmode->id;
+	}
+	XRRFreeCrtcInfo(crtc_info);
+
+	// Our own change, resources need to be fetched again
+	invalidate_resources();
+
+	return result;
+}
+
 //============================================================
 //  xrandr_timing::delete_mode
 //============================================================
@@ -1037,58 +1230,65 @@ bool xrandr_timing::delete_mode(modeline *mode)
 	if (!mode)
 		return false;
 
-	XRRScreenResources *resources = XRRGetScreenResourcesCurrent(m_pdisplay, m_root);
+	XRRScreenResources *resources = get_resources();
+	if (!resources)
+		return false;
+
+	// Nothing to delete if the mode id is unknown
+	XRRModeInfo *pxmode = mode->platform_data != 0 ? find_mode(mode) : NULL;
+	if (pxmode == NULL)
+		return true;
+
+	// Keep a copy, cached resources will be invalidated if the desktop mode has to be restored
+	RRMode mode_id = pxmode->id;
+	RROutput output = resources->outputs[m_desktop_output];
+	char name[64];
+	snprintf(name, sizeof(name), "%s", pxmode->name);
 
 	int total_xerrors = 0;
+
 	// Delete modeline
-	for (int m = 0; m < resources->nmode && mode->platform_data != 0; m++)
+	XRRCrtcInfo *crtc_info = XRRGetCrtcInfo(m_pdisplay, resources, mp_output_info->crtc);
+	if (mode_id == crtc_info->mode)
 	{
-		if (mode->platform_data == resources->modes[m].id)
+		log_verbose("XRANDR: <%d> (delete_mode) [WARNING] modeline [%04lx] is currently active, restoring desktop mode first\n", m_id, mode_id);
+		modeline desktop_mode = {};
+		desktop_mode.type |= MODE_DESKTOP;
+		if (!set_timing(&desktop_mode, 0))
 		{
-			XRROutputInfo *output_info = XRRGetOutputInfo(m_pdisplay, resources, resources->outputs[m_desktop_output]);
-			XRRCrtcInfo *crtc_info = XRRGetCrtcInfo(m_pdisplay, resources, output_info->crtc);
-			if (resources->modes[m].id == crtc_info->mode)
-			{
-				log_verbose("XRANDR: <%d> (delete_mode) [WARNING] modeline [%04lx] is currently active, restoring desktop mode first\n", m_id, resources->modes[m].id);
-				modeline desktop_mode = {};
-				desktop_mode.type |= MODE_DESKTOP;
-				if (!set_timing(&desktop_mode, 0))
-				{
-					log_error("XRANDR: <%d> (delete_mode) [ERROR] Could not restore desktop mode\n", m_id);
-					return false;
-				}
-			}
-
+			log_error("XRANDR: <%d> (delete_mode) [ERROR] Could not restore desktop mode\n", m_id);
 			XRRFreeCrtcInfo(crtc_info);
-			XRRFreeOutputInfo(output_info);
+			return false;
+		}
+	}
+	XRRFreeCrtcInfo(crtc_info);
 
-			log_verbose("XRANDR: <%d> (delete_mode) remove mode %s\n", m_id, resources->modes[m].name);
+	log_verbose("XRANDR: <%d> (delete_mode) remove mode %s\n", m_id, name);
 
-			XSync(m_pdisplay, False);
-			ms_xerrors = 0;
-			ms_xerrors_flag = 0x01;
-			old_error_handler = XSetErrorHandler(error_handler);
-			XRRDeleteOutputMode(m_pdisplay, resources->outputs[m_desktop_output], resources->modes[m].id);
-			if (ms_xerrors & ms_xerrors_flag)
-			{
-				log_error("XRANDR: <%d> (delete_mode) [ERROR] in %s\n", m_id, "XRRDeleteOutputMode");
-				total_xerrors++;
-			}
+	XSync(m_pdisplay, False);
+	ms_xerrors = 0;
+	ms_xerrors_flag = 0x01;
+	old_error_handler = XSetErrorHandler(error_handler);
+	XRRDeleteOutputMode(m_pdisplay, output, mode_id);
+	if (ms_xerrors & ms_xerrors_flag)
+	{
+		log_error("XRANDR: <%d> (delete_mode) [ERROR] in %s\n", m_id, "XRRDeleteOutputMode");
+		total_xerrors++;
+	}
 
-			ms_xerrors_flag = 0x02;
-			XRRDestroyMode(m_pdisplay, resources->modes[m].id);
-			XSync(m_pdisplay, False);
-			XSetErrorHandler(old_error_handler);
-			if (ms_xerrors & ms_xerrors_flag)
-			{
-				log_error("XRANDR: <%d> (delete_mode) [ERROR] in %s\n", m_id, "XRRDestroyMode");
-				total_xerrors++;
-			}
-			mode->platform_data = 0;
-		}
+	ms_xerrors_flag = 0x02;
+	XRRDestroyMode(m_pdisplay, mode_id);
+	XSync(m_pdisplay, False);
+	XSetErrorHandler(old_error_handler);
+	if (ms_xerrors & ms_xerrors_flag)
+	{
+		log_error("XRANDR: <%d> (delete_mode) [ERROR] in %s\n", m_id, "XRRDestroyMode");
+		total_xerrors++;
 	}
+	mode->platform_data = 0;
 
-	XRRFreeScreenResources(resources);
+	// Our own change, resources need to be fetched again
+	invalidate_resources();
 
 	return total_xerrors == 0;
 }
@@ -1106,56 +1306,16 @@ bool xrandr_timing::get_timing(modeline *mode)
 		return false;
 	}
 
-	XRRScreenResources *resources = XRRGetScreenResourcesCurrent(m_pdisplay, m_root);
-	XRROutputInfo *output_info = XRRGetOutputInfo(m_pdisplay, resources, resources->outputs[m_desktop_output]);
+	if (!get_resources())
+		return false;
 
 	// Cycle through the modelines and report them back to the display manager
-	if (m_video_modes_position < output_info->nmode)
+	if (m_video_modes_position < mp_output_info->nmode)
 	{
-		for (int m = 0; m < resources->nmode; m++)
-		{
-			XRRModeInfo *pxmode = &resources->modes[m];
+		auto it = m_mode_map.find(mp_output_info->modes[m_video_modes_position]);
+		if (it != m_mode_map.end())
+			xrrmode_to_modeline(it->second, mode);
 
-			if (pxmode->id == output_info->modes[m_video_modes_position])
-			{
-				mode->platform_data = pxmode->id;
-
-				mode->pclock     = pxmode->dotClock;
-				mode->hactive    = pxmode->width;
-				mode->hbegin     = pxmode->hSyncStart;
-				mode->hend       = pxmode->hSyncEnd;
-				mode->htotal     = pxmode->hTotal;
-				mode->vactive    = pxmode->height;
-				mode->vbegin     = pxmode->vSyncStart;
-				mode->vend       = pxmode->vSyncEnd;
-				mode->vtotal     = pxmode->vTotal;
-				mode->interlace  = (pxmode->modeFlags & RR_Interlace) ? 1 : 0;
-				mode->doublescan = (pxmode->modeFlags & RR_DoubleScan) ? 1 : 0;
-				mode->hsync      = (pxmode->modeFlags & RR_HSyncPositive) ? 1 : 0;
-				mode->vsync      = (pxmode->modeFlags & RR_VSyncPositive) ? 1 : 0;
-
-				mode->hfreq      = mode->pclock / mode->htotal;
-				mode->vfreq      = mode->hfreq / mode->vtotal * (mode->interlace ? 2 : 1);
-				mode->refresh    = mode->vfreq;
-
-				mode->width      = pxmode->width;
-				mode->height     = pxmode->height;
-
-				// Add the rotation flag from the crtc
-				mode->type |= m_crtc_flags;
-
-				mode->type |= CUSTOM_VIDEO_TIMING_XRANDR;
-
-				if (strncmp(pxmode->name, "SR-", 3) == 0)
-					log_verbose("XRANDR: <%d> (get_timing) [WARNING] modeline %s detected\n", m_id, pxmode->name);
-
-				// Add the desktop flag to desktop modeline
-				if (m_desktop_mode.id == pxmode->id)
-					mode->type |= MODE_DESKTOP;
-
-				log_verbose("XRANDR: <%d> (get_timing) mode %04lx %dx%d refresh %.6f added\n", m_id, pxmode->id, pxmode->width, pxmode->height, mode->vfreq);
-			}
-		}
 		m_video_modes_position++;
 	}
 	else
@@ -1164,41 +1324,166 @@ bool xrandr_timing::get_timing(modeline *mode)
 		m_video_modes_position = 0;
 	}
 
-	XRRFreeOutputInfo(output_info);
-	XRRFreeScreenResources(resources);
+	return true;
+}
+
+//============================================================
+//  xrandr_timing::get_timings
+//============================================================
+
+bool xrandr_timing::get_timings(std::vector<modeline> &modes)
+{
+	// Handle no screen detected case
+	if (m_desktop_output == -1)
+	{
+		log_error("XRANDR: <%d> (get_timings) [ERROR] no screen detected\n", m_id);
+		return false;
+	}
+
+	if (!get_resources())
+		return false;
+
+	modes.reserve(modes.size() + mp_output_info->nmode);
+
+	// Report all the output modelines from a single resources snapshot
+	for (int o = 0; o < mp_output_info->nmode; o++)
+	{
+		auto it = m_mode_map.find(mp_output_info->modes[o]);
+		if (it == m_mode_map.end())
+			continue;
+
+		modeline mode = {};
+		xrrmode_to_modeline(it->second, &mode);
+		modes.push_back(mode);
+	}
 
 	return true;
 }
 
+//============================================================
+//  xrandr_timing::xrrmode_to_modeline
+//============================================================
+
+void xrandr_timing::xrrmode_to_modeline(XRRModeInfo *pxmode, modeline *mode)
+{
+	mode->platform_data = pxmode->id;
+
+	mode->pclock     = pxmode->dotClock;
+	mode->hactive    = pxmode->width;
+	mode->hbegin     = pxmode->hSyncStart;
+	mode->hend       = pxmode->hSyncEnd;
+	mode->htotal     = pxmode->hTotal;
+	mode->vactive    = pxmode->height;
+	mode->vbegin     = pxmode->vSyncStart;
+	mode->vend       = pxmode->vSyncEnd;
+	mode->vtotal     = pxmode->vTotal;
+	mode->interlace  = (pxmode->modeFlags & RR_Interlace) ? 1 : 0;
+	mode->doublescan = (pxmode->modeFlags & RR_DoubleScan) ? 1 : 0;
+	mode->hsync      = (pxmode->modeFlags & RR_HSyncPositive) ? 1 : 0;
+	mode->vsync      = (pxmode->modeFlags & RR_VSyncPositive) ? 1 : 0;
+
+	mode->hfreq      = mode->pclock / mode->htotal;
+	mode->vfreq      = mode->hfreq / mode->vtotal * (mode->interlace ? 2 : 1);
+	mode->refresh    = mode->vfreq;
+
+	mode->width      = pxmode->width;
+	mode->height     = pxmode->height;
+
+	// Add the rotation flag from the crtc
+	mode->type |= m_crtc_flags;
+
+	mode->type |= CUSTOM_VIDEO_TIMING_XRANDR;
+
+	if (strncmp(pxmode->name, "SR-", 3) == 0)
+		log_verbose("XRANDR: <%d> (get_timing) [WARNING] modeline %s detected\n", m_id, pxmode->name);
+
+	// Add the desktop flag to desktop modeline
+	if (m_desktop_mode.id == pxmode->id)
+		mode->type |= MODE_DESKTOP;
+
+	log_verbose("XRANDR: <%d> (get_timing) mode %04lx %dx%d refresh %.6f added\n", m_id, pxmode->id, pxmode->width, pxmode->height, mode->vfreq);
+}
+
 //============================================================
 //  xrandr_timing::process_modelist
 //============================================================
 
 bool xrandr_timing::process_modelist(std::vector<modeline *> modelist)
 {
-	bool error = false;
-	bool result = false;
+	// A single server grab for the whole change set, so other clients never see it half
+	// applied, even when it has to be rolled back
+	grab_server();
+	bool result = apply_modelist(modelist);
+	ungrab_server();
 
-	for (auto &mode : modelist)
-	{
-		if (mode->type & MODE_DELETE)
-			result = delete_mode(mode);
+	if (m_pdisplay)
+		XSync(m_pdisplay, False);
 
-		else if (mode->type & MODE_ADD)
-			result = add_mode(mode);
+	return result;
+}
 
-		else if (mode->type & MODE_UPDATE)
-			result = update_mode(mode);
+//============================================================
+//  xrandr_timing::save_mode
+//============================================================
 
-		if (!result)
-		{
-			mode->type |= MODE_ERROR;
-			error = true;
-		}
-		else
-			// succeed
-			mode->type &= ~MODE_ERROR;
+bool xrandr_timing::save_mode(modeline *mode, modeline *previous)
+{
+	if (!get_resources())
+		return false;
+
+	*previous = *mode;
+
+	// Not on the server yet, there's nothing to put back
+	XRRModeInfo *pxmode = find_mode(mode);
+	if (pxmode == NULL)
+	{
+		previous->platform_data = 0;
+		return true;
 	}
 
-	return !error;
+	xrrmode_to_modeline(pxmode, previous);
+	return true;
+}
+
+//============================================================
+//  xrandr_timing::restore_mode
+//============================================================
+
+bool xrandr_timing::restore_mode(modeline *mode, modeline *previous)
+{
+	// Drop the new timings, then bring the old ones back under a new mode id
+	if (!delete_mode(mode))
+		return false;
+
+	if (previous->platform_data == 0)
+		return true;
+
+	previous->platform_data = 0;
+	if (!add_mode(previous))
+		return false;
+
+	mode->platform_data = previous->platform_data;
+	return true;
+}
+
+//============================================================
+//  xrandr_timing::grab_server
+//============================================================
+
+// Server grabs don't nest, count them so that a mode switch inside a
+// change set doesn't release the grab of the whole set
+void xrandr_timing::grab_server()
+{
+	if (m_pdisplay && m_grab_count++ == 0)
+		XGrabServer(m_pdisplay);
+}
+
+//============================================================
+//  xrandr_timing::ungrab_server
+//============================================================
+
+void xrandr_timing::ungrab_server()
+{
+	if (m_pdisplay && m_grab_count > 0 && --m_grab_count == 0)
+		XUngrabServer(m_pdisplay);
 }
@@ -17,6 +17,7 @@
 
 // X11 Xrandr headers
 #include <X11/extensions/Xrandr.h>
+#include <unordered_map>
 #include "custom_video.h"
 
 // Set timing option flags
@@ -44,6 +45,7 @@ class xrandr_timing : public custom_video
 		~xrandr_timing();
 		const char *api_name() { return "XRANDR"; }
 		int caps() { return CUSTOM_VIDEO_CAPS_ADD; }
+		uint64_t pclock_step() { return 0; } // dotClock is in Hz
 		bool init();
 
 		bool add_mode(modeline *mode);
@@ -51,9 +53,13 @@ class xrandr_timing : public custom_video
 		bool update_mode(modeline *mode);
 
 		bool get_timing(modeline *mode);
+		bool get_timings(std::vector<modeline> &modes);
 		bool set_timing(modeline *mode);
+		bool update_timing(modeline *mode);
 
 		bool process_modelist(std::vector<modeline *>);
+		bool save_mode(modeline *mode, modeline *previous);
+		bool restore_mode(modeline *mode, modeline *previous);
 
 		static int ms_xerrors;
 		static int ms_xerrors_flag;
@@ -61,14 +67,22 @@ class xrandr_timing : public custom_video
 	private:
 		int m_id = 0;
 		int m_managed = 0;
+		int m_grab_count = 0;
 		int m_enable_screen_reordering = 0;
 		int m_enable_screen_compositing = 0;
 
 		XRRModeInfo *find_mode(modeline *mode);
 		XRRModeInfo *find_mode_by_name(char *name);
 
+		XRRScreenResources *get_resources();
+		void invalidate_resources();
+		void xrrmode_to_modeline(XRRModeInfo *pxmode, modeline *mode);
+
 		bool set_timing(modeline *mode, int flags);
 
+		void grab_server();
+		void ungrab_server();
+
 		int m_video_modes_position = 0;
 		char m_device_name[32];
 		Rotation m_desktop_rotation;
@@ -87,6 +101,12 @@ class xrandr_timing : public custom_video
 
 		XRRCrtcInfo m_last_crtc = {};
 
+		// Cached screen resources, valid until a RandR event or our own change
+		XRRScreenResources *mp_resources = NULL;
+		XRROutputInfo *mp_output_info = NULL;
+		std::unordered_map<RRMode, XRRModeInfo *> m_mode_map;
+		int m_event_base = 0;
+
 		void *m_xrandr_handle = 0;
 
 		__typeof__(XRRAddOutputMode) *p_XRRAddOutputMode;
@@ -106,6 +126,8 @@ class xrandr_timing : public custom_video
 		__typeof__(XRRSetCrtcConfig) *p_XRRSetCrtcConfig;
 		__typeof__(XRRSetScreenSize) *p_XRRSetScreenSize;
 		__typeof__(XRRGetScreenSizeRange) *p_XRRGetScreenSizeRange;
+		__typeof__(XRRQueryExtension) *p_XRRQueryExtension;
+		__typeof__(XRRSelectInput) *p_XRRSelectInput;
 
 		void *m_x11_handle = 0;
 
@@ -118,6 +140,8 @@ class xrandr_timing : public custom_video
 		__typeof__(XClearWindow) *p_XClearWindow;
 		__typeof__(XFillRectangle) *p_XFillRectangle;
 		__typeof__(XCreateGC) *p_XCreateGC;
+		__typeof__(XPending) *p_XPending;
+		__typeof__(XNextEvent) *p_XNextEvent;
 };
 
 #endif
@@ -15,6 +15,7 @@
 #include <stdio.h>
 #include <ctype.h>
 #include <string.h>
+#include <algorithm>
 #include "display.h"
 #if defined(_WIN32)
 #include "display_windows.h"
@@ -27,6 +28,12 @@
 
 #include "log.h"
 
+// Below this, waking up the workers costs more than they save
+#define MIN_PARALLEL_CANDIDATES 8
+
+// Modes bounded at a time by the serial search, small enough to still profit from a perfect match
+#define CANDIDATE_BLOCK 256
+
 
 //============================================================
 //  display_manager::make
@@ -158,6 +165,7 @@ bool display_manager::add_mode(modeline *mode)
 	}
 
 	mode->type &= ~MODE_ADD;
+	m_modes_serial++;
 
 	log_verbose("Switchres: added ");
 	log_mode(mode);
@@ -181,8 +189,8 @@ bool display_manager::delete_mode(modeline *mode)
 	log_verbose("Switchres: deleted ");
 	log_mode(mode);
 
-	ptrdiff_t i = mode - &video_modes[0];
-	video_modes.erase(video_modes.begin() + i);
+	erase_mode(mode - &video_modes[0]);
+	m_modes_serial++;
 
 	return true;
 }
@@ -202,6 +210,7 @@ bool display_manager::update_mode(modeline *mode)
 	}
 
 	mode->type &= ~MODE_UPDATE;
+	m_modes_serial++;
 
 	log_verbose("Switchres: updated ");
 	log_mode(mode);
@@ -236,9 +245,14 @@ bool display_manager::restore_modes()
 	// Compare each mode in our table with its original state
 	for (unsigned i = video_modes.size(); i-- > 0; )
 	{
-		// First, delete all modes we've added
+		// First, delete all modes we've added. Those the driver refused later on are
+		// still there, flush them again, only new modes it refused have nothing to delete
 		if (i + 1 > backup_modes.size())
+		{
 			video_modes[i].type |= MODE_DELETE;
+			if (!(video_modes[i].type & MODE_ADD))
+				video_modes[i].type &= ~MODE_ERROR;
+		}
 
 		// Now restore all modes which timings have been modified
 		else if (modeline_is_different(&video_modes[i], &backup_modes[i]))
@@ -251,6 +265,24 @@ bool display_manager::restore_modes()
 	return flush_modes();
 }
 
+//============================================================
+//  display_manager::vrr_refresh
+//============================================================
+
+double display_manager::vrr_refresh(double refresh, double mode_vfreq)
+{
+	double vrr_min, vrr_max;
+	if (refresh <= 0 || mode_vfreq <= 0 || !vrr_range(&vrr_min, &vrr_max))
+		return 0;
+
+	// Variable refresh only stretches the vertical blanking, it can't go faster than the mode
+	vrr_max = std::min(vrr_max, mode_vfreq);
+
+	// The lowest multiple of the refresh inside the window, each frame is shown that many times
+	double vfreq = refresh * std::max(1.0, ceil(vrr_min / refresh));
+	return vfreq <= vrr_max? vfreq : 0;
+}
+
 //============================================================
 //  display_manager::flush_modes
 //============================================================
@@ -260,41 +292,64 @@ bool display_manager::flush_modes()
 	bool error = false;
 	std::vector<modeline *> modified_modes = {};
 
-	// Loop through our mode table to collect all pending changes
+	// Loop through our mode table to collect all pending changes. Modes the driver
+	// has refused are left out, they would bring the whole change set down again
 	for (auto &mode : video_modes)
-		if (mode.type & (MODE_UPDATE | MODE_ADD | MODE_DELETE))
+		if ((mode.type & (MODE_UPDATE | MODE_ADD | MODE_DELETE)) && !(mode.type & MODE_ERROR))
 			modified_modes.push_back(&mode);
 
+	std::vector<bool> applied(video_modes.size(), false);
+
 	// Flush pending changes to driver
 	if (modified_modes.size() > 0)
 	{
+		m_modes_serial++;
+
+		// Backends apply the whole set or roll it back, then report each mode
+		bool result = true;
 		if (video() != nullptr)
-			video()->process_modelist(modified_modes);
+			result = video()->process_modelist(modified_modes);
 
 		// Log error/success result for each mode
-		for (auto &mode : modified_modes)
+		const char *status_txt[] = { "success", "error", "rolled back", "skipped" };
+		for (size_t i = 0; i < modified_modes.size(); i++)
 		{
-			log_verbose("Switchres: %s %s mode ", mode->type & MODE_ERROR? "error" : "success", mode->type & MODE_DELETE? "deleting" : mode->type & MODE_ADD? "adding" : "updating");
+			modeline *mode = modified_modes[i];
+			int status = mode->type & MODE_ERROR? MODELIST_FAILED : MODELIST_APPLIED;
+
+			if (!result && i < video()->modelist_results().size() && video()->modelist_results()[i].mode == mode)
+				status = video()->modelist_results()[i].status;
+
+			log_verbose("Switchres: %s %s mode ", status_txt[status], mode->type & MODE_DELETE? "deleting" : mode->type & MODE_ADD? "adding" : "updating");
 			log_mode(mode);
 
-			if (mode->type & MODE_ERROR)
+			applied[mode - &video_modes[0]] = status == MODELIST_APPLIED;
+			if (status != MODELIST_APPLIED)
 				error = true;
 		}
 
-		// Update our internal mode table to reflect the changes
-		for (unsigned i = video_modes.size(); i-- > 0; )
-		{
-			if (video_modes[i].type & MODE_ERROR)
-				continue;
+		if (!result)
+			log_error("Switchres: error flushing modes, pending changes kept\n");
+	}
 
-			if (video_modes[i].type & MODE_DELETE)
-			{
-				video_modes.erase(video_modes.begin() + i);
-				m_selected_mode = 0;
-			}
-			else
-				video_modes[i].type &= ~(MODE_UPDATE | MODE_ADD);
+	// Update our internal mode table to reflect the changes, modes that were not
+	// applied stay pending
+	for (unsigned i = video_modes.size(); i-- > 0; )
+	{
+		// A new mode the driver refused has nothing to delete there
+		bool dropped = (video_modes[i].type & (MODE_ERROR | MODE_ADD | MODE_DELETE)) == (MODE_ERROR | MODE_ADD | MODE_DELETE);
+
+		if (!applied[i] && !dropped)
+			continue;
+
+		if (video_modes[i].type & MODE_DELETE)
+		{
+			erase_mode(i);
+			m_selected_mode = 0;
+			m_modes_serial++;
 		}
+		else
+			video_modes[i].type &= ~(MODE_UPDATE | MODE_ADD);
 	}
 
 	return !error;
@@ -306,6 +361,9 @@ bool display_manager::flush_modes()
 
 bool display_manager::filter_modes()
 {
+	m_modes_serial++;
+	update_mode_index();
+
 	for (auto &mode : video_modes)
 	{
 		// apply options to mode type
@@ -353,7 +411,6 @@ bool display_manager::filter_modes()
 modeline *display_manager::get_mode(int width, int height, float refresh, int flags)
 {
 	modeline s_mode = {};
-	modeline t_mode = {};
 	modeline best_mode = {};
 	char result[256]={'\x00'};
 
@@ -363,96 +420,137 @@ modeline *display_manager::get_mode(int width, int height, float refresh, int fl
 	log_info("Switchres: Calculating best video mode for %dx%d@%.6f%s orientation: %s\n",
 						width, height, refresh, interlaced?"i":"", rotated?"rotated":"normal");
 
-	best_mode.result.weight |= R_OUT_OF_RANGE;
+	// Check if we already have the result for this request
+	uint64_t profile_hash = mode_profile_hash();
+	uint64_t settings_hash = mode_cache_settings_hash(profile_hash);
+	uint64_t cache_key = settings_hash;
+	cache_key = (cache_key ^ (uint32_t)width) * 0x100000001b3ULL;
+	cache_key = (cache_key ^ (uint32_t)height) * 0x100000001b3ULL;
+	cache_key = (cache_key ^ (uint32_t)flags) * 0x100000001b3ULL;
+	cache_key = (cache_key ^ (uint64_t)(refresh * 1000000.0)) * 0x100000001b3ULL;
+
+	auto cached = m_mode_cache.find(cache_key);
+	if (cached != m_mode_cache.end())
+	{
+		mode_cache_entry *entry = &cached->second;
+		if (entry->width == width && entry->height == height && entry->refresh == refresh && entry->flags == flags && entry->settings_hash == settings_hash)
+		{
+			modeline *mode = entry->found ? find_mode_by_id(entry->best_mode.id) : nullptr;
+			if (!entry->found || mode != nullptr)
+			{
+				m_mode_cache_hits++;
+				if (!entry->found)
+				{
+					m_selected_mode = 0;
+					log_error("Switchres: could not find a video mode that meets your specs\n");
+					return nullptr;
+				}
+
+				log_verbose("Switchres: using cached result (%dx%d@%.6f)\n", entry->best_mode.hactive, entry->best_mode.vactive, entry->best_mode.vfreq);
+				*mode = entry->best_mode;
+				m_selected_mode = mode;
+				m_adjustment = entry->adjustment;
+				m_has_adjustment = true;
+				m_switching_required = (m_current_mode != m_selected_mode);
+				return m_selected_mode;
+			}
+		}
+	}
+	m_mode_cache_misses++;
 
-	s_mode.interlace = interlaced;
-	s_mode.vfreq = refresh;
+	// Keep the cache bounded
+	if (m_mode_cache.size() >= MAX_MODELINES)
+		m_mode_cache.clear();
 
-	s_mode.hactive = width;
-	s_mode.vactive = height;
+	mode_cache_entry entry = {};
+	entry.width = width;
+	entry.height = height;
+	entry.refresh = refresh;
+	entry.flags = flags;
+	entry.settings_hash = settings_hash;
 
-	if (rotated)
-	{
-		std::swap(s_mode.hactive, s_mode.vactive);
-		s_mode.type |= MODE_ROTATED;
-	}
+	best_mode.result.weight |= R_OUT_OF_RANGE;
+
+	// With variable refresh, a refresh inside the window is left to the frame pacing, and the mode
+	// is picked for the desktop refresh instead, so the mode on screen can be kept
+	double vrr_vfreq = vrr_refresh(refresh, desktop_mode.vfreq);
+	init_source(width, height, vrr_vfreq > 0? desktop_mode.vfreq : refresh, flags, &s_mode);
 
 	// Create a dummy mode entry if allowed
-	if (caps() & CUSTOM_VIDEO_CAPS_ADD && m_ds.modeline_generation)
+	bool new_mode_allowed = caps() & CUSTOM_VIDEO_CAPS_ADD && m_ds.modeline_generation;
+	if (new_mode_allowed)
 	{
 		modeline new_mode = {};
 		new_mode.type = XYV_EDITABLE | V_FREQ_EDITABLE | SCAN_EDITABLE | MODE_ADD | (desktop_is_rotated()? MODE_ROTATED : MODE_OK);
-		video_modes.push_back(new_mode);
+		push_mode(new_mode);
 	}
 
-	// Run through our mode list and find the most suitable mode
-	for (auto &mode : video_modes)
+	// Look for this request in the persistent cache
+	mode_cache_record record = {};
+	mode_cache_record stored = {};
+	bool have_stored = false;
+	if (m_ds.modeline_cache && open_mode_cache_file())
 	{
-		log_verbose("\nSwitchres: %s%4d%sx%s%4d%s_%s%d=%.6fHz%s%s\n",
-			mode.type & X_RES_EDITABLE?"(":"[", mode.width, mode.type & X_RES_EDITABLE?")":"]",
-			mode.type & Y_RES_EDITABLE?"(":"[", mode.height, mode.type & Y_RES_EDITABLE?")":"]",
-			mode.type & V_FREQ_EDITABLE?"(":"[", mode.refresh, mode.vfreq, mode.type & V_FREQ_EDITABLE?")":"]",
-			mode.type & MODE_DISABLED?" - locked":"");
-
-		// now get the mode if allowed
-		if (mode.type & MODE_DISABLED)
-			continue;
+		record.key = mode_cache_file_key(profile_hash, width, height, refresh, flags);
+		record.width = width;
+		record.height = height;
+		record.refresh = refresh;
+		record.flags = flags;
+		have_stored = m_mode_cache_file.find(record.key, width, height, refresh, flags, &stored);
+
+		// Only trust records that fit our mode list
+		if (have_stored && (stored.selected >= (int)video_modes.size() || (stored.selected == MODE_CACHE_NEW_MODE && !new_mode_allowed)))
+			have_stored = false;
+	}
 
-		for (int i = 0 ; i < MAX_RANGES ; i++)
+	if (have_stored)
+	{
+		m_mode_cache_file_hits++;
+		best_mode = stored.best_mode;
+		if (stored.selected == MODE_CACHE_NOT_FOUND)
+			m_selected_mode = 0;
+		else if (stored.selected == MODE_CACHE_NEW_MODE)
+			m_selected_mode = &video_modes.back();
+		else
 		{
-			if (range[i].hfreq_min == 0)
-				continue;
-
-			t_mode = mode;
-
-			// init all editable fields with source or user values
-			if (t_mode.type & X_RES_EDITABLE)
-				t_mode.hactive = m_user_mode.width? m_user_mode.width : s_mode.hactive;
-
-			if (t_mode.type & Y_RES_EDITABLE)
-				t_mode.vactive = m_user_mode.height? m_user_mode.height : s_mode.vactive;
-
-			if (t_mode.type & V_FREQ_EDITABLE)
-			{
-				// If user's vfreq is defined, it means we have an user modeline, so force it
-				if (m_user_mode.vfreq)
-					modeline_copy_timings(&t_mode, &m_user_mode);
-				else
-					t_mode.vfreq = s_mode.vfreq;
-			}
-
-			// lock resolution fields if required
-			if (m_user_mode.width) t_mode.type &= ~X_RES_EDITABLE;
-			if (m_user_mode.height) t_mode.type &= ~Y_RES_EDITABLE;
-			if (m_user_mode.vfreq) t_mode.type &= ~V_FREQ_EDITABLE;
-
-			modeline_create(&s_mode, &t_mode, &range[i], &m_ds.gs);
-			t_mode.range = i;
-
-			log_verbose("%s\n", modeline_result(&t_mode, result));
+			// Ids and backend data belong to this session
+			m_selected_mode = &video_modes[stored.selected];
+			best_mode.id = m_selected_mode->id;
+			best_mode.platform_data = m_selected_mode->platform_data;
+		}
+		log_verbose("Switchres: using stored result (%dx%d@%.6f)\n", best_mode.hactive, best_mode.vactive, best_mode.vfreq);
+	}
+	else
+	{
+		find_best_mode(&s_mode, &best_mode);
 
-			if (modeline_compare(&t_mode, &best_mode))
-			{
-				best_mode = t_mode;
-				m_selected_mode = &mode;
-			}
+		if (record.key != 0)
+		{
+			if (best_mode.result.weight & R_OUT_OF_RANGE)
+				record.selected = MODE_CACHE_NOT_FOUND;
+			else if (new_mode_allowed && m_selected_mode == &video_modes.back())
+				record.selected = MODE_CACHE_NEW_MODE;
+			else
+				record.selected = m_selected_mode - &video_modes[0];
+			record.best_mode = best_mode;
+			m_mode_cache_file.store(&record);
 		}
 	}
 
 	// If we didn't need to create a new mode, remove our dummy entry
-	if (caps() & CUSTOM_VIDEO_CAPS_ADD && m_ds.modeline_generation && m_selected_mode != &video_modes.back())
+	if (new_mode_allowed && m_selected_mode != &video_modes.back())
 		video_modes.pop_back();
 
 	// If we didn't find a suitable mode, exit now
 	if (best_mode.result.weight & R_OUT_OF_RANGE)
 	{
+		m_mode_cache[cache_key] = entry;
 		m_selected_mode = 0;
 		log_error("Switchres: could not find a video mode that meets your specs\n");
 		return nullptr;
 	}
 
-	if ((best_mode.type & V_FREQ_EDITABLE) && !(best_mode.result.weight & R_OUT_OF_RANGE))
-		modeline_adjust(&best_mode, range[best_mode.range].hfreq_max, &m_ds.gs);
+	set_adjustment(&best_mode);
 
 	log_verbose("\nSwitchres: %s (%dx%d@%.6f)->(%dx%d@%.6f)\n", rotated?"rotated":"normal",
 		width, height, refresh, best_mode.hactive, best_mode.vactive, best_mode.vfreq);
@@ -470,8 +568,19 @@ modeline *display_manager::get_mode(int width, int height, float refresh, int fl
 			// lock new mode
 			best_mode.type &= ~(X_RES_EDITABLE | Y_RES_EDITABLE);
 		}
+		// New timings, give them a chance even if the driver refused the old ones
 		else if (modeline_is_different(&best_mode, m_selected_mode) != 0)
-			best_mode.type |= MODE_UPDATE;
+			best_mode.type = (best_mode.type | MODE_UPDATE) & ~MODE_ERROR;
+
+		// Let the backend validate the new timings before we go any further
+		if ((best_mode.type & (MODE_ADD | MODE_UPDATE)) && video() != nullptr && !video()->test_mode(&best_mode))
+		{
+			log_error("Switchres: modeline rejected by the %s backend\n", video()->api_name());
+			if (best_mode.type & MODE_ADD)
+				video_modes.pop_back();
+			m_selected_mode = 0;
+			return nullptr;
+		}
 
 		char modeline[256]={'\x00'};
 		log_info("Switchres: Modeline %s\n", modeline_print(&best_mode, modeline, MS_FULL));
@@ -484,10 +593,797 @@ modeline *display_manager::get_mode(int width, int height, float refresh, int fl
 	if (best_mode.id == 0)
 		best_mode.id = ++m_id_counter;
 
+	// The window ends at the refresh of the mode we got
+	best_mode.result.v_vrr = vrr_vfreq > 0? vrr_refresh(refresh, best_mode.vfreq) : 0;
+	if (best_mode.result.v_vrr > 0)
+		log_verbose("Switchres: %.6f Hz shown at %.6f Hz with variable refresh\n", refresh, best_mode.result.v_vrr);
+
 	*m_selected_mode = best_mode;
+	m_mode_index[best_mode.id] = m_selected_mode - &video_modes[0];
+
+	// New or updated modes change our mode list, don't cache them
+	if (best_mode.type & (MODE_ADD | MODE_UPDATE))
+		m_modes_serial++;
+	else
+	{
+		entry.found = true;
+		entry.best_mode = best_mode;
+		entry.adjustment = m_adjustment;
+		m_mode_cache[cache_key] = entry;
+	}
+
 	return m_selected_mode;
 }
 
+//============================================================
+//  display_manager::get_modes_ranked
+//============================================================
+
+int display_manager::get_modes_ranked(int width, int height, float refresh, int flags, modeline *modes, int k)
+{
+	// Same search as get_mode, keeping the k best candidates instead of one.
+	// Our mode list, selection and caches are left as they were
+	modeline s_mode = {};
+	modeline best_mode = {};
+
+	if (modes == nullptr || k <= 0)
+		return 0;
+
+	init_source(width, height, refresh, flags, &s_mode);
+
+	// The dummy mode only lives during the search
+	bool new_mode_allowed = caps() & CUSTOM_VIDEO_CAPS_ADD && m_ds.modeline_generation;
+	if (new_mode_allowed)
+	{
+		modeline new_mode = {};
+		new_mode.type = XYV_EDITABLE | V_FREQ_EDITABLE | SCAN_EDITABLE | MODE_ADD | (desktop_is_rotated()? MODE_ROTATED : MODE_OK);
+		push_mode(new_mode);
+	}
+
+	collect_candidates(&s_mode);
+	create_candidates(&s_mode);
+
+	if (new_mode_allowed)
+		video_modes.pop_back();
+
+	// First goes the one get_mode would pick, ties and all
+	std::vector<size_t> ranked;
+	modeline_score best_score;
+	best_mode.result.weight |= R_OUT_OF_RANGE;
+	modeline_score_key(&best_mode, &best_score);
+
+	size_t best = m_candidates.size();
+	for (size_t i = 0; i < m_candidates.size(); i++)
+	{
+		if (m_candidates[i].t_mode.result.weight & R_OUT_OF_RANGE)
+			continue;
+
+		ranked.push_back(i);
+		if (modeline_score_better(&m_candidates[i].t_mode, &m_candidates[i].score, &best_mode, &best_score))
+		{
+			best_mode = m_candidates[i].t_mode;
+			best_score = m_candidates[i].score;
+			best = i;
+		}
+	}
+
+	if (ranked.empty())
+	{
+		log_verbose("Switchres: no candidates for %dx%d@%.6f\n", width, height, refresh);
+		return 0;
+	}
+
+	// Then the rest by score, earlier modes first on ties
+	std::iter_swap(ranked.begin(), std::find(ranked.begin(), ranked.end(), best));
+	size_t count = std::min(ranked.size(), (size_t)k);
+	std::partial_sort(ranked.begin() + 1, ranked.begin() + count, ranked.end(), [&](size_t a, size_t b)
+	{
+		if (m_candidates[a].score == m_candidates[b].score)
+			return a < b;
+		return m_candidates[a].score < m_candidates[b].score;
+	});
+
+	for (size_t i = 0; i < count; i++)
+	{
+		modeline *mode = &modes[i];
+		*mode = m_candidates[ranked[i]].t_mode;
+
+		// Finish them as get_mode would, without committing anything
+		if (mode->type & V_FREQ_EDITABLE)
+		{
+			modeline_adjustment adj;
+			modeline_adjust_r(mode, range[mode->range].hfreq_max, &m_ds.gs, mode, &adj);
+			fit_pclock(mode, adj.range_rebuilt? &adj.range : &range[mode->range]);
+		}
+
+		if (mode->type & MODE_ADD)
+		{
+			mode->width = mode->hactive;
+			mode->height = mode->vactive;
+			mode->refresh = int(mode->vfreq);
+			mode->type &= ~(X_RES_EDITABLE | Y_RES_EDITABLE);
+		}
+	}
+
+	log_verbose("Switchres: %d of %d candidates ranked for %dx%d@%.6f\n", (int)count, (int)ranked.size(), width, height, refresh);
+	return count;
+}
+
+//============================================================
+//  display_manager::add_modes
+//============================================================
+
+int display_manager::add_modes(const mode_request *requests, int count, modeline *modes, bool flush)
+{
+	// get_mode for each request, with a single flush at the end. Modes that fail are returned
+	// with id 0, the rest are copies of the entries in our list, as they are after the flush
+	size_t batch_first = video_modes.size();
+	std::unordered_map<uint64_t, int> seen;
+	std::vector<int> ids(count, 0);
+	std::vector<int> locked;
+
+	// Room for every new mode plus get_mode's dummy entry, so the list is only grown once
+	if (video_modes.capacity() < batch_first + count + 1)
+	{
+		ptrdiff_t selected = mode_position(m_selected_mode);
+		ptrdiff_t current = mode_position(m_current_mode);
+
+		video_modes.reserve(batch_first + count + 1);
+
+		if (selected != -1) m_selected_mode = &video_modes[selected];
+		if (current != -1) m_current_mode = &video_modes[current];
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		const mode_request *r = &requests[i];
+
+		// Repeated requests get the same mode
+		uint64_t key = 0xcbf29ce484222325ULL;
+		key = (key ^ (uint32_t)r->width) * 0x100000001b3ULL;
+		key = (key ^ (uint32_t)r->height) * 0x100000001b3ULL;
+		key = (key ^ (uint32_t)r->flags) * 0x100000001b3ULL;
+		key = (key ^ (uint64_t)(r->refresh * 1000000.0)) * 0x100000001b3ULL;
+
+		auto it = seen.find(key);
+		if (it != seen.end())
+		{
+			const mode_request *first = &requests[it->second];
+			if (first->width == r->width && first->height == r->height && first->refresh == r->refresh && first->flags == r->flags)
+			{
+				ids[i] = ids[it->second];
+				continue;
+			}
+		}
+		seen.emplace(key, i);
+
+		modeline *mode = get_mode(r->width, r->height, r->refresh, r->flags);
+		if (mode == nullptr)
+			continue;
+
+		// Different requests may end up in the same new timings, keep the first ones
+		if ((mode->type & MODE_ADD) && mode == &video_modes.back())
+			for (size_t m = batch_first; m < video_modes.size() - 1; m++)
+				if ((video_modes[m].type & MODE_ADD) && !modeline_is_different(&video_modes[m], mode))
+				{
+					log_verbose("Switchres: same timings as mode %d, dropping mode %d\n", video_modes[m].id, mode->id);
+					m_mode_index.erase(mode->id);
+					m_selected_mode = &video_modes[m];
+					video_modes.pop_back();
+					mode = m_selected_mode;
+					break;
+				}
+
+		ids[i] = mode->id;
+
+		// Modes we add or update keep their refresh until the batch is done, so a later
+		// request doesn't retime the mode an earlier one was given
+		if ((mode->type & (MODE_ADD | MODE_UPDATE)) && (mode->type & V_FREQ_EDITABLE))
+		{
+			mode->type &= ~V_FREQ_EDITABLE;
+			locked.push_back(mode->id);
+		}
+	}
+
+	for (int id : locked)
+	{
+		modeline *mode = find_mode_by_id(id);
+		if (mode != nullptr)
+			mode->type |= V_FREQ_EDITABLE;
+	}
+	if (!locked.empty())
+		m_modes_serial++;
+
+	// A failed flush is rolled back as a whole, modes still pending didn't make it either
+	bool flush_failed = flush && !flush_modes();
+	if (flush_failed)
+		log_error("Switchres: error flushing %d modes\n", count);
+
+	int found = 0;
+	for (int i = 0; i < count; i++)
+	{
+		modeline *mode = ids[i]? find_mode_by_id(ids[i]) : nullptr;
+		if (mode != nullptr && !(mode->type & MODE_ERROR) && !(flush_failed && (mode->type & (MODE_ADD | MODE_UPDATE))))
+		{
+			modes[i] = *mode;
+			found++;
+		}
+		else
+			modes[i] = {};
+	}
+
+	log_verbose("Switchres: %d of %d modes added in one batch\n", found, count);
+	return found;
+}
+
+//============================================================
+//  display_manager::init_source
+//============================================================
+
+void display_manager::init_source(int width, int height, float refresh, int flags, modeline *s_mode)
+{
+	s_mode->interlace = flags & SR_MODE_INTERLACED? 1 : 0;
+	s_mode->vfreq = refresh;
+
+	s_mode->hactive = width;
+	s_mode->vactive = height;
+
+	if (flags & SR_MODE_ROTATED)
+	{
+		std::swap(s_mode->hactive, s_mode->vactive);
+		s_mode->type |= MODE_ROTATED;
+	}
+}
+
+//============================================================
+//  display_manager::set_adjustment
+//============================================================
+
+void display_manager::set_adjustment(modeline *mode)
+{
+	// Our settings are const here, clamped values are kept apart so they never leak into the cache keys
+	if (mode->type & V_FREQ_EDITABLE)
+	{
+		modeline_adjust_r(mode, range[mode->range].hfreq_max, &m_ds.gs, mode, &m_adjustment);
+		if (m_adjustment.range_rebuilt)
+			monitor_show_range(&m_adjustment.range);
+
+		fit_pclock(mode, m_adjustment.range_rebuilt? &m_adjustment.range : &range[mode->range]);
+	}
+	else
+	{
+		m_adjustment = {};
+		m_adjustment.h_size = m_ds.gs.h_size;
+		m_adjustment.h_shift = m_ds.gs.h_shift;
+		m_adjustment.v_shift = m_ds.gs.v_shift;
+	}
+	m_has_adjustment = true;
+}
+
+//============================================================
+//  display_manager::pclock_step
+//============================================================
+
+uint64_t display_manager::pclock_step()
+{
+	if (m_ds.gs.pclock_step)
+		return m_ds.gs.pclock_step;
+
+	return video() != nullptr? video()->pclock_step() : 0;
+}
+
+//============================================================
+//  display_manager::fit_pclock
+//============================================================
+
+void display_manager::fit_pclock(modeline *mode, const monitor_range *mode_range)
+{
+	generator_settings gs = m_ds.gs;
+	gs.pclock_step = pclock_step();
+
+	double vfreq = mode->vfreq;
+	if (modeline_fit_pclock(mode, mode_range, &gs) != 0)
+		log_verbose("Switchres: no timings for a %lu Hz pixel clock step within the porch tolerances\n", (unsigned long)gs.pclock_step);
+
+	else if (gs.pclock_step)
+		log_verbose("Switchres: pixel clock %lu Hz (step %lu Hz), refresh %.6f -> %.6f, drift %.3g Hz\n",
+			(unsigned long)mode->pclock, (unsigned long)gs.pclock_step, vfreq, mode->vfreq, mode->result.v_drift);
+}
+
+//============================================================
+//  display_manager::find_best_mode
+//============================================================
+
+void display_manager::find_best_mode(modeline *s_mode, modeline *best_mode)
+{
+	modeline t_mode = {};
+	modeline_score t_score, best_score;
+	char result[256]={'\x00'};
+
+	if (m_ds.mode_threads > 1)
+	{
+		find_best_mode_parallel(s_mode, best_mode);
+		return;
+	}
+
+	// Run through our mode list and find the most suitable mode
+	modeline_score_key(best_mode, &best_score);
+	size_t first = 0, last = 0;
+	for (size_t m = 0; m < video_modes.size(); m++)
+	{
+		// Bound the (mode, range) pairs a block at a time, so most of them are never copied nor created
+		if (m == last)
+		{
+			first = m;
+			fill_candidate_table(s_mode, first, CANDIDATE_BLOCK);
+			last = first + m_table.size();
+		}
+
+		modeline &mode = video_modes[m];
+		log_verbose("\nSwitchres: %s%4d%sx%s%4d%s_%s%d=%.6fHz%s%s\n",
+			mode.type & X_RES_EDITABLE?"(":"[", mode.width, mode.type & X_RES_EDITABLE?")":"]",
+			mode.type & Y_RES_EDITABLE?"(":"[", mode.height, mode.type & Y_RES_EDITABLE?")":"]",
+			mode.type & V_FREQ_EDITABLE?"(":"[", mode.refresh, mode.vfreq, mode.type & V_FREQ_EDITABLE?")":"]",
+			mode.type & MODE_DISABLED?" - locked":"");
+
+		// now get the mode if allowed
+		if (mode.type & MODE_DISABLED)
+			continue;
+
+		for (int i = 0 ; i < MAX_RANGES ; i++)
+		{
+			if (range[i].hfreq_min == 0)
+				continue;
+
+			// Don't bother creating modes that can't beat our best one
+			int bound = m_table.bound(i, m - first);
+			if (bound > best_mode->result.weight)
+			{
+				log_verbose("   rng(%d):  skipped\n", i);
+				continue;
+			}
+
+			init_candidate(&mode, s_mode, &t_mode);
+
+			// Out of range is still compared, as we'd get it from modeline_create
+			if (bound & R_OUT_OF_RANGE)
+				t_mode.result.weight = R_OUT_OF_RANGE;
+			else
+			{
+				modeline_create(s_mode, &t_mode, &range[i], &m_ds.gs);
+				m_mode_candidates++;
+			}
+			t_mode.range = i;
+
+			log_verbose("%s\n", modeline_result(&t_mode, result));
+
+			modeline_score_key(&t_mode, &t_score);
+			if (modeline_score_better(&t_mode, &t_score, best_mode, &best_score))
+			{
+				*best_mode = t_mode;
+				best_score = t_score;
+				m_selected_mode = &mode;
+
+				if (modeline_is_perfect(s_mode, best_mode, &m_ds.gs))
+				{
+					log_verbose("Switchres: perfect match, skipping the remaining modes\n");
+					return;
+				}
+			}
+		}
+	}
+}
+
+//============================================================
+//  display_manager::find_best_mode_parallel
+//============================================================
+
+void display_manager::find_best_mode_parallel(modeline *s_mode, modeline *best_mode)
+{
+	char result[256]={'\x00'};
+
+	collect_candidates(s_mode);
+	create_candidates(s_mode);
+
+	// Reduce in the same order as the serial loop, so ties resolve the same way
+	modeline_score best_score;
+	modeline_score_key(best_mode, &best_score);
+	size_t k = 0;
+	for (size_t m = 0; m < video_modes.size(); m++)
+	{
+		modeline &mode = video_modes[m];
+		log_verbose("\nSwitchres: %s%4d%sx%s%4d%s_%s%d=%.6fHz%s%s\n",
+			mode.type & X_RES_EDITABLE?"(":"[", mode.width, mode.type & X_RES_EDITABLE?")":"]",
+			mode.type & Y_RES_EDITABLE?"(":"[", mode.height, mode.type & Y_RES_EDITABLE?")":"]",
+			mode.type & V_FREQ_EDITABLE?"(":"[", mode.refresh, mode.vfreq, mode.type & V_FREQ_EDITABLE?")":"]",
+			mode.type & MODE_DISABLED?" - locked":"");
+
+		for (; k < m_candidates.size() && m_candidates[k].mode_index == m; k++)
+		{
+			modeline *t_mode = &m_candidates[k].t_mode;
+			log_verbose("%s\n", modeline_result(t_mode, result));
+
+			if (modeline_score_better(t_mode, &m_candidates[k].score, best_mode, &best_score))
+			{
+				*best_mode = *t_mode;
+				best_score = m_candidates[k].score;
+				m_selected_mode = &mode;
+			}
+		}
+	}
+}
+
+//============================================================
+//  display_manager::collect_candidates
+//============================================================
+
+void display_manager::collect_candidates(const modeline *s_mode)
+{
+	// All the (mode, range) pairs, in the order of the serial search
+	fill_candidate_table(s_mode, 0, video_modes.size());
+	m_candidates.clear();
+	for (size_t m = 0; m < video_modes.size(); m++)
+	{
+		if (video_modes[m].type & MODE_DISABLED)
+			continue;
+
+		for (int i = 0 ; i < MAX_RANGES ; i++)
+		{
+			if (range[i].hfreq_min == 0)
+				continue;
+
+			mode_candidate candidate;
+			candidate.mode_index = m;
+			init_candidate(&video_modes[m], s_mode, &candidate.t_mode);
+			candidate.t_mode.range = i;
+
+			// Pairs that are out of range for sure are not created, see find_best_mode
+			if (m_table.bound(i, m) & R_OUT_OF_RANGE)
+				candidate.t_mode.result.weight = R_OUT_OF_RANGE;
+			else
+			{
+				candidate.t_mode.result.weight = 0;
+				m_mode_candidates++;
+			}
+			m_candidates.push_back(candidate);
+		}
+	}
+}
+
+//============================================================
+//  display_manager::create_candidates
+//============================================================
+
+void display_manager::create_candidates(const modeline *s_mode)
+{
+	// modeline_create only writes to its target mode, so the workers can share all the rest
+	auto create = [&](int k)
+	{
+		modeline *t_mode = &m_candidates[k].t_mode;
+		if (!(t_mode->result.weight & R_OUT_OF_RANGE))
+			modeline_create(s_mode, t_mode, &range[t_mode->range], &m_ds.gs);
+		modeline_score_key(t_mode, &m_candidates[k].score);
+	};
+
+	if (m_ds.mode_threads <= 1 || m_candidates.size() < MIN_PARALLEL_CANDIDATES)
+	{
+		for (size_t k = 0; k < m_candidates.size(); k++) create(k);
+		return;
+	}
+
+	if (m_worker_pool == nullptr || m_worker_pool->size() != m_ds.mode_threads)
+	{
+		if (m_worker_pool) delete m_worker_pool;
+		m_worker_pool = new worker_pool(m_ds.mode_threads);
+	}
+	m_worker_pool->run(m_candidates.size(), create);
+}
+
+//============================================================
+//  display_manager::fill_candidate_table
+//============================================================
+
+void display_manager::fill_candidate_table(const modeline *s_mode, size_t first, size_t count)
+{
+	// Each mode as init_candidate would leave it, without copying whole modelines
+	m_table.clear();
+	for (size_t m = first; m < video_modes.size() && m < first + count; m++)
+	{
+		const modeline &mode = video_modes[m];
+		const modeline *timings = (mode.type & V_FREQ_EDITABLE) && m_user_mode.vfreq? &m_user_mode : &mode;
+		int hactive = mode.type & X_RES_EDITABLE? (m_user_mode.width? m_user_mode.width : s_mode->hactive) : mode.hactive;
+		int vactive = mode.type & Y_RES_EDITABLE? (m_user_mode.height? m_user_mode.height : s_mode->vactive) : mode.vactive;
+		double vfreq = mode.type & V_FREQ_EDITABLE? s_mode->vfreq : mode.vfreq;
+
+		int type = mode.type;
+		if (m_user_mode.width) type &= ~X_RES_EDITABLE;
+		if (m_user_mode.height) type &= ~Y_RES_EDITABLE;
+		if (m_user_mode.vfreq) type &= ~V_FREQ_EDITABLE;
+
+		if (timings == &m_user_mode)
+			m_table.add(timings->hactive, timings->vactive, timings->vfreq, timings->interlace, type);
+		else
+			m_table.add(hactive, vactive, vfreq, mode.interlace, type);
+	}
+
+	m_table.compute_bounds(s_mode, range, &m_ds.gs);
+}
+
+//============================================================
+//  display_manager::init_candidate
+//============================================================
+
+void display_manager::init_candidate(const modeline *mode, const modeline *s_mode, modeline *t_mode)
+{
+	*t_mode = *mode;
+
+	// init all editable fields with source or user values
+	if (t_mode->type & X_RES_EDITABLE)
+		t_mode->hactive = m_user_mode.width? m_user_mode.width : s_mode->hactive;
+
+	if (t_mode->type & Y_RES_EDITABLE)
+		t_mode->vactive = m_user_mode.height? m_user_mode.height : s_mode->vactive;
+
+	if (t_mode->type & V_FREQ_EDITABLE)
+	{
+		// If user's vfreq is defined, it means we have an user modeline, so force it
+		if (m_user_mode.vfreq)
+			modeline_copy_timings(t_mode, &m_user_mode);
+		else
+			t_mode->vfreq = s_mode->vfreq;
+	}
+
+	// lock resolution fields if required
+	if (m_user_mode.width) t_mode->type &= ~X_RES_EDITABLE;
+	if (m_user_mode.height) t_mode->type &= ~Y_RES_EDITABLE;
+	if (m_user_mode.vfreq) t_mode->type &= ~V_FREQ_EDITABLE;
+}
+
+//============================================================
+//  display_manager::mode_profile_hash
+//============================================================
+
+static inline uint64_t hash_bytes(uint64_t hash, const void *data, size_t size)
+{
+	// FNV-1a
+	const unsigned char *p = (const unsigned char *)data;
+	for (size_t i = 0; i < size; i++)
+		hash = (hash ^ p[i]) * 0x100000001b3ULL;
+	return hash;
+}
+
+#define HASH_FIELD(hash, field) hash = hash_bytes(hash, &(field), sizeof(field))
+
+uint64_t display_manager::mode_profile_hash()
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	// Display manager state
+	HASH_FIELD(hash, m_ds.modeline_generation);
+	HASH_FIELD(hash, m_desktop_is_rotated);
+	int video_caps = caps();
+	HASH_FIELD(hash, video_caps);
+
+	// Modeline generator settings
+	generator_settings *gs = &m_ds.gs;
+	HASH_FIELD(hash, gs->interlace);
+	HASH_FIELD(hash, gs->doublescan);
+	HASH_FIELD(hash, gs->pclock_min);
+	uint64_t step = pclock_step();
+	HASH_FIELD(hash, step);
+
+	// Variable refresh window, and the desktop refresh modes are picked for inside it
+	double vrr_min = 0, vrr_max = 0;
+	if (vrr_range(&vrr_min, &vrr_max))
+	{
+		HASH_FIELD(hash, vrr_min);
+		HASH_FIELD(hash, vrr_max);
+		HASH_FIELD(hash, desktop_mode.vfreq);
+	}
+	HASH_FIELD(hash, gs->monitor_aspect);
+	HASH_FIELD(hash, gs->refresh_tolerance);
+	HASH_FIELD(hash, gs->super_width);
+	HASH_FIELD(hash, gs->h_size);
+	HASH_FIELD(hash, gs->h_shift);
+	HASH_FIELD(hash, gs->v_shift);
+	HASH_FIELD(hash, gs->v_shift_correct);
+	HASH_FIELD(hash, gs->pixel_precision);
+	HASH_FIELD(hash, gs->interlace_force_even);
+	HASH_FIELD(hash, gs->scale_proportional);
+
+	// Monitor ranges (no padding in monitor_range)
+	hash = hash_bytes(hash, range, sizeof(range));
+
+	// User mode
+	HASH_FIELD(hash, m_user_mode.width);
+	HASH_FIELD(hash, m_user_mode.height);
+	HASH_FIELD(hash, m_user_mode.vfreq);
+	HASH_FIELD(hash, m_user_mode.hfreq);
+	HASH_FIELD(hash, m_user_mode.pclock);
+	HASH_FIELD(hash, m_user_mode.hactive);
+	HASH_FIELD(hash, m_user_mode.hbegin);
+	HASH_FIELD(hash, m_user_mode.hend);
+	HASH_FIELD(hash, m_user_mode.htotal);
+	HASH_FIELD(hash, m_user_mode.vactive);
+	HASH_FIELD(hash, m_user_mode.vbegin);
+	HASH_FIELD(hash, m_user_mode.vend);
+	HASH_FIELD(hash, m_user_mode.vtotal);
+	HASH_FIELD(hash, m_user_mode.interlace);
+	HASH_FIELD(hash, m_user_mode.doublescan);
+	HASH_FIELD(hash, m_user_mode.hsync);
+	HASH_FIELD(hash, m_user_mode.vsync);
+
+	return hash;
+}
+
+//============================================================
+//  display_manager::mode_cache_settings_hash
+//============================================================
+
+uint64_t display_manager::mode_cache_settings_hash(uint64_t profile_hash)
+{
+	// Results are only valid for the current state of our mode list
+	return hash_bytes(profile_hash, &m_modes_serial, sizeof(m_modes_serial));
+}
+
+//============================================================
+//  display_manager::mode_list_hash
+//============================================================
+
+uint64_t display_manager::mode_list_hash()
+{
+	if (m_mode_list_hash_serial == m_modes_serial && m_mode_list_hash != 0)
+		return m_mode_list_hash;
+
+	// Hash the contents, ids and backend data change from one session to another
+	uint64_t hash = 0xcbf29ce484222325ULL;
+	for (auto &mode : video_modes)
+	{
+		HASH_FIELD(hash, mode.pclock);
+		HASH_FIELD(hash, mode.hactive);
+		HASH_FIELD(hash, mode.hbegin);
+		HASH_FIELD(hash, mode.hend);
+		HASH_FIELD(hash, mode.htotal);
+		HASH_FIELD(hash, mode.vactive);
+		HASH_FIELD(hash, mode.vbegin);
+		HASH_FIELD(hash, mode.vend);
+		HASH_FIELD(hash, mode.vtotal);
+		HASH_FIELD(hash, mode.interlace);
+		HASH_FIELD(hash, mode.doublescan);
+		HASH_FIELD(hash, mode.hsync);
+		HASH_FIELD(hash, mode.vsync);
+		HASH_FIELD(hash, mode.vfreq);
+		HASH_FIELD(hash, mode.hfreq);
+		HASH_FIELD(hash, mode.width);
+		HASH_FIELD(hash, mode.height);
+		HASH_FIELD(hash, mode.refresh);
+		HASH_FIELD(hash, mode.type);
+	}
+
+	m_mode_list_hash = hash;
+	m_mode_list_hash_serial = m_modes_serial;
+	return hash;
+}
+
+//============================================================
+//  display_manager::mode_cache_file_key
+//============================================================
+
+uint64_t display_manager::mode_cache_file_key(uint64_t profile_hash, int width, int height, float refresh, int flags)
+{
+	uint64_t key = profile_hash;
+	uint64_t list_hash = mode_list_hash();
+	HASH_FIELD(key, list_hash);
+	HASH_FIELD(key, width);
+	HASH_FIELD(key, height);
+	HASH_FIELD(key, refresh);
+	HASH_FIELD(key, flags);
+	return key;
+}
+
+//============================================================
+//  display_manager::open_mode_cache_file
+//============================================================
+
+bool display_manager::open_mode_cache_file()
+{
+	if (m_mode_cache_file.is_open())
+		return true;
+
+	if (m_mode_cache_file_failed)
+		return false;
+
+	char file_name[sizeof(m_ds.config_dir) + 32];
+	snprintf(file_name, sizeof(file_name), "%sdisplay%d.cache", m_ds.config_dir, m_index);
+
+	if (!m_mode_cache_file.open(file_name))
+	{
+		log_error("Switchres: can't use mode cache %s, disabling it\n", file_name);
+		m_mode_cache_file_failed = true;
+		return false;
+	}
+
+	return true;
+}
+
+//============================================================
+//  display_manager::find_mode_by_id
+//============================================================
+
+modeline *display_manager::find_mode_by_id(int id)
+{
+	auto it = m_mode_index.find(id);
+	if (it == m_mode_index.end() || it->second >= video_modes.size() || video_modes[it->second].id != id)
+		return nullptr;
+
+	return &video_modes[it->second];
+}
+
+//============================================================
+//  display_manager::update_mode_index
+//============================================================
+
+void display_manager::update_mode_index()
+{
+	m_mode_index.clear();
+	for (size_t i = 0; i < video_modes.size(); i++)
+		if (video_modes[i].id != 0)
+			m_mode_index[video_modes[i].id] = i;
+}
+
+//============================================================
+//  display_manager::mode_position
+//============================================================
+
+ptrdiff_t display_manager::mode_position(const modeline *mode)
+{
+	if (mode == nullptr || video_modes.empty())
+		return -1;
+
+	uintptr_t p = (uintptr_t)mode, first = (uintptr_t)&video_modes.front(), last = (uintptr_t)&video_modes.back();
+	if (p < first || p > last)
+		return -1;
+
+	return mode - &video_modes.front();
+}
+
+//============================================================
+//  display_manager::push_mode
+//============================================================
+
+void display_manager::push_mode(const modeline &mode)
+{
+	// The list may be reallocated, keep our mode pointers valid
+	ptrdiff_t selected = mode_position(m_selected_mode);
+	ptrdiff_t current = mode_position(m_current_mode);
+
+	video_modes.push_back(mode);
+
+	if (selected != -1) m_selected_mode = &video_modes[selected];
+	if (current != -1) m_current_mode = &video_modes[current];
+
+	if (mode.id != 0)
+		m_mode_index[mode.id] = video_modes.size() - 1;
+}
+
+//============================================================
+//  display_manager::erase_mode
+//============================================================
+
+void display_manager::erase_mode(size_t i)
+{
+	// Following modes are shifted, keep our mode pointers valid
+	ptrdiff_t selected = mode_position(m_selected_mode);
+	ptrdiff_t current = mode_position(m_current_mode);
+
+	video_modes.erase(video_modes.begin() + i);
+
+	if (selected != -1) m_selected_mode = (size_t)selected == i ? nullptr : &video_modes[(size_t)selected > i ? selected - 1 : selected];
+	if (current != -1) m_current_mode = (size_t)current == i ? nullptr : &video_modes[(size_t)current > i ? current - 1 : current];
+
+	update_mode_index();
+}
+
 //============================================================
 //  display_manager::auto_specs
 //============================================================
@@ -16,8 +16,12 @@
 #define __DISPLAY_H__
 
 #include <vector>
+#include <unordered_map>
 #include "modeline.h"
 #include "custom_video.h"
+#include "mode_cache.h"
+#include "worker_pool.h"
+#include "candidate_table.h"
 
 // Mode flags
 #define SR_MODE_INTERLACED    1<<0
@@ -32,6 +36,9 @@ typedef struct display_settings
 	bool   lock_system_modes;
 	bool   refresh_dont_care;
 	bool   keep_changes;
+	bool   modeline_cache;
+	int    mode_threads;
+	char   config_dir[256];
 	char   monitor[32];
 	char   crt_range[MAX_RANGES][256];
 	char   lcd_range[256];
@@ -42,6 +49,33 @@ typedef struct display_settings
 	custom_video_settings vs;
 } display_settings;
 
+typedef struct mode_cache_entry
+{
+	int      width;
+	int      height;
+	float    refresh;
+	int      flags;
+	uint64_t settings_hash;
+	bool     found;
+	modeline best_mode;
+	modeline_adjustment adjustment;
+} mode_cache_entry;
+
+typedef struct mode_request
+{
+	int      width;
+	int      height;
+	float    refresh;
+	int      flags;
+} mode_request;
+
+typedef struct mode_candidate
+{
+	size_t   mode_index;
+	modeline t_mode;
+	modeline_score score;
+} mode_candidate;
+
 
 class display_manager
 {
@@ -52,6 +86,7 @@ public:
 	{
 		if (!m_ds.keep_changes) restore_modes();
 		if (m_factory) delete m_factory;
+		if (m_worker_pool) delete m_worker_pool;
 	};
 
 	display_manager *make(display_settings *ds);
@@ -69,6 +104,8 @@ public:
 	modeline user_mode() const { return m_user_mode; }
 	modeline *selected_mode() const { return m_selected_mode; }
 	modeline *current_mode() const { return m_current_mode; }
+	bool vrr_range(double *vfreq_min, double *vfreq_max) const { return m_video != nullptr && m_video->vrr_range(vfreq_min, vfreq_max); }
+	int mode_transition(modeline *mode) const { return m_current_mode != nullptr? modeline_transition(&m_current_timings, mode) : MODE_TRANSITION_SCAN; }
 
 	// getters (display manager)
 	const char *monitor() { return (const char*) &m_ds.monitor; }
@@ -82,12 +119,16 @@ public:
 	bool lock_system_modes() { return m_ds.lock_system_modes; }
 	bool refresh_dont_care() { return m_ds.refresh_dont_care; }
 	bool keep_changes() { return m_ds.keep_changes; }
+	bool modeline_cache() { return m_ds.modeline_cache; }
+	int mode_threads() { return m_ds.mode_threads; }
+	const char *config_dir() { return (const char*) &m_ds.config_dir; }
 	bool desktop_is_rotated() const { return m_desktop_is_rotated; }
 
 	// getters (modeline generator)
 	bool interlace() { return m_ds.gs.interlace; }
 	bool doublescan() { return m_ds.gs.doublescan; }
 	double dotclock_min() { return m_ds.gs.pclock_min; }
+	double dotclock_step() { return m_ds.gs.pclock_step; }
 	double refresh_tolerance() { return m_ds.gs.refresh_tolerance; }
 	int super_width() { return m_ds.gs.super_width; }
 	double monitor_aspect() { return m_ds.gs.monitor_aspect; }
@@ -99,6 +140,12 @@ public:
 	int interlace_force_even() { return m_ds.gs.interlace_force_even; }
 	int scale_proportional() { return m_ds.gs.scale_proportional; }
 
+	// getters (geometry applied by the last get_mode, the settings above are never clamped)
+	double applied_h_size() { return m_has_adjustment? m_adjustment.h_size : m_ds.gs.h_size; }
+	int applied_h_shift() { return m_has_adjustment? m_adjustment.h_shift : m_ds.gs.h_shift; }
+	int applied_v_shift() { return m_has_adjustment? m_adjustment.v_shift : m_ds.gs.v_shift; }
+	int geometry_clamped() { return m_has_adjustment? m_adjustment.clamped : 0; }
+
 	// getters (modeline result)
 	bool got_mode() { return (m_selected_mode != nullptr); }
 	int width() { return m_selected_mode != nullptr? m_selected_mode->width : 0; }
@@ -117,11 +164,20 @@ public:
 	bool is_mode_updated() { return m_selected_mode != nullptr? m_selected_mode->type & MODE_UPDATE : false; }
 	bool is_mode_new() { return m_selected_mode != nullptr? m_selected_mode->type & MODE_ADD : false; }
 
+	// getters (get_mode result cache)
+	uint64_t mode_cache_hits() const { return m_mode_cache_hits; }
+	uint64_t mode_cache_misses() const { return m_mode_cache_misses; }
+	uint64_t mode_candidates() const { return m_mode_candidates; }
+	uint64_t mode_cache_file_hits() const { return m_mode_cache_file_hits; }
+
 	// getters (custom_video backend)
 	bool screen_compositing() { return m_ds.vs.screen_compositing; }
 	bool screen_reordering() { return m_ds.vs.screen_reordering; }
 	bool allow_hardware_refresh() { return m_ds.vs.allow_hardware_refresh; }
 	const char *custom_timing() { return (const char*) &m_ds.vs.custom_timing; }
+	int kms_fb_pool_size() { return m_ds.vs.kms_fb_pool_size; }
+	bool kms_atomic() { return m_ds.vs.kms_atomic; }
+	const char *kms_vrr() { return (const char*) &m_ds.vs.kms_vrr; }
 
 	// setters
 	void set_index(int index) { m_index = index; }
@@ -132,7 +188,7 @@ public:
 	// setters (modes)
 	void set_user_mode(modeline *mode) { m_ds.user_mode = m_user_mode = *mode; filter_modes(); }
 	void set_selected_mode(modeline *mode) { m_selected_mode = mode; }
-	void set_current_mode(modeline *mode) { m_current_mode = mode; }
+	void set_current_mode(modeline *mode) { m_current_mode = mode; if (mode) m_current_timings = *mode; }
 
 	// setters (display_manager)
 	void set_monitor(const char *preset) { strncpy(m_ds.monitor, preset, sizeof(m_ds.monitor)-1); set_preset(preset); }
@@ -146,12 +202,16 @@ public:
 	void set_lock_system_modes(bool value) { m_ds.lock_system_modes = value; }
 	void set_refresh_dont_care(bool value) { m_ds.refresh_dont_care = value; }
 	void set_keep_changes(bool value) { m_ds.keep_changes = value; }
+	void set_modeline_cache(bool value) { m_ds.modeline_cache = value; }
+	void set_mode_threads(int value) { m_ds.mode_threads = value; }
+	void set_config_dir(const char *dir) { strncpy(m_ds.config_dir, dir, sizeof(m_ds.config_dir)-1); }
 	void set_desktop_is_rotated(bool value) { m_desktop_is_rotated = value; }
 
 	// setters (modeline generator)
 	void set_interlace(bool value) { m_ds.gs.interlace = value; }
 	void set_doublescan(bool value) { m_ds.gs.doublescan = value; }
 	void set_dotclock_min(double value) { m_ds.gs.pclock_min = value * 1000000; }
+	void set_dotclock_step(double value) { m_ds.gs.pclock_step = value > 0? uint64_t(value * 1000000 + 0.5) : 0; }
 	void set_refresh_tolerance(double value) { m_ds.gs.refresh_tolerance = value; }
 	void set_super_width(int value) { m_ds.gs.super_width = value; }
 	void set_monitor_aspect(double value) { m_ds.gs.monitor_aspect = value; }
@@ -169,12 +229,17 @@ public:
 	void set_screen_reordering(bool value) { m_ds.vs.screen_reordering = value; }
 	void set_allow_hardware_refresh(bool value) { m_ds.vs.allow_hardware_refresh = value; }
 	void set_custom_timing(const char *custom_timing) { strncpy(m_ds.vs.custom_timing, custom_timing, sizeof(m_ds.vs.custom_timing)-1); }
+	void set_kms_fb_pool_size(int value) { m_ds.vs.kms_fb_pool_size = value; }
+	void set_kms_atomic(bool value) { m_ds.vs.kms_atomic = value; }
+	void set_kms_vrr(const char *value) { strncpy(m_ds.vs.kms_vrr, value, sizeof(m_ds.vs.kms_vrr)-1); }
 
 	// options
 	display_settings m_ds = {};
 
 	// mode setting interface
 	modeline *get_mode(int width, int height, float refresh, int flags);
+	int get_modes_ranked(int width, int height, float refresh, int flags, modeline *modes, int k);
+	int add_modes(const mode_request *requests, int count, modeline *modes, bool flush = true);
 	bool add_mode(modeline *mode);
 	bool delete_mode(modeline *mode);
 	bool update_mode(modeline *mode);
@@ -186,6 +251,7 @@ public:
 	bool restore_modes();
 	bool flush_modes();
 	bool auto_specs();
+	modeline *find_mode_by_id(int id);
 
 	// mode list
 	std::vector<modeline> video_modes = {};
@@ -204,6 +270,8 @@ private:
 	modeline m_user_mode = {};
 	modeline *m_selected_mode = 0;
 	modeline *m_current_mode = 0;
+	// timings on screen, the current mode may be updated in place before we switch
+	modeline m_current_timings = {};
 
 	int m_index = 0;
 	bool m_desktop_is_rotated = 0;
@@ -211,6 +279,65 @@ private:
 	bool m_has_ini = 0;
 	int m_id_counter = 0;
 
+	// result of modeline_adjust_r for the last mode returned
+	modeline_adjustment m_adjustment = {};
+	bool m_has_adjustment = false;
+
+	void set_adjustment(modeline *mode);
+
+	// pixel clock granularity, from the user or the backend
+	uint64_t pclock_step();
+	void fit_pclock(modeline *mode, const monitor_range *mode_range);
+
+	// refresh a request is shown at with variable refresh, 0 if off or out of the window
+	double vrr_refresh(double refresh, double mode_vfreq);
+
+	// get_mode result cache, m_modes_serial changes whenever the mode list does
+	std::unordered_map<uint64_t, mode_cache_entry> m_mode_cache;
+	unsigned int m_modes_serial = 0;
+	uint64_t m_mode_cache_hits = 0;
+	uint64_t m_mode_cache_misses = 0;
+
+	// modelines evaluated by get_mode, one per mode and range
+	uint64_t m_mode_candidates = 0;
+
+	uint64_t mode_profile_hash();
+	uint64_t mode_cache_settings_hash(uint64_t profile_hash);
+
+	// persistent get_mode results, see mode_cache.h
+	mode_cache_file m_mode_cache_file;
+	bool m_mode_cache_file_failed = false;
+	uint64_t m_mode_cache_file_hits = 0;
+	uint64_t m_mode_list_hash = 0;
+	unsigned int m_mode_list_hash_serial = 0;
+
+	uint64_t mode_list_hash();
+	uint64_t mode_cache_file_key(uint64_t profile_hash, int width, int height, float refresh, int flags);
+	bool open_mode_cache_file();
+	void find_best_mode(modeline *s_mode, modeline *best_mode);
+
+	// parallel candidate evaluation, when mode_threads > 1
+	worker_pool *m_worker_pool = nullptr;
+	std::vector<mode_candidate> m_candidates;
+
+	// what the bounds are computed from, one row per mode from the first one filled
+	candidate_table m_table;
+
+	void find_best_mode_parallel(modeline *s_mode, modeline *best_mode);
+	void fill_candidate_table(const modeline *s_mode, size_t first, size_t count);
+	void collect_candidates(const modeline *s_mode);
+	void create_candidates(const modeline *s_mode);
+	void init_candidate(const modeline *mode, const modeline *s_mode, modeline *t_mode);
+	void init_source(int width, int height, float refresh, int flags, modeline *s_mode);
+
+	// id -> position in video_modes, for modes that got an id
+	std::unordered_map<int, size_t> m_mode_index;
+
+	void push_mode(const modeline &mode);
+	void erase_mode(size_t i);
+	void update_mode_index();
+	ptrdiff_t mode_position(const modeline *mode);
+
 	void set_preset(const char *preset);
 	double get_aspect(const char* aspect);
 
@@ -80,12 +80,25 @@ bool linux_display::init(void* pfdata)
 
 bool linux_display::set_mode(modeline *mode)
 {
-	if (mode && set_desktop_mode(mode, 0))
-	{
+	if (!mode)
+		return false;
+
+	// Refresh tweaks keep the active size of the mode on screen, and only move its
+	// porches and pixel clock, the backend can apply them without a full mode switch
+	int transition = mode_transition(mode);
+	const char *transition_txt[] = { "identical", "porch", "size", "scan" };
+	log_verbose("Switchres: %s transition\n", transition_txt[transition]);
+
+	// Identical timings are on screen already
+	bool result = true;
+	if (transition == MODE_TRANSITION_PORCH && video() != NULL)
+		result = video()->update_timing(mode);
+	else if (transition != MODE_TRANSITION_IDENTICAL)
+		result = set_desktop_mode(mode, 0);
+	if (result)
 		set_current_mode(mode);
-		return true;
-	}
-	return false;
+
+	return result;
 }
 
 //============================================================
@@ -127,7 +140,12 @@ bool linux_display::restore_desktop_mode()
 	if (video() == NULL)
 		return false;
 
-	return video()->set_timing(&desktop_mode);
+	if (!video()->set_timing(&desktop_mode))
+		return false;
+
+	// Later switches are classified against what's on screen now
+	set_current_mode(&desktop_mode);
+	return true;
 }
 
 //============================================================
@@ -139,23 +157,20 @@ int linux_display::get_available_video_modes()
 	if (video() == NULL)
 		return false;
 
-	// loop through all modes until NULL mode type is received
-	for (;;)
-	{
-		modeline mode;
-		memset(&mode, 0, sizeof(struct modeline));
+	// get the whole mode list in a single pass
+	std::vector<modeline> modes;
+	if (!video()->get_timings(modes))
+		return false;
 
-		// get next mode
-		video()->get_timing(&mode);
-		if (mode.type == 0)
-			break;
+	video_modes.reserve(video_modes.size() + modes.size());
+	backup_modes.reserve(backup_modes.size() + modes.size());
 
+	for (auto &mode : modes)
+	{
 		// set the desktop mode
 		if (mode.type & MODE_DESKTOP)
 		{
 			memcpy(&desktop_mode, &mode, sizeof(modeline));
-			if (current_mode() == nullptr)
-				set_current_mode(&mode);
 
 			if (mode.type & MODE_ROTATED) set_desktop_is_rotated(true);
 		}
@@ -163,9 +178,13 @@ int linux_display::get_available_video_modes()
 		video_modes.push_back(mode);
 		backup_modes.push_back(mode);
 
+		// Storage was reserved, this pointer stays valid
+		if ((mode.type & MODE_DESKTOP) && current_mode() == nullptr)
+			set_current_mode(&video_modes.back());
+
 		log_verbose("Switchres: [%3ld] %4dx%4d @%3d%s%s %s: ", video_modes.size(), mode.width, mode.height, mode.refresh, mode.interlace ? "i" : "p", mode.type & MODE_DESKTOP ? "*" : "", mode.type & MODE_ROTATED ? "rot" : "");
 		log_mode(&mode);
-	};
+	}
 
 	return true;
 }
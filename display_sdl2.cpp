@@ -226,23 +226,20 @@ int sdl2_display::get_available_video_modes()
 	if (video() == NULL)
 		return false;
 
-	// loop through all modes until NULL mode type is received
-	for (;;)
-	{
-		modeline mode;
-		memset(&mode, 0, sizeof(struct modeline));
+	// get the whole mode list in a single pass
+	std::vector<modeline> modes;
+	if (!video()->get_timings(modes))
+		return false;
 
-		// get next mode
-		video()->get_timing(&mode);
-		if (mode.type == 0)
-			break;
+	video_modes.reserve(video_modes.size() + modes.size());
+	backup_modes.reserve(backup_modes.size() + modes.size());
 
+	for (auto &mode : modes)
+	{
 		// set the desktop mode
 		if (mode.type & MODE_DESKTOP)
 		{
 			memcpy(&desktop_mode, &mode, sizeof(modeline));
-			if (current_mode() == nullptr)
-				set_current_mode(&mode);
 
 			if (mode.type & MODE_ROTATED) set_desktop_is_rotated(true);
 		}
@@ -250,9 +247,13 @@ int sdl2_display::get_available_video_modes()
 		video_modes.push_back(mode);
 		backup_modes.push_back(mode);
 
+		// Storage was reserved, this pointer stays valid
+		if ((mode.type & MODE_DESKTOP) && current_mode() == nullptr)
+			set_current_mode(&video_modes.back());
+
 		log_verbose("Switchres/SDL2: [%3ld] %4dx%4d @%3d%s%s %s: ", video_modes.size(), mode.width, mode.height, mode.refresh, mode.interlace ? "i" : "p", mode.type & MODE_DESKTOP ? "*" : "", mode.type & MODE_ROTATED ? "rot" : "");
 		log_mode(&mode);
-	};
+	}
 
 	return true;
 }
@@ -256,6 +256,8 @@ int windows_display::get_available_video_modes()
 
 	log_verbose("Switchres: Searching for custom video modes...\n");
 
+	int desktop_index = -1;
+
 	while (EnumDisplaySettingsExA(m_device_name, iModeNum, &lpDevMode, m_ds.lock_unsupported_modes?0:EDS_RAWMODE) != 0)
 	{
 		if (lpDevMode.dmBitsPerPel == 32 && lpDevMode.dmDisplayFixedOutput == DMDFO_DEFAULT)
@@ -277,8 +279,6 @@ int windows_display::get_available_video_modes()
 			{
 				m.type |= MODE_DESKTOP;
 				if (m.type & MODE_ROTATED) set_desktop_is_rotated(true);
-				if (current_mode() == nullptr)
-				set_current_mode(&m);
 			}
 
 			log_verbose("Switchres: [%3d] %4dx%4d @%3d%s%s %s: ", k, m.width, m.height, m.refresh, m.interlace?"i":"p", m.type & MODE_DESKTOP?"*":"",  m.type & MODE_ROTATED?"rot":"");
@@ -297,6 +297,9 @@ int windows_display::get_available_video_modes()
 			// Save our desktop mode now that we queried detailed timings
 			if (m.type & MODE_DESKTOP) desktop_mode = m;
 
+			if ((m.type & MODE_DESKTOP) && desktop_index == -1)
+				desktop_index = video_modes.size();
+
 			video_modes.push_back(m);
 			backup_modes.push_back(m);
 			k++;
@@ -305,6 +308,11 @@ int windows_display::get_available_video_modes()
 		iModeNum++;
 	}
 	k--;
+
+	// Point to the list only once it's complete, it may have been reallocated
+	if (desktop_index != -1 && current_mode() == nullptr)
+		set_current_mode(&video_modes[desktop_index]);
+
 	log_verbose("Switchres: Found %d custom of %d active video modes\n", j, k);
 	return k;
 }
@@ -241,3 +241,28 @@ int edid_from_modeline(modeline *mode, monitor_range *range, const char *name, e
 
 	return 1;
 }
+
+//============================================================
+//  edid_get_vfreq_range
+//============================================================
+
+// Vertical rate limits from the display range limits descriptor of the base block
+int edid_get_vfreq_range(const uint8_t *data, size_t size, double *vfreq_min, double *vfreq_max)
+{
+	if (!data || size < 128)
+		return 0;
+
+	for (int d = 54; d <= 108; d += 18)
+	{
+		const uint8_t *desc = &data[d];
+		if (desc[0] || desc[1] || desc[2] || desc[3] != 0xfd)
+			continue;
+
+		// EDID 1.4 adds 255 Hz to the max rate, or to both, for high refresh monitors
+		*vfreq_min = desc[5] + ((desc[4] & 0x03) == 0x03 ? 255 : 0);
+		*vfreq_max = desc[6] + ((desc[4] & 0x02) ? 255 : 0);
+		return *vfreq_min > 0 && *vfreq_max > *vfreq_min;
+	}
+
+	return 0;
+}
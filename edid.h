@@ -33,5 +33,6 @@ typedef struct edid_block
 //============================================================
 
 int edid_from_modeline(modeline *mode, monitor_range *range, const char *name, edid_block *edid);
+int edid_get_vfreq_range(const uint8_t *data, size_t size, double *vfreq_min, double *vfreq_max);
 
 #endif
@@ -0,0 +1,38 @@
+// List the best alternatives for a mode, without adding anything
+//
+// Build: g++ -o ranked_modes ranked_modes.cpp -I ../ -L ../ -ldl -lswitchres
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <switchres/switchres_wrapper.h>
+
+int main(int argc, char** argv)
+{
+	sr_ranked_mode modes[8];
+	int width = argc > 3? atoi(argv[1]) : 320;
+	int height = argc > 3? atoi(argv[2]) : 240;
+	double refresh = argc > 3? atof(argv[3]) : 59.94;
+
+	sr_init();
+	sr_set_monitor("arcade_15_25_31");
+	sr_init_disp("dummy", NULL);
+
+	int count = sr_get_modes_ranked(width, height, refresh, 0, modes, 8);
+	if (!count)
+	{
+		printf("ERROR: No mode found for %dx%d@%f. Exiting!\n", width, height, refresh);
+		sr_deinit();
+		exit(1);
+	}
+
+	for (int i = 0; i < count; i++)
+	{
+		sr_mode *srm = &modes[i].mode;
+		printf("%d: %dx%d@%f%s range %d %s%s scale(%.3f, %.3f, %.3f) diff(%.3f, %.3f, %.3f)\n", i,
+			srm->width, srm->height, srm->vfreq, srm->interlace? "i" : "", modes[i].range,
+			modes[i].is_new? "new" : "existing", srm->is_stretched? " stretched" : "",
+			srm->x_scale, srm->y_scale, srm->v_scale, modes[i].x_diff, modes[i].y_diff, modes[i].v_diff);
+	}
+
+	sr_deinit();
+}
@@ -0,0 +1,38 @@
+// Show how far a mode's real refresh is from the requested one, for frame pacing
+//
+// Build: g++ -o refresh_drift refresh_drift.cpp -I ../ -L ../ -ldl -lswitchres
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <switchres/switchres_wrapper.h>
+
+int main(int argc, char** argv)
+{
+	sr_mode srm;
+	sr_refresh srr;
+	int width = argc > 3? atoi(argv[1]) : 320;
+	int height = argc > 3? atoi(argv[2]) : 240;
+	double refresh = argc > 3? atof(argv[3]) : 59.94;
+
+	sr_init();
+	sr_set_monitor("arcade_15");
+	sr_set_option("dotclock_step", argc > 4? argv[4] : "0.01");
+	sr_init_disp("dummy", NULL);
+
+	if (!sr_add_mode(width, height, refresh, 0, &srm) || !sr_get_refresh(srm.id, &srr))
+	{
+		printf("ERROR: No mode found for %dx%d@%f. Exiting!\n", width, height, refresh);
+		sr_deinit();
+		exit(1);
+	}
+
+	printf("%dx%d@%f: %llu/%llu Hz = %.9f, target %.9f, %+.3f ppm, ", srm.width, srm.height, refresh,
+		(unsigned long long)srr.num, (unsigned long long)srr.den, srr.vfreq, srr.target, srr.ppm);
+
+	if (srr.frames_to_slip)
+		printf("one frame slips every %.0f frames\n", srr.frames_to_slip);
+	else
+		printf("no slip\n");
+
+	sr_deinit();
+}
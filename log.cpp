@@ -33,26 +33,31 @@ LOG_VERBOSE log_verbose_bak = &log_dummy;
 LOG_INFO log_info_bak = &log_dummy;
 LOG_ERROR log_error_bak = &log_dummy;
 
+// A null callback disables its level, like the log_dummy default
+static LOG_VERBOSE log_or_dummy(void *func_ptr)
+{
+	return func_ptr != nullptr? (LOG_VERBOSE)func_ptr : &log_dummy;
+}
 
 void set_log_verbose(void *func_ptr)
 {
 	if (log_level >= SR_DEBUG)
-		log_verbose = (LOG_VERBOSE)func_ptr;
-	log_verbose_bak = (LOG_VERBOSE)func_ptr;
+		log_verbose = log_or_dummy(func_ptr);
+	log_verbose_bak = log_or_dummy(func_ptr);
 }
 
 void set_log_info(void *func_ptr)
 {
 	if (log_level >= SR_INFO)
-		log_info = (LOG_INFO)func_ptr;
-	log_info_bak = (LOG_INFO)func_ptr;
+		log_info = log_or_dummy(func_ptr);
+	log_info_bak = log_or_dummy(func_ptr);
 }
 
 void set_log_error(void *func_ptr)
 {
 	if (log_level >= SR_ERROR)
-		log_error = (LOG_ERROR)func_ptr;
-	log_error_bak = (LOG_ERROR)func_ptr;
+		log_error = log_or_dummy(func_ptr);
+	log_error_bak = log_or_dummy(func_ptr);
 }
 
 void set_log_verbosity(int level)
@@ -63,6 +68,8 @@ void set_log_verbosity(int level)
 	if(level > SR_DEBUG)
 		level = SR_DEBUG;
 
+	log_level = (log_verbosity)level;
+
 	log_error = &log_dummy;
 	log_info = &log_dummy;
 	log_verbose = &log_dummy;
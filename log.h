@@ -17,8 +17,10 @@
 
 #if defined(__GNUC__)
 #define ATTR_PRINTF(x,y)        __attribute__((format(printf, x, y)))
+#define LOG_UNLIKELY(x)         __builtin_expect(!!(x), 0)
 #else
 #define ATTR_PRINTF(x,y)
+#define LOG_UNLIKELY(x)         (x)
 #endif
 
 typedef void (*LOG_VERBOSE)(const char *format, ...) ATTR_PRINTF(1,2);
@@ -30,6 +32,15 @@ extern LOG_INFO log_info;
 typedef void (*LOG_ERROR)(const char *format, ...) ATTR_PRINTF(1,2);
 extern LOG_ERROR log_error;
 
+void log_dummy(const char *, ...);
+
+// Level-gated logging: a disabled level points to log_dummy, and its arguments aren't
+// even evaluated. The macros don't expand within themselves, so they call the pointers
+// of the same name, which stay the exported symbols
+#define log_verbose(...) do { if (LOG_UNLIKELY(log_verbose != &log_dummy)) log_verbose(__VA_ARGS__); } while (0)
+#define log_info(...)    do { if (log_info != &log_dummy) log_info(__VA_ARGS__); } while (0)
+#define log_error(...)   do { if (log_error != &log_dummy) log_error(__VA_ARGS__); } while (0)
+
 void set_log_verbosity(int);
 void set_log_verbose(void *func_ptr);
 void set_log_info(void *func_ptr);
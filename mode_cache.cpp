@@ -0,0 +1,297 @@
+/**************************************************************
+
+   mode_cache.cpp - Persistent get_mode result cache
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <string>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "mode_cache.h"
+#include "log.h"
+
+//============================================================
+//  mode_cache_file::open
+//============================================================
+
+bool mode_cache_file::open(const char *file_name)
+{
+	close();
+
+	m_size = sizeof(mode_cache_header) + MODE_CACHE_ENTRIES * sizeof(mode_cache_record);
+
+#ifdef _WIN32
+	// No mapping here, load the whole table and write it back on close
+	void *data = calloc(1, m_size);
+	if (data == nullptr)
+		return false;
+
+	FILE *file = fopen(file_name, "rb");
+	if (file)
+	{
+		if (fread(data, 1, m_size, file) != m_size)
+			memset(data, 0, m_size);
+		fclose(file);
+	}
+
+	strncpy(m_file_name, file_name, sizeof(m_file_name)-1);
+	m_dirty = false;
+
+	m_header = (mode_cache_header *)data;
+	m_records = (mode_cache_record *)(m_header + 1);
+
+	if (!header_valid())
+		clear();
+#else
+	// Other processes may have the file mapped, and resizing it under them would make them crash,
+	// so a file from another build is replaced instead. Whoever still maps the old one keeps it
+	m_fd = ::open(file_name, O_RDWR);
+	if (m_fd != -1 && !map_file())
+	{
+		::close(m_fd);
+		m_fd = -1;
+	}
+
+	if (m_fd == -1)
+	{
+		m_fd = create_file(file_name);
+		if (m_fd == -1 || !map_file())
+		{
+			log_verbose("Switchres: can't create mode cache %s\n", file_name);
+			if (m_fd != -1)
+				::close(m_fd);
+			m_fd = -1;
+			return false;
+		}
+	}
+#endif
+
+	log_verbose("Switchres: using mode cache %s (%d entries)\n", file_name, m_header->count);
+	return true;
+}
+
+//============================================================
+//  mode_cache_file::close
+//============================================================
+
+void mode_cache_file::close()
+{
+	if (m_header == nullptr)
+		return;
+
+#ifdef _WIN32
+	if (m_dirty)
+	{
+		FILE *file = fopen(m_file_name, "wb");
+		if (file)
+		{
+			fwrite(m_header, 1, m_size, file);
+			fclose(file);
+		}
+	}
+	free(m_header);
+#else
+	munmap(m_header, m_size);
+	::close(m_fd);
+	m_fd = -1;
+#endif
+
+	m_header = nullptr;
+	m_records = nullptr;
+}
+
+#ifndef _WIN32
+//============================================================
+//  mode_cache_file::map_file
+//============================================================
+
+bool mode_cache_file::map_file()
+{
+	struct stat st;
+	if (fstat(m_fd, &st) == -1 || (size_t)st.st_size != m_size)
+		return false;
+
+	void *data = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (data == MAP_FAILED)
+		return false;
+
+	m_header = (mode_cache_header *)data;
+	m_records = (mode_cache_record *)(m_header + 1);
+
+	lock(false);
+	bool valid = header_valid();
+	unlock();
+
+	if (!valid)
+	{
+		munmap(m_header, m_size);
+		m_header = nullptr;
+		m_records = nullptr;
+		return false;
+	}
+
+	return true;
+}
+
+//============================================================
+//  mode_cache_file::create_file
+//============================================================
+
+int mode_cache_file::create_file(const char *file_name)
+{
+	// Set up a new file aside, then move it in place at once
+	std::string temp_name = std::string(file_name) + ".XXXXXX";
+
+	int fd = mkstemp(&temp_name[0]);
+	if (fd == -1)
+		return -1;
+
+	mode_cache_header header = {};
+	memcpy(header.magic, MODE_CACHE_MAGIC, sizeof(header.magic));
+	header.version = MODE_CACHE_VERSION;
+	header.record_size = sizeof(mode_cache_record);
+	header.entries = MODE_CACHE_ENTRIES;
+
+	if (fchmod(fd, 0644) == -1 || ftruncate(fd, m_size) == -1 || pwrite(fd, &header, sizeof(header), 0) != sizeof(header)
+		|| rename(temp_name.c_str(), file_name) == -1)
+	{
+		unlink(temp_name.c_str());
+		::close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+#endif
+
+//============================================================
+//  mode_cache_file::header_valid
+//============================================================
+
+bool mode_cache_file::header_valid() const
+{
+	return !memcmp(m_header->magic, MODE_CACHE_MAGIC, sizeof(m_header->magic)) && m_header->version == MODE_CACHE_VERSION
+		&& m_header->record_size == sizeof(mode_cache_record) && m_header->entries == MODE_CACHE_ENTRIES;
+}
+
+//============================================================
+//  mode_cache_file::clear
+//============================================================
+
+void mode_cache_file::clear()
+{
+	memset(m_header, 0, m_size);
+	memcpy(m_header->magic, MODE_CACHE_MAGIC, sizeof(m_header->magic));
+	m_header->version = MODE_CACHE_VERSION;
+	m_header->record_size = sizeof(mode_cache_record);
+	m_header->entries = MODE_CACHE_ENTRIES;
+#ifdef _WIN32
+	m_dirty = true;
+#endif
+}
+
+//============================================================
+//  mode_cache_file::lock
+//============================================================
+
+void mode_cache_file::lock(bool exclusive) const
+{
+#ifndef _WIN32
+	while (flock(m_fd, exclusive? LOCK_EX : LOCK_SH) == -1 && errno == EINTR);
+#endif
+}
+
+void mode_cache_file::unlock() const
+{
+#ifndef _WIN32
+	flock(m_fd, LOCK_UN);
+#endif
+}
+
+//============================================================
+//  mode_cache_file::find
+//============================================================
+
+bool mode_cache_file::find(uint64_t key, int width, int height, float refresh, int flags, mode_cache_record *record) const
+{
+	if (m_header == nullptr)
+		return false;
+
+	if (key == 0) key = 1;
+
+	bool found = false;
+	lock(false);
+
+	for (unsigned i = 0, slot = key & (MODE_CACHE_ENTRIES - 1); i < MODE_CACHE_ENTRIES; i++, slot = (slot + 1) & (MODE_CACHE_ENTRIES - 1))
+	{
+		const mode_cache_record *r = &m_records[slot];
+		if (r->key == 0)
+			break;
+
+		if (r->key == key && r->width == width && r->height == height && r->refresh == refresh && r->flags == flags)
+		{
+			*record = *r;
+			found = true;
+			break;
+		}
+	}
+
+	unlock();
+	return found;
+}
+
+//============================================================
+//  mode_cache_file::store
+//============================================================
+
+void mode_cache_file::store(const mode_cache_record *record)
+{
+	if (m_header == nullptr)
+		return;
+
+	lock(true);
+
+	// Keep probing short, start over when the table gets crowded
+	if (m_header->count >= MODE_CACHE_ENTRIES / 4 * 3)
+		clear();
+
+	uint64_t key = record->key? record->key : 1;
+
+	for (unsigned i = 0, slot = key & (MODE_CACHE_ENTRIES - 1); i < MODE_CACHE_ENTRIES; i++, slot = (slot + 1) & (MODE_CACHE_ENTRIES - 1))
+	{
+		mode_cache_record *r = &m_records[slot];
+		bool same = r->key == key && r->width == record->width && r->height == record->height && r->refresh == record->refresh && r->flags == record->flags;
+
+		if (r->key == 0 || same)
+		{
+			if (r->key == 0)
+				m_header->count++;
+
+			*r = *record;
+			r->key = key;
+#ifdef _WIN32
+			m_dirty = true;
+#endif
+			break;
+		}
+	}
+
+	unlock();
+}
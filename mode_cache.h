@@ -0,0 +1,104 @@
+/**************************************************************
+
+   mode_cache.h - Persistent get_mode result cache
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#ifndef __MODE_CACHE_H__
+#define __MODE_CACHE_H__
+
+#include "modeline.h"
+
+//============================================================
+//  CONSTANTS
+//============================================================
+
+#define MODE_CACHE_MAGIC    "SRMCACHE"
+#define MODE_CACHE_VERSION  2
+#define MODE_CACHE_ENTRIES  8192 // must be a power of two
+
+// Special values for mode_cache_record::selected
+#define MODE_CACHE_NEW_MODE   -1
+#define MODE_CACHE_NOT_FOUND  -2
+
+//============================================================
+//  TYPE DEFINITIONS
+//============================================================
+
+// The file is a header followed by an open addressing hash table of
+// fixed size records, so it can be used as mapped, with no parsing.
+// It's shared by all the processes using the same display, each one with
+// its own settings, so records are told apart by their key alone
+typedef struct mode_cache_header
+{
+	char     magic[8];
+	uint32_t version;
+	uint32_t record_size;
+	uint32_t entries;
+	uint32_t count;
+} mode_cache_header;
+
+typedef struct mode_cache_record
+{
+	uint64_t key; // 0 = empty slot
+	int32_t  width;
+	int32_t  height;
+	float    refresh;
+	int32_t  flags;
+	int32_t  selected; // index in the mode list, or one of MODE_CACHE_NEW_MODE, MODE_CACHE_NOT_FOUND
+	int32_t  reserved;
+	modeline best_mode;
+} mode_cache_record;
+
+class mode_cache_file
+{
+public:
+
+	mode_cache_file() {};
+	mode_cache_file(const mode_cache_file&) = delete;
+	mode_cache_file &operator=(const mode_cache_file&) = delete;
+	~mode_cache_file() { close(); };
+
+	bool open(const char *file_name);
+	void close();
+
+	// Records are copied in and out with the file locked, so another process can't
+	// be caught halfway through writing one
+	bool find(uint64_t key, int width, int height, float refresh, int flags, mode_cache_record *record) const;
+	void store(const mode_cache_record *record);
+
+	// getters
+	bool is_open() const { return m_header != nullptr; }
+
+private:
+
+	bool header_valid() const;
+	void clear();
+	void lock(bool exclusive) const;
+	void unlock() const;
+#ifndef _WIN32
+	bool map_file();
+	int create_file(const char *file_name);
+#endif
+
+	mode_cache_header *m_header = nullptr;
+	mode_cache_record *m_records = nullptr;
+	size_t m_size = 0;
+
+#ifdef _WIN32
+	char m_file_name[256] = {};
+	bool m_dirty = false;
+#else
+	int m_fd = -1;
+#endif
+};
+
+#endif
@@ -21,24 +21,29 @@
 #define max(a,b)({ __typeof__ (a) _a = (a);__typeof__ (b) _b = (b);_a > _b ? _a : _b; })
 #define min(a,b)({ __typeof__ (a) _a = (a);__typeof__ (b) _b = (b);_a < _b ? _a : _b; })
 
+// The timing core modeline_create uses, see modeline_timings_fixed
+#ifdef SR_FIXED_TIMINGS
+#define MODELINE_TIMINGS modeline_timings_fixed
+#define STRETCH_INTO_RANGE stretch_into_range_fixed
+#else
+#define MODELINE_TIMINGS modeline_timings
+#define STRETCH_INTO_RANGE stretch_into_range
+#endif
+
 
 //============================================================
 //  PROTOTYPES
 //============================================================
 
-int get_line_params(modeline *mode, monitor_range *range, int char_size);
-int scale_into_range (int value, int lower_limit, int higher_limit);
-int scale_into_range (double value, double lower_limit, double higher_limit);
+int get_line_params(modeline *mode, const monitor_range *range, int char_size);
+int get_line_params_fixed(modeline *mode, int64_t hfreq, const monitor_range *range, int char_size);
 int scale_into_aspect (int source_res, int tot_res, double original_monitor_aspect, double users_monitor_aspect, double *best_diff);
-int stretch_into_range(double vfreq, monitor_range *range, double borders, bool interlace_allowed, double *interlace);
-int total_lines_for_yres(int yres, double vfreq, monitor_range *range, double borders, double interlace);
-double max_vfreq_for_yres (int yres, monitor_range *range, double borders, double interlace);
 
 //============================================================
 //  modeline_create
 //============================================================
 
-int modeline_create(modeline *s_mode, modeline *t_mode, monitor_range *range, generator_settings *cs)
+int modeline_create(const modeline *s_mode, modeline *t_mode, const monitor_range *range, const generator_settings *cs)
 {
 	double vfreq_real = 0;
 	double interlace = 1;
@@ -58,6 +63,7 @@ int modeline_create(modeline *s_mode, modeline *t_mode, monitor_range *range, ge
 	int rotation = s_mode->type & MODE_ROTATED;
 	double source_aspect = rotation? 1.0 / (STANDARD_CRT_ASPECT) : (STANDARD_CRT_ASPECT);
 	t_mode->result.weight = 0;
+	t_mode->result.v_source = s_mode->vfreq;
 
 	// ≈≈≈ Vertical refresh ≈≈≈
 	// try to fit vertical frequency into current range
@@ -196,7 +202,7 @@ int modeline_create(modeline *s_mode, modeline *t_mode, monitor_range *range, ge
 		if (t_mode->type & Y_RES_EDITABLE)
 		{
 			// always try to use the interlaced range first if it exists, for better resolution
-			t_mode->vactive = stretch_into_range(t_mode->vfreq * v_scale, range, borders, cs->interlace, &interlace);
+			t_mode->vactive = STRETCH_INTO_RANGE(t_mode->vfreq * v_scale, range, borders, cs->interlace, &interlace);
 
 			// check in case we couldn't achieve the desired refresh
 			vfreq_real = min(t_mode->vfreq * v_scale, max_vfreq_for_yres(t_mode->vactive, range, borders, interlace));
@@ -225,35 +231,22 @@ int modeline_create(modeline *s_mode, modeline *t_mode, monitor_range *range, ge
 	// compute new modeline if we are allowed to
 	if (t_mode->type & V_FREQ_EDITABLE)
 	{
-		double margin = 0;
-		double vblank_lines = 0;
-		double vvt_ini = 0;
 		double interlace_incr = !cs->interlace_force_even && interlace == 2? 0.5 : 0;
 
 		// Get resulting refresh
 		t_mode->vfreq = vfreq_real;
 
 		// Get total vertical lines
-		vvt_ini = total_lines_for_yres(t_mode->vactive, t_mode->vfreq, range, borders, scan_factor) + interlace_incr;
-
-		// Calculate horizontal frequency
-		t_mode->hfreq = t_mode->vfreq * vvt_ini;
-
-		horizontal_values:
+		double vvt_ini = total_lines_for_yres(t_mode->vactive, t_mode->vfreq, range, borders, scan_factor) + interlace_incr;
 
-		// Fill horizontal part of modeline
-		get_line_params(t_mode, range, cs->pixel_precision? 1 : 8);
-
-		// Calculate pixel clock
-		t_mode->pclock = t_mode->htotal * t_mode->hfreq;
-		if (t_mode->pclock <= cs->pclock_min)
+		// Fill the timings, doubling xres until we're above the minimum pixel clock, if we can
+		while (MODELINE_TIMINGS(t_mode, range, cs, vvt_ini, borders, scan_factor, interlace) != 0)
 		{
 			if (t_mode->type & X_RES_EDITABLE)
 			{
 				x_scale *= 2;
 				x_fscale *= 2;
 				t_mode->hactive *= 2;
-				goto horizontal_values;
 			}
 			else
 			{
@@ -262,20 +255,6 @@ int modeline_create(modeline *s_mode, modeline *t_mode, monitor_range *range, ge
 			}
 		}
 
-		// Vertical blanking
-		t_mode->vtotal = vvt_ini * scan_factor;
-		vblank_lines = round_near(t_mode->hfreq * (range->vertical_blank + borders)) + interlace_incr;
-		margin = (t_mode->vtotal - t_mode->vactive - vblank_lines * scan_factor) / (cs->v_shift_correct? 1 : 2);
-
-		double v_front_porch = margin + t_mode->hfreq * range->vfront_porch * scan_factor + interlace_incr;
-		int (*pf_round)(double) = interlace == 2? (cs->interlace_force_even? round_near_even : round_near_odd) : round_near;
-
-		t_mode->vbegin = t_mode->vactive + max(pf_round(v_front_porch), 1);
-		t_mode->vend = t_mode->vbegin + max(round_near(t_mode->hfreq * range->vsync_pulse * scan_factor), 1);
-
-		// Recalculate final vfreq
-		t_mode->vfreq = (t_mode->hfreq / t_mode->vtotal) * scan_factor;
-
 		t_mode->hsync = range->hsync_polarity;
 		t_mode->vsync = range->vsync_polarity;
 		t_mode->interlace = interlace == 2? 1 : 0;
@@ -294,11 +273,49 @@ int modeline_create(modeline *s_mode, modeline *t_mode, monitor_range *range, ge
 	return 0;
 }
 
+//============================================================
+//  modeline_timings
+//============================================================
+
+int modeline_timings(modeline *mode, const monitor_range *range, const generator_settings *cs, double vvt, double borders, double scan_factor, double interlace)
+{
+	double margin = 0;
+	double vblank_lines = 0;
+	double interlace_incr = !cs->interlace_force_even && interlace == 2? 0.5 : 0;
+
+	// Calculate horizontal frequency
+	mode->hfreq = mode->vfreq * vvt;
+
+	// Fill horizontal part of modeline
+	get_line_params(mode, range, cs->pixel_precision? 1 : 8);
+
+	// Calculate pixel clock
+	mode->pclock = mode->htotal * mode->hfreq;
+	if (mode->pclock <= cs->pclock_min)
+		return -1;
+
+	// Vertical blanking
+	mode->vtotal = vvt * scan_factor;
+	vblank_lines = round_near(mode->hfreq * (range->vertical_blank + borders)) + interlace_incr;
+	margin = (mode->vtotal - mode->vactive - vblank_lines * scan_factor) / (cs->v_shift_correct? 1 : 2);
+
+	double v_front_porch = margin + mode->hfreq * range->vfront_porch * scan_factor + interlace_incr;
+	int (*pf_round)(double) = interlace == 2? (cs->interlace_force_even? round_near_even : round_near_odd) : round_near;
+
+	mode->vbegin = mode->vactive + max(pf_round(v_front_porch), 1);
+	mode->vend = mode->vbegin + max(round_near(mode->hfreq * range->vsync_pulse * scan_factor), 1);
+
+	// Recalculate final vfreq
+	mode->vfreq = (mode->hfreq / mode->vtotal) * scan_factor;
+
+	return 0;
+}
+
 //============================================================
 //  get_line_params
 //============================================================
 
-int get_line_params(modeline *mode, monitor_range *range, int char_size)
+int get_line_params(modeline *mode, const monitor_range *range, int char_size)
 {
 	int hhi, hhf, hht;
 	int hh, hs, he, ht;
@@ -397,7 +414,7 @@ int scale_into_aspect (int source_res, int tot_res, double original_monitor_aspe
 //  stretch_into_range
 //============================================================
 
-int stretch_into_range(double vfreq, monitor_range *range, double borders, bool interlace_allowed, double *interlace)
+int stretch_into_range(double vfreq, const monitor_range *range, double borders, bool interlace_allowed, double *interlace)
 {
 	int yres, lower_limit;
 
@@ -424,7 +441,7 @@ int stretch_into_range(double vfreq, monitor_range *range, double borders, bool
 //  total_lines_for_yres
 //============================================================
 
-int total_lines_for_yres(int yres, double vfreq, monitor_range *range, double borders, double interlace)
+int total_lines_for_yres(int yres, double vfreq, const monitor_range *range, double borders, double interlace)
 {
 	int vvt = max(yres / interlace + round_near(vfreq * yres / (interlace * (1.0 - vfreq * (range->vertical_blank + borders))) * (range->vertical_blank + borders)), 1);
 	while ((vfreq * vvt < range->hfreq_min) && (vfreq * (vvt + 1) < range->hfreq_max)) vvt++;
@@ -435,11 +452,319 @@ int total_lines_for_yres(int yres, double vfreq, monitor_range *range, double bo
 //  max_vfreq_for_yres
 //============================================================
 
-double max_vfreq_for_yres (int yres, monitor_range *range, double borders, double interlace)
+double max_vfreq_for_yres (int yres, const monitor_range *range, double borders, double interlace)
 {
 	return range->hfreq_max / (yres / interlace + round_near(range->hfreq_max * (range->vertical_blank + borders)));
 }
 
+//============================================================
+//  Batch kernels
+//============================================================
+
+// These give the same results as the scalar functions above, bit for bit, for many values
+// at once. The search loops are replaced by a division plus a correction step, so each
+// entry costs the same and there are no early exits. Build with SR_SCALAR_KERNELS to
+// run the scalar functions instead
+
+#define SCALE_MAX (1 << 30)
+
+// Smallest scale >= 1 with value * scale >= lower_limit, as the loops find it. The division
+// can only be one step away from that, so a single correction each way is enough
+static inline int scale_above(double value, double lower_limit)
+{
+	double q = lower_limit / value;
+	int scale = q < 1.0? 1 : q < SCALE_MAX? (int)ceil(q) : SCALE_MAX;
+	scale -= (scale > 1 && value * (scale - 1) >= lower_limit);
+	scale += (value * scale < lower_limit);
+	return scale;
+}
+
+static inline int scale_above(int value, int lower_limit)
+{
+	return value >= lower_limit? 1 : value > 0? (lower_limit + value - 1) / value : 0;
+}
+
+//============================================================
+//  scale_into_range_batch
+//============================================================
+
+void scale_into_range_batch(const int *value, int lower_limit, int higher_limit, int *scale, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+#ifdef SR_SCALAR_KERNELS
+		scale[i] = scale_into_range(value[i], lower_limit, higher_limit);
+#else
+		int s = scale_above(value[i], lower_limit);
+		scale[i] = value[i] * s <= higher_limit? s : 0;
+#endif
+	}
+}
+
+void scale_into_range_batch(const double *value, double lower_limit, double higher_limit, int *scale, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+	{
+#ifdef SR_SCALAR_KERNELS
+		scale[i] = scale_into_range(value[i], lower_limit, higher_limit);
+#else
+		int s = scale_above(value[i], lower_limit);
+		scale[i] = value[i] * s <= higher_limit? s : 0;
+#endif
+	}
+}
+
+//============================================================
+//  total_lines_for_yres_batch
+//============================================================
+
+void total_lines_for_yres_batch(const int *yres, const double *vfreq, const monitor_range *range, const double *borders, const double *interlace, int *lines, size_t count)
+{
+	// Keep the range out of the loop, the compiler can't tell our arrays don't overlap it
+	const double hfreq_min = range->hfreq_min;
+	const double hfreq_max = range->hfreq_max;
+	const double vertical_blank = range->vertical_blank;
+
+	for (size_t i = 0; i < count; i++)
+	{
+#ifdef SR_SCALAR_KERNELS
+		lines[i] = total_lines_for_yres(yres[i], vfreq[i], range, borders[i], interlace[i]);
+#else
+		int vvt = max(yres[i] / interlace[i] + round_near(vfreq[i] * yres[i] / (interlace[i] * (1.0 - vfreq[i] * (vertical_blank + borders[i]))) * (vertical_blank + borders[i])), 1);
+
+		// The scalar loop adds lines until hfreq_min is reached, or one more line would reach hfreq_max
+		int to_min = scale_above(vfreq[i], hfreq_min);
+		int to_max = scale_above(vfreq[i], hfreq_max) - 1;
+		lines[i] = max(vvt, min(to_min, to_max));
+#endif
+	}
+}
+
+//============================================================
+//  max_vfreq_for_yres_batch
+//============================================================
+
+void max_vfreq_for_yres_batch(const int *yres, const monitor_range *range, const double *borders, const double *interlace, double *vfreq, size_t count)
+{
+	const double hfreq_max = range->hfreq_max;
+	const double vertical_blank = range->vertical_blank;
+
+	for (size_t i = 0; i < count; i++)
+	{
+#ifdef SR_SCALAR_KERNELS
+		vfreq[i] = max_vfreq_for_yres(yres[i], range, borders[i], interlace[i]);
+#else
+		vfreq[i] = hfreq_max / (yres[i] / interlace[i] + round_near(hfreq_max * (vertical_blank + borders[i])));
+#endif
+	}
+}
+
+//============================================================
+//  Fixed-point timing core
+//============================================================
+
+// Integer twins of modeline_timings, stretch_into_range and modeline_vesa_gtf. Build with
+// SR_FIXED_TIMINGS to have modeline_create and modeline_vesa_gtf use them. Frequencies are
+// in uHz, times in ns, fractional lines in millionths of a line, and the line time of the
+// porch search in fs. Comparisons are done by cross multiplying, so the only roundings are
+// the ones of the inputs, of hfreq, and of the results. Known differences with the double
+// versions, which tests/test_fixed_timings checks:
+//  - pclock and hfreq are computed from hfreq in uHz, the last digits may differ
+//  - exact ties, in the porch search or when rounding lines, are decided by the formula
+//    and not by rounding noise, so either result is possible there
+
+#define FX_UHZ     1000000LL
+#define FX_NS      1000000000LL
+#define FX_LINE    1000000LL
+#define FX_HZ_NS   (FX_UHZ * FX_NS)
+
+static inline int64_t fx_round(double value, int64_t unit)
+{
+	return llround(value * unit);
+}
+
+// Floor, ceiling and nearest (halves away from zero, as round_near) of a / b, for b > 0
+static inline int64_t fx_div_floor(int64_t a, int64_t b)
+{
+	int64_t q = a / b;
+	return (a % b != 0 && a < 0)? q - 1 : q;
+}
+
+static inline int64_t fx_div_ceil(int64_t a, int64_t b)
+{
+	return -fx_div_floor(-a, b);
+}
+
+static inline int64_t fx_div_round(int64_t a, int64_t b)
+{
+	return a < 0? -((-a + b / 2) / b) : (a + b / 2) / b;
+}
+
+// round_near, round_near_odd or round_near_even of a value in FX_LINE units
+static int fx_round_lines(int64_t lines, int (*pf_round)(double))
+{
+	int64_t c = fx_div_ceil(lines, FX_LINE);
+	int64_t f = fx_div_floor(lines, FX_LINE);
+
+	if (pf_round == round_near_odd) return c % 2 == 0? f : c;
+	if (pf_round == round_near_even) return c % 2 != 0? f : c;
+	return fx_div_round(lines, FX_LINE);
+}
+
+//============================================================
+//  get_line_params_fixed
+//============================================================
+
+int get_line_params_fixed(modeline *mode, int64_t hfreq, const monitor_range *range, int char_size)
+{
+	// c chars out of n last c * line_time / n, so c * char_time < porch is
+	// c * line_time < porch * n, and the same goes for the distances to the porch.
+	// Line time in fs is 1e21 / hfreq, done in two steps to stay in 64 bits. Porches are in us
+	const int64_t ps = FX_UHZ * FX_NS * 1000;
+	const int64_t line_time = ps / hfreq * 1000 + fx_div_round(ps % hfreq * 1000, hfreq);
+	const int64_t porch[3] = { fx_round(range->hfront_porch, FX_NS), fx_round(range->hsync_pulse, FX_NS), fx_round(range->hback_porch, FX_NS) };
+	int64_t chars[3] = { 1, 1, 1 };
+	int64_t hh = mode->hactive / char_size;
+	int64_t n, new_n = hh + 3;
+
+	do {
+		n = new_n;
+		for (int i = 0; i < 3; i++)
+		{
+			int64_t target = porch[i] * n;
+			int64_t c = chars[i] * line_time;
+			if (10 * c < 9 * target || llabs(c + line_time - target) < llabs(c - target))
+				chars[i]++;
+		}
+		new_n = hh + chars[0] + chars[1] + chars[2];
+	} while (new_n != n);
+
+	mode->hbegin = (hh + chars[0]) * char_size;
+	mode->hend   = (hh + chars[0] + chars[1]) * char_size;
+	mode->htotal = (hh + chars[0] + chars[1] + chars[2]) * char_size;
+
+	return 0;
+}
+
+//============================================================
+//  modeline_timings_fixed
+//============================================================
+
+int modeline_timings_fixed(modeline *mode, const monitor_range *range, const generator_settings *cs, double vvt, double borders, double scan_factor, double interlace)
+{
+	// vvt comes in halves and scan_factor in quarters, keep them exact
+	int64_t vvt2 = fx_round(vvt, 2);
+	int64_t scan4 = fx_round(scan_factor, 4);
+	int64_t incr2 = !cs->interlace_force_even && interlace == 2? 1 : 0;
+	int (*pf_round)(double) = interlace == 2? (cs->interlace_force_even? round_near_even : round_near_odd) : round_near;
+
+	// Horizontal frequency, everything below is integer
+	int64_t hfreq = fx_round(mode->vfreq * vvt, FX_UHZ);
+	mode->hfreq = double(hfreq) / FX_UHZ;
+
+	get_line_params_fixed(mode, hfreq, range, cs->pixel_precision? 1 : 8);
+
+	// Pixel clock in Hz, truncated as the double version does
+	mode->pclock = mode->htotal * hfreq / FX_UHZ;
+	if (mode->pclock <= cs->pclock_min)
+		return -1;
+
+	// Vertical blanking, hfreq * time gives lines in FX_HZ_NS units
+	mode->vtotal = vvt2 * scan4 / 8;
+	int64_t vblank2 = 2 * fx_div_round(hfreq * fx_round(range->vertical_blank + borders, FX_NS), FX_HZ_NS) + incr2;
+	int64_t margin = (int64_t(mode->vtotal - mode->vactive) * 8 - vblank2 * scan4) * (FX_LINE / 8) / (cs->v_shift_correct? 1 : 2);
+
+	int64_t v_front_porch = margin + fx_div_round(hfreq * fx_round(range->vfront_porch, FX_NS) * scan4, 4 * FX_HZ_NS / FX_LINE) + incr2 * FX_LINE / 2;
+	int64_t v_sync = fx_div_round(hfreq * fx_round(range->vsync_pulse, FX_NS) * scan4, 4 * FX_HZ_NS / FX_LINE);
+
+	mode->vbegin = mode->vactive + max(fx_round_lines(v_front_porch, pf_round), 1);
+	mode->vend = mode->vbegin + max(fx_round_lines(v_sync, round_near), 1);
+
+	// Final vfreq
+	mode->vfreq = double(hfreq * scan4) / (4.0 * FX_UHZ * mode->vtotal);
+
+	return 0;
+}
+
+//============================================================
+//  stretch_into_range_fixed
+//============================================================
+
+int stretch_into_range_fixed(double vfreq, const monitor_range *range, double borders, bool interlace_allowed, double *interlace)
+{
+	int yres, lower_limit;
+
+	if (range->interlaced_lines_min && interlace_allowed)
+	{
+		yres = range->interlaced_lines_max;
+		lower_limit = range->interlaced_lines_min;
+		*interlace = 2;
+	}
+	else
+	{
+		yres = range->progressive_lines_max;
+		lower_limit = range->progressive_lines_min;
+	}
+
+	// max_vfreq_for_yres < vfreq is hfreq_max * interlace < vfreq * (yres + blank_lines * interlace)
+	int64_t scan = *interlace == 2? 2 : 1;
+	int64_t hfreq_max = fx_round(range->hfreq_max, FX_UHZ);
+	int64_t blank_lines = fx_div_round(hfreq_max * fx_round(range->vertical_blank + borders, FX_NS), FX_HZ_NS);
+	int64_t vfreq_fx = fx_round(vfreq, FX_UHZ);
+
+	while (yres > lower_limit && hfreq_max * scan < vfreq_fx * (yres + blank_lines * scan))
+		yres -= 8;
+
+	return yres;
+}
+
+//============================================================
+//  modeline_vesa_gtf_fixed
+//============================================================
+
+int modeline_vesa_gtf_fixed(modeline *m)
+{
+	// Same GTF defaults as modeline_vesa_gtf_double: C = 30%, M = 300%/kHz, 550 us for vsync
+	// and back porch, 3 vsync lines, 1 front porch line, 8% hsync and 16 pixel cells
+	const int64_t v_sync_lines = 3;
+	const int64_t v_front_porch_lines = 1;
+	const int64_t v_sync_v_back_porch = 550000;
+
+	int64_t v_freq = fx_round(m->vfreq? m->vfreq : double(m->refresh), FX_UHZ);
+	int64_t interlace2 = m->interlace? 1 : 0;
+
+	// h_period = (1 / v_freq - 550 us) / (height + 1 + interlace / 2), the lines for 550 us
+	// being 550 us / h_period, rounded. Both sides are multiplied by 2 * v_freq here
+	int64_t frame = FX_HZ_NS - v_sync_v_back_porch * v_freq;
+	int64_t v_sync_v_back_porch_lines = fx_div_round(v_sync_v_back_porch * v_freq * (2 * (m->height + v_front_porch_lines) + interlace2), 2 * frame);
+	int64_t v_total_lines = m->height + v_front_porch_lines + v_sync_v_back_porch_lines;
+
+	// The real line period is 1 / (v_total_lines * v_freq), so the line rate in uHz is h_freq
+	// and the ideal blanking, C - M * h_period, is 30 - 3e11 / h_freq percent
+	int64_t h_freq = v_total_lines * v_freq;
+	int64_t h_blanking_pixels = fx_div_round(m->width * (30 * h_freq - 300000000000LL), 16 * (70 * h_freq + 300000000000LL)) * 16;
+	int64_t h_total_pixels = m->width + h_blanking_pixels;
+	int64_t h_sync_width_pixels = (8 * h_total_pixels / 100 / 8) * 8;
+	int64_t h_front_porch_pixels = (h_blanking_pixels / 2) - h_sync_width_pixels;
+
+	// Results
+	m->hactive = m->width;
+	m->hbegin = m->hactive + h_front_porch_pixels;
+	m->hend = m->hbegin + h_sync_width_pixels;
+	m->htotal = h_total_pixels;
+	m->vactive = m->height;
+	m->vbegin = m->vactive + v_front_porch_lines;
+	m->vend = m->vbegin + v_sync_lines;
+	m->vtotal = v_total_lines;
+	m->hfreq = double(h_freq) / FX_UHZ;
+	m->vfreq = double(v_freq) / FX_UHZ;
+	m->pclock = h_total_pixels * h_freq / FX_UHZ;
+	m->hsync = 0;
+	m->vsync = 1;
+
+	return true;
+}
+
 //============================================================
 //  modeline_print
 //============================================================
@@ -525,12 +850,206 @@ int modeline_compare(modeline *t, modeline *best)
 	return 0;
 }
 
+//============================================================
+//  order_double, order_float
+//============================================================
+
+// IEEE 754 bits rearranged so that unsigned order is numeric order, -0 and +0 are the same
+static inline uint64_t order_double(double value)
+{
+	uint64_t bits;
+	value = value == 0? 0.0 : value;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits & 0x8000000000000000ULL? ~bits : bits | 0x8000000000000000ULL;
+}
+
+static inline uint32_t order_float(float value)
+{
+	uint32_t bits;
+	value = value == 0? 0.0f : value;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits & 0x80000000U? ~bits : bits | 0x80000000U;
+}
+
+//============================================================
+//  modeline_score_key
+//============================================================
+
+void modeline_score_key(const modeline *mode, modeline_score *score)
+{
+	// Built from the very same expressions modeline_compare uses, so the keys are exact
+	const mode_result *r = &mode->result;
+	bool vector = (mode->hactive == (int)r->x_scale);
+	bool stretch = r->weight & R_RES_STRETCH;
+
+	// Weight first, then the branch of modeline_compare used within this weight
+	score->key[0] = (uint64_t)(uint32_t)r->weight << 1 | (!stretch && vector? 1 : 0);
+
+	if (stretch || vector)
+	{
+		// less refresh error, then higher y score, then higher x scale
+		double y_score = r->y_scale * (mode->interlace?(2.0/3.0):1.0);
+		score->key[1] = order_double(fabs(r->v_diff));
+		score->key[2] = ~order_double(y_score);
+		score->key[3] = ~order_double(r->x_scale);
+	}
+	else
+	{
+		// lower y score, then less distortion, then lower x scale, then less refresh error
+		int y_score = r->y_scale + r->scan_penalty;
+		float xy_diff = roundf((r->x_diff + r->y_diff) * 100) / 100;
+		score->key[1] = (uint64_t)((uint32_t)y_score ^ 0x80000000U) << 32 | order_float(xy_diff);
+		score->key[2] = order_double(r->x_scale);
+		score->key[3] = order_double(fabs(r->v_diff));
+	}
+}
+
+//============================================================
+//  modeline_score_comparable
+//============================================================
+
+bool modeline_score_comparable(const modeline_score *a, const modeline_score *b)
+{
+	// Only the branch bit differs: same weight, one is a vector mode and the other isn't.
+	// modeline_compare isn't symmetric in that case, so no key can match it
+	return (a->key[0] ^ b->key[0]) != 1;
+}
+
+//============================================================
+//  modeline_score_better
+//============================================================
+
+bool modeline_score_better(modeline *t_mode, const modeline_score *t_score, modeline *best_mode, const modeline_score *best_score)
+{
+	if (modeline_score_comparable(t_score, best_score))
+		return *t_score < *best_score;
+
+	return modeline_compare(t_mode, best_mode);
+}
+
+//============================================================
+//  modeline_lower_bound
+//============================================================
+
+int modeline_lower_bound(const modeline *s_mode, const modeline *t_mode, const monitor_range *range, const generator_settings *cs)
+{
+	// Follows the first steps of modeline_create, without generating anything. The weight
+	// returned is never higher than the one modeline_create would give, R_OUT_OF_RANGE
+	// means modeline_create would fail for sure, before writing any result
+	int weight = 0;
+	double interlace = 1;
+	double doublescan = 1;
+	double borders = 0;
+	int y_scale = 0;
+
+	// Vertical refresh
+	int v_scale = scale_into_range(t_mode->vfreq, range->vfreq_min, range->vfreq_max);
+	if (v_scale != 1 && !(t_mode->type & V_FREQ_EDITABLE))
+		return R_OUT_OF_RANGE;
+
+	// Vertical resolution
+	if (range->progressive_lines_min && (!t_mode->interlace || (t_mode->type & SCAN_EDITABLE)))
+		y_scale = scale_into_range(t_mode->vactive, range->progressive_lines_min, range->progressive_lines_max);
+
+	if (!y_scale && range->interlaced_lines_min && cs->interlace && (t_mode->interlace || (t_mode->type & SCAN_EDITABLE)))
+	{
+		y_scale = scale_into_range(t_mode->vactive, range->interlaced_lines_min, range->interlaced_lines_max);
+		interlace = 2;
+	}
+
+	if (y_scale == 1 || (y_scale > 1 && (t_mode->type & Y_RES_EDITABLE)))
+	{
+		if (!(t_mode->type & V_FREQ_EDITABLE))
+		{
+			if (cs->doublescan && y_scale % 2 == 0)
+			{
+				y_scale /= 2;
+				doublescan = 0.5;
+			}
+
+			if (cs->v_shift_correct)
+				borders = (range->progressive_lines_max - t_mode->vactive * y_scale / interlace) * (1.0 / range->hfreq_min) / 2;
+
+			// a fixed refresh must be achievable for this height
+			double vfreq_real = min(t_mode->vfreq * v_scale, max_vfreq_for_yres(t_mode->vactive * y_scale, range, borders, interlace * doublescan));
+			if (vfreq_real != t_mode->vfreq * v_scale)
+				return R_OUT_OF_RANGE;
+		}
+
+		// a fixed height smaller than the source, or too big to scale, is stretched
+		if (!(t_mode->type & Y_RES_EDITABLE))
+		{
+			double y_ratio = double(t_mode->vactive) * y_scale / s_mode->vactive;
+			if (!(y_ratio >= 1.0 && y_ratio < 16.0))
+				weight |= R_RES_STRETCH;
+		}
+	}
+	else if (t_mode->type & Y_RES_EDITABLE)
+		weight |= R_RES_STRETCH;
+	else
+		return R_OUT_OF_RANGE;
+
+	// A fixed width smaller than the source is stretched
+	if (!(t_mode->type & X_RES_EDITABLE) && t_mode->hactive < s_mode->hactive)
+		weight |= R_RES_STRETCH;
+
+	// With a fixed refresh, the final one can only be lower, and it's exact for a fixed height
+	if (!(t_mode->type & V_FREQ_EDITABLE))
+	{
+		double v_diff = t_mode->vfreq - s_mode->vfreq;
+		if (v_diff < -cs->refresh_tolerance || (!(t_mode->type & Y_RES_EDITABLE) && fabs(v_diff) > cs->refresh_tolerance))
+			weight |= R_V_FREQ_OFF;
+	}
+
+	return weight;
+}
+
+//============================================================
+//  modeline_is_perfect
+//============================================================
+
+bool modeline_is_perfect(const modeline *s_mode, const modeline *best, const generator_settings *cs)
+{
+	// True when no other mode can beat best under modeline_compare, so the search can stop
+	if (best->result.weight != 0 || fabs(best->result.v_diff) != 0)
+		return false;
+
+	// Any contender has weight 0, so it's compared by integer scaling unless it's a vector mode,
+	// which can't happen unless the source is just a few pixels wide
+	if (s_mode->hactive < 2 || s_mode->hactive * cs->monitor_aspect <= 2 * STANDARD_CRT_ASPECT)
+		return false;
+
+	int b_y_score = best->result.y_scale + best->result.scan_penalty;
+	double best_xy_diff = roundf((best->result.x_diff + best->result.y_diff) * 100) / 100;
+	if (b_y_score > 1 || best_xy_diff > 0)
+		return false;
+
+	// Integer x scales start at 1, fractional ones only apply from super_width up
+	double source_aspect = s_mode->type & MODE_ROTATED? 1.0 / (STANDARD_CRT_ASPECT) : (STANDARD_CRT_ASPECT);
+	double x_scale_min = min(1.0, double(cs->super_width) / s_mode->hactive * source_aspect / cs->monitor_aspect);
+
+	return best->result.x_scale <= x_scale_min;
+}
+
 //============================================================
 //  modeline_vesa_gtf
-//  Based on the VESA GTF spreadsheet by Andy Morrish 1/5/97
 //============================================================
 
 int modeline_vesa_gtf(modeline *m)
+{
+#ifdef SR_FIXED_TIMINGS
+	return modeline_vesa_gtf_fixed(m);
+#else
+	return modeline_vesa_gtf_double(m);
+#endif
+}
+
+//============================================================
+//  modeline_vesa_gtf_double
+//  Based on the VESA GTF spreadsheet by Andy Morrish 1/5/97
+//============================================================
+
+int modeline_vesa_gtf_double(modeline *m)
 {
 	int C, M;
 	int v_sync_lines, v_porch_lines_min, v_front_porch_lines, v_back_porch_lines, v_sync_v_back_porch_lines, v_total_lines;
@@ -685,12 +1204,20 @@ int modeline_to_monitor_range(monitor_range *range, modeline *mode)
 }
 
 //============================================================
-//  modeline_adjust
+//  modeline_adjust_r
 //============================================================
 
-int modeline_adjust(modeline *mode, double hfreq_max, generator_settings *cs)
+int modeline_adjust_r(const modeline *source, double hfreq_max, const generator_settings *settings, modeline *mode, modeline_adjustment *adj)
 {
-	// If input values are out of range, they are fixed within range and returned in the cs struct.
+	// Work on copies, inputs are never modified. Values out of range are fixed and returned in adj.
+	generator_settings gs = *settings;
+	generator_settings *cs = &gs;
+	modeline_adjustment dummy_adj;
+	if (adj == nullptr) adj = &dummy_adj;
+	memset(adj, 0, sizeof(modeline_adjustment));
+
+	if (mode != source)
+		*mode = *source;
 
 	// H size ajdustment, valid values 0.5-2.0
 	if (cs->h_size != 1.0f)
@@ -700,6 +1227,9 @@ int modeline_adjust(modeline *mode, double hfreq_max, generator_settings *cs)
 		else if (cs->h_size < 0.5f)
 			cs->h_size = 0.5f;
 
+		if (cs->h_size != settings->h_size)
+			adj->clamped |= ADJ_H_SIZE;
+
 		monitor_range range;
 		memset(&range, 0, sizeof(monitor_range));
 
@@ -720,6 +1250,9 @@ int modeline_adjust(modeline *mode, double hfreq_max, generator_settings *cs)
 		else if (cs->h_shift <= mode->hend - mode->htotal)
 			cs->h_shift = mode->hend - mode->htotal + 1;
 
+		if (cs->h_shift != settings->h_shift)
+			adj->clamped |= ADJ_H_SHIFT;
+
 		mode->hbegin -= cs->h_shift;
 		mode->hend -= cs->h_shift;
 	}
@@ -770,6 +1303,9 @@ int modeline_adjust(modeline *mode, double hfreq_max, generator_settings *cs)
 			vtotal += padding;
 		}
 
+		if (cs->v_shift != settings->v_shift)
+			adj->clamped |= ADJ_V_SHIFT;
+
 		vbegin -= cs->v_shift;
 		vend -= cs->v_shift;
 
@@ -788,17 +1324,170 @@ int modeline_adjust(modeline *mode, double hfreq_max, generator_settings *cs)
 		{
 			mode->hfreq = mode->vfreq * mode->vtotal / (mode->interlace? 2.0 : 1.0);
 
-			monitor_range range;
-			memset(&range, 0, sizeof(monitor_range));
-			modeline_to_monitor_range(&range, mode);
-			monitor_show_range(&range);
-			modeline_create(mode, mode, &range, cs);
+			// Return the new range, so the caller can report it
+			adj->range_rebuilt = 1;
+			memset(&adj->range, 0, sizeof(monitor_range));
+			modeline_to_monitor_range(&adj->range, mode);
+			modeline_create(mode, mode, &adj->range, cs);
+		}
+	}
+
+	adj->h_size = cs->h_size;
+	adj->h_shift = cs->h_shift;
+	adj->v_shift = cs->v_shift;
+
+	return 0;
+}
+
+//============================================================
+//  modeline_adjust
+//============================================================
+
+int modeline_adjust(modeline *mode, double hfreq_max, generator_settings *cs)
+{
+	// Legacy interface: clamped values are returned in the cs struct
+	modeline_adjustment adj;
+	modeline_adjust_r(mode, hfreq_max, cs, mode, &adj);
+
+	cs->h_size = adj.h_size;
+	cs->h_shift = adj.h_shift;
+	cs->v_shift = adj.v_shift;
+
+	if (adj.range_rebuilt)
+		monitor_show_range(&adj.range);
+
+	return 0;
+}
+
+//============================================================
+//  modeline_fit_pclock
+//============================================================
+
+// Search window, in characters and lines each way
+#define FIT_PCLOCK_MAX_STEPS 16
+// Other totals must leave at most this part of the error of just rounding the pclock,
+// and cut it by this many parts per million of the refresh
+#define FIT_PCLOCK_MIN_GAIN 0.5
+#define FIT_PCLOCK_MIN_PPM 1.0
+
+int modeline_fit_pclock(modeline *mode, const monitor_range *range, const generator_settings *cs)
+{
+	double scan_factor = (mode->interlace? 2.0 : 1.0) * (mode->doublescan? 0.5 : 1.0);
+	double target = mode->vfreq;
+
+	mode->result.v_drift = mode->htotal && mode->vtotal? double(mode->pclock) / mode->htotal / mode->vtotal * scan_factor - target : 0;
+
+	uint64_t step = cs->pclock_step;
+	if (step == 0 || !mode->htotal || !mode->vtotal || target <= 0)
+		return 0;
+
+	// Back porches can move by the tolerance get_line_params gives them, or a single unit,
+	// keeping htotal aligned and the line parity of interlaced and doublescan modes
+	int h_unit = cs->pixel_precision? 1 : 8;
+	int v_unit = mode->interlace || mode->doublescan? 2 : 1;
+	double pixel_time = 1000000.0 / mode->pclock;
+	int h_steps = min(FIT_PCLOCK_MAX_STEPS, max(1, int(range->hback_porch * .10 / pixel_time / h_unit)));
+	int v_steps = min(FIT_PCLOCK_MAX_STEPS, max(1, int(range->vback_porch * .10 * mode->hfreq / v_unit)));
+
+	// Don't push the frequencies out of the range, unless the mode already was
+	double hfreq_min = min(range->hfreq_min, mode->hfreq);
+	double hfreq_max = max(range->hfreq_max, mode->hfreq);
+	double vfreq_min = min(range->vfreq_min, target);
+	double vfreq_max = max(range->vfreq_max, target);
+
+	int best_htotal = 0, best_vtotal = 0, best_distance = 0;
+	uint64_t best_pclock = 0, plain_pclock = 0;
+	double best_error = 0, plain_error = 0;
+
+	for (int h = -h_steps; h <= h_steps; h++)
+	{
+		int htotal = mode->htotal + h * h_unit;
+		if (htotal <= mode->hend)
+			continue;
+
+		for (int v = -v_steps; v <= v_steps; v++)
+		{
+			int vtotal = mode->vtotal + v * v_unit;
+			if (vtotal <= mode->vend)
+				continue;
+
+			// The two pclock steps around the exact one
+			double exact = target * htotal * vtotal / scan_factor;
+			uint64_t lower = uint64_t(exact / step) * step;
+
+			for (uint64_t pclock = lower; pclock <= lower + step; pclock += step)
+			{
+				if (pclock <= cs->pclock_min)
+					continue;
+
+				double hfreq = double(pclock) / htotal;
+				double vfreq = hfreq / vtotal * scan_factor;
+				if (hfreq < hfreq_min || hfreq > hfreq_max || vfreq < vfreq_min || vfreq > vfreq_max)
+					continue;
+
+				// Closest refresh first, then the closest timings to the original ones
+				double error = fabs(vfreq - target);
+				int distance = abs(h) + abs(v);
+				if (distance == 0 && (plain_pclock == 0 || error < plain_error))
+				{
+					plain_pclock = pclock;
+					plain_error = error;
+				}
+				if (best_pclock == 0 || error < best_error || (error == best_error && distance < best_distance))
+				{
+					best_htotal = htotal;
+					best_vtotal = vtotal;
+					best_pclock = pclock;
+					best_error = error;
+					best_distance = distance;
+				}
+			}
 		}
 	}
 
+	if (best_pclock == 0)
+		return -1;
+
+	// Keep the created timings unless other ones are clearly better
+	if (plain_pclock != 0 && (best_error > plain_error * FIT_PCLOCK_MIN_GAIN || plain_error - best_error < target * FIT_PCLOCK_MIN_PPM / 1000000.0))
+	{
+		best_htotal = mode->htotal;
+		best_vtotal = mode->vtotal;
+		best_pclock = plain_pclock;
+	}
+
+	mode->htotal = best_htotal;
+	mode->vtotal = best_vtotal;
+	mode->pclock = best_pclock;
+	mode->hfreq = double(best_pclock) / best_htotal;
+	mode->vfreq = mode->hfreq / best_vtotal * scan_factor;
+	mode->result.v_drift = mode->vfreq - target;
+
 	return 0;
 }
 
+//============================================================
+//  modeline_refresh
+//============================================================
+
+void modeline_refresh(const modeline *mode, uint64_t *num, uint64_t *den)
+{
+	// Same as vfreq: pclock / (htotal * vtotal) times the scan factor
+	uint64_t n = mode->pclock * (mode->interlace? 2 : 1);
+	uint64_t d = uint64_t(mode->htotal) * mode->vtotal * (mode->doublescan? 2 : 1);
+
+	uint64_t a = n, b = d;
+	while (b != 0)
+	{
+		uint64_t r = a % b;
+		a = b;
+		b = r;
+	}
+
+	*num = a? n / a : 0;
+	*den = a? d / a : 0;
+}
+
 //============================================================
 //  modeline_is_different
 //============================================================
@@ -809,6 +1498,25 @@ int modeline_is_different(modeline *n, modeline *p)
 	return memcmp(n, p, offsetof(struct modeline, vfreq));
 }
 
+//============================================================
+//  modeline_transition
+//============================================================
+
+int modeline_transition(const modeline *from, const modeline *to)
+{
+	if (from->interlace != to->interlace || from->doublescan != to->doublescan)
+		return MODE_TRANSITION_SCAN;
+
+	if (from->hactive != to->hactive || from->vactive != to->vactive)
+		return MODE_TRANSITION_SIZE;
+
+	if (from->pclock != to->pclock || from->hbegin != to->hbegin || from->hend != to->hend || from->htotal != to->htotal ||
+		from->vbegin != to->vbegin || from->vend != to->vend || from->vtotal != to->vtotal || from->hsync != to->hsync || from->vsync != to->vsync)
+		return MODE_TRANSITION_PORCH;
+
+	return MODE_TRANSITION_IDENTICAL;
+}
+
 //============================================================
 //  modeline_copy_timings
 //============================================================
@@ -823,14 +1531,8 @@ void modeline_copy_timings(modeline *n, modeline *p)
 //  monitor_fill_vesa_gtf
 //============================================================
 
-int monitor_fill_vesa_gtf(monitor_range *range, const char *max_lines)
+int monitor_fill_vesa_gtf(monitor_range *range, int lines)
 {
-	int lines = 0;
-	sscanf(max_lines, "vesa_%d", &lines);
-
-	if (!lines)
-		return 0;
-
 	int i = 0;
 	if (lines >= 480)
 		i += monitor_fill_vesa_range(&range[i], 384, 480);
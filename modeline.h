@@ -36,6 +36,11 @@
 #define R_RES_STRETCH   0x00000002
 #define R_OUT_OF_RANGE  0x00000004
 
+// Adjusted geometry values that had to be clamped
+#define ADJ_H_SIZE      0x00000001
+#define ADJ_H_SHIFT     0x00000002
+#define ADJ_V_SHIFT     0x00000004
+
 // Mode types
 #define MODE_OK         0x00000000
 #define MODE_DESKTOP    0x01000000
@@ -55,6 +60,12 @@
 #define DUMMY_WIDTH 1234
 #define MAX_MODELINES 256
 
+// Transitions between the timings on screen and new ones, cheapest first
+#define MODE_TRANSITION_IDENTICAL 0
+#define MODE_TRANSITION_PORCH     1
+#define MODE_TRANSITION_SIZE      2
+#define MODE_TRANSITION_SCAN      3
+
 //============================================================
 //  TYPE DEFINITIONS
 //============================================================
@@ -69,6 +80,9 @@ typedef struct mode_result
 	double  x_diff;
 	double  y_diff;
 	double  v_diff;
+	double  v_drift; // refresh achieved with the final pclock minus the one the timings were made for
+	double  v_source; // refresh of the source mode the result is for
+	double  v_vrr; // refresh shown with variable refresh, 0 when the mode's own refresh is
 } mode_result;
 
 typedef struct modeline
@@ -108,6 +122,7 @@ typedef struct generator_settings
 	int      interlace;
 	int      doublescan;
 	uint64_t pclock_min;
+	uint64_t pclock_step;
 	double   monitor_aspect;
 	double   refresh_tolerance;
 	int      super_width;
@@ -120,21 +135,90 @@ typedef struct generator_settings
 	int      scale_proportional;
 } generator_settings;
 
+typedef struct modeline_adjustment
+{
+	double   h_size;         // geometry actually applied, after clamping
+	int      h_shift;
+	int      v_shift;
+	int      clamped;        // ADJ_ flags for the values that were out of range
+	int      range_rebuilt;  // v_shift padding forced a new range, returned below
+	monitor_range range;
+} modeline_adjustment;
+
+// modeline_compare's ranking as a big integer, most significant word first: lower is better.
+// Keys of the same weight only agree with modeline_compare if both modes use the same
+// branch of it (vector modes don't), see modeline_score_comparable
+typedef struct modeline_score
+{
+	uint64_t key[4];
+} modeline_score;
+
+inline bool operator<(const modeline_score &a, const modeline_score &b)
+{
+	for (int i = 0; i < 4; i++)
+		if (a.key[i] != b.key[i])
+			return a.key[i] < b.key[i];
+	return false;
+}
+
+inline bool operator==(const modeline_score &a, const modeline_score &b)
+{
+	return a.key[0] == b.key[0] && a.key[1] == b.key[1] && a.key[2] == b.key[2] && a.key[3] == b.key[3];
+}
+
 //============================================================
 //  PROTOTYPES
 //============================================================
 
-int modeline_create(modeline *s_mode, modeline *t_mode, monitor_range *range, generator_settings *cs);
+// Reentrant: only t_mode is written, so it can be called from several threads
+int modeline_create(const modeline *s_mode, modeline *t_mode, const monitor_range *range, const generator_settings *cs);
 int modeline_compare(modeline *t_mode, modeline *best_mode);
+// Cheap checks that let a search skip modeline_create for pairs that can't win
+int modeline_lower_bound(const modeline *s_mode, const modeline *t_mode, const monitor_range *range, const generator_settings *cs);
+bool modeline_is_perfect(const modeline *s_mode, const modeline *best, const generator_settings *cs);
+void modeline_score_key(const modeline *mode, modeline_score *score);
+bool modeline_score_comparable(const modeline_score *a, const modeline_score *b);
+// Same as modeline_compare(t_mode, best_mode), using the scores whenever they're comparable
+bool modeline_score_better(modeline *t_mode, const modeline_score *t_score, modeline *best_mode, const modeline_score *best_score);
 char * modeline_print(modeline *mode, char *modeline, int flags);
 char * modeline_result(modeline *mode, char *result);
 int modeline_vesa_gtf(modeline *m);
+int modeline_vesa_gtf_double(modeline *m);
 int modeline_parse(const char *user_modeline, modeline *mode);
 int modeline_to_monitor_range(monitor_range *range, modeline *mode);
+// Reentrant: source and cs are left untouched, results go to mode and adj (adj may be null)
+int modeline_adjust_r(const modeline *source, double hfreq_max, const generator_settings *cs, modeline *mode, modeline_adjustment *adj);
+// Legacy wrapper: clamps the geometry in cs and logs the new range, if any
 int modeline_adjust(modeline *mode, double hfreq_max, generator_settings *cs);
+// Moves htotal, vtotal and pclock within the porch tolerances so that a pclock made of whole
+// cs->pclock_step gets the closest to the mode's refresh, the error left goes to result.v_drift
+int modeline_fit_pclock(modeline *mode, const monitor_range *range, const generator_settings *cs);
+// Refresh the timings really give, as num / den Hz in lowest terms
+void modeline_refresh(const modeline *mode, uint64_t *num, uint64_t *den);
 int modeline_is_different(modeline *n, modeline *p);
+// Porch means the active size and scan are kept, only the blanking and the pixel clock change
+int modeline_transition(const modeline *from, const modeline *to);
 void modeline_copy_timings(modeline *n, modeline *p);
 
+// Range fitting helpers, and their batch versions, which are bit identical
+int scale_into_range (int value, int lower_limit, int higher_limit);
+int scale_into_range (double value, double lower_limit, double higher_limit);
+int total_lines_for_yres(int yres, double vfreq, const monitor_range *range, double borders, double interlace);
+double max_vfreq_for_yres (int yres, const monitor_range *range, double borders, double interlace);
+void scale_into_range_batch(const int *value, int lower_limit, int higher_limit, int *scale, size_t count);
+void scale_into_range_batch(const double *value, double lower_limit, double higher_limit, int *scale, size_t count);
+void total_lines_for_yres_batch(const int *yres, const double *vfreq, const monitor_range *range, const double *borders, const double *interlace, int *lines, size_t count);
+void max_vfreq_for_yres_batch(const int *yres, const monitor_range *range, const double *borders, const double *interlace, double *vfreq, size_t count);
+
+// Timing core of modeline_create: hfreq, pclock and timings of a mode whose vactive and vfreq are
+// known. Returns -1 when pclock is not above cs->pclock_min. The fixed-point versions are used
+// instead when built with SR_FIXED_TIMINGS, both are always available to check one against the other
+int modeline_timings(modeline *mode, const monitor_range *range, const generator_settings *cs, double vvt, double borders, double scan_factor, double interlace);
+int modeline_timings_fixed(modeline *mode, const monitor_range *range, const generator_settings *cs, double vvt, double borders, double scan_factor, double interlace);
+int stretch_into_range(double vfreq, const monitor_range *range, double borders, bool interlace_allowed, double *interlace);
+int stretch_into_range_fixed(double vfreq, const monitor_range *range, double borders, bool interlace_allowed, double *interlace);
+int modeline_vesa_gtf_fixed(modeline *m);
+
 int round_near(double number);
 int round_near_odd(double number);
 int round_near_even(double number);
@@ -118,181 +118,271 @@ int monitor_show_range(monitor_range *range)
 }
 
 //============================================================
-//  monitor_set_preset
+//  PRESETS
 //============================================================
 
-int monitor_set_preset(const char *type, monitor_range *range)
+// A range as monitor_fill_range gets it from its specs line, with the vertical values in ms
+static constexpr monitor_range preset_range(double hfreq_min, double hfreq_max, double vfreq_min, double vfreq_max,
+	double hfront_porch, double hsync_pulse, double hback_porch, double vfront_porch, double vsync_pulse, double vback_porch,
+	int hsync_polarity, int vsync_polarity, int progressive_lines_min, int progressive_lines_max, int interlaced_lines_min, int interlaced_lines_max)
 {
-	// PAL TV - 50 Hz/625
-	if (!strcmp(type, "pal"))
-	{
-		monitor_fill_range(&range[0], "15625.00-15625.00, 50.00-50.00, 1.500, 4.700, 5.800, 0.064, 0.160, 1.056, 0, 0, 192, 288, 448, 576");
-		return 1;
-	}
-	// NTSC TV - 60 Hz/525
-	else if (!strcmp(type, "ntsc"))
-	{
-		monitor_fill_range(&range[0], "15734.26-15734.26, 59.94-59.94, 1.500, 4.700, 4.700, 0.191, 0.191, 0.953, 0, 0, 192, 240, 448, 480");
-		return 1;
-	}
-	// Generic 15.7 kHz
-	else if (!strcmp(type, "generic_15"))
-	{
-		monitor_fill_range(&range[0], "15625-15750, 49.50-65.00, 2.000, 4.700, 8.000, 0.064, 0.192, 1.024, 0, 0, 192, 288, 448, 576");
-		return 1;
-	}
-	// Arcade 15.7 kHz - standard resolution
-	else if (!strcmp(type, "arcade_15"))
-	{
-		monitor_fill_range(&range[0], "15625-16200, 49.50-65.00, 2.000, 4.700, 8.000, 0.064, 0.192, 1.024, 0, 0, 192, 288, 448, 576");
-		return 1;
-	}
-	// Arcade 15.7-16.5 kHz - extended resolution
-	else if (!strcmp(type, "arcade_15ex"))
-	{
-		monitor_fill_range(&range[0], "15625-16500, 49.50-65.00, 2.000, 4.700, 8.000, 0.064, 0.192, 1.024, 0, 0, 192, 288, 448, 576");
-		return 1;
-	}
-	// Arcade 25.0 kHz - medium resolution
-	else if (!strcmp(type, "arcade_25"))
-	{
-		monitor_fill_range(&range[0], "24960-24960, 49.50-65.00, 0.800, 4.000, 3.200, 0.080, 0.200, 1.000, 0, 0, 384, 400, 768, 800");
-		return 1;
-	}
-	// Arcade 31.5 kHz - medium resolution
-	else if (!strcmp(type, "arcade_31"))
-	{
-		monitor_fill_range(&range[0], "31400-31500, 49.50-65.00, 0.940, 3.770, 1.890, 0.349, 0.064, 1.017, 0, 0, 400, 512, 0, 0");
-		return 1;
-	}
-	// Arcade 15.7/25.0 kHz - dual-sync
-	else if (!strcmp(type, "arcade_15_25"))
-	{
-		monitor_fill_range(&range[0], "15625-16200, 49.50-65.00, 2.000, 4.700, 8.000, 0.064, 0.192, 1.024, 0, 0, 192, 288, 448, 576");
-		monitor_fill_range(&range[1], "24960-24960, 49.50-65.00, 0.800, 4.000, 3.200, 0.080, 0.200, 1.000, 0, 0, 384, 400, 768, 800");
-		return 2;
-	}
-	// Arcade 15.7/31.5 kHz - dual-sync
-	else if (!strcmp(type, "arcade_15_31"))
-	{
-		monitor_fill_range(&range[0], "15625-16200, 49.50-65.00, 2.000, 4.700, 8.000, 0.064, 0.192, 1.024, 0, 0, 192, 288, 448, 576");
-		monitor_fill_range(&range[1], "31400-31500, 49.50-65.00, 0.940, 3.770, 1.890, 0.349, 0.064, 1.017, 0, 0, 400, 512, 0, 0");
-		return 2;
-	}
-	// Arcade 15.7/25.0/31.5 kHz - tri-sync
-	else if (!strcmp(type, "arcade_15_25_31"))
-	{
-		monitor_fill_range(&range[0], "15625-16200, 49.50-65.00, 2.000, 4.700, 8.000, 0.064, 0.192, 1.024, 0, 0, 192, 288, 448, 576");
-		monitor_fill_range(&range[1], "24960-24960, 49.50-65.00, 0.800, 4.000, 3.200, 0.080, 0.200, 1.000, 0, 0, 384, 400, 768, 800");
-		monitor_fill_range(&range[2], "31400-31500, 49.50-65.00, 0.940, 3.770, 1.890, 0.349, 0.064, 1.017, 0, 0, 400, 512, 0, 0");
-		return 3;
-	}
-	// Makvision 2929D
-	else if (!strcmp(type, "m2929"))
-	{
-		monitor_fill_range(&range[0], "30000-40000, 47.00-90.00, 0.600, 2.500, 2.800, 0.032, 0.096, 0.448, 0, 0, 384, 640, 0, 0");
-		return 1;
-	}
-	// Wells Gardner D9800, D9400
-	else if (!strcmp(type, "d9800") || !strcmp(type, "d9400"))
-	{
-		monitor_fill_range(&range[0], "15250-18000, 40-80, 2.187, 4.688, 6.719, 0.190, 0.191, 1.018, 0, 0, 224, 288, 448, 576");
-		monitor_fill_range(&range[1], "18001-19000, 40-80, 2.187, 4.688, 6.719, 0.140, 0.191, 0.950, 0, 0, 288, 320, 0, 0");
-		monitor_fill_range(&range[2], "20501-29000, 40-80, 2.910, 3.000, 4.440, 0.451, 0.164, 1.048, 0, 0, 320, 384, 0, 0");
-		monitor_fill_range(&range[3], "29001-32000, 40-80, 0.636, 3.813, 1.906, 0.318, 0.064, 1.048, 0, 0, 384, 480, 0, 0");
-		monitor_fill_range(&range[4], "32001-34000, 40-80, 0.636, 3.813, 1.906, 0.020, 0.106, 0.607, 0, 0, 480, 576, 0, 0");
-		monitor_fill_range(&range[5], "34001-38000, 40-80, 1.000, 3.200, 2.200, 0.020, 0.106, 0.607, 0, 0, 576, 600, 0, 0");
-		return 6;
-	}
-	// Wells Gardner D9200
-	else if (!strcmp(type, "d9200"))
-	{
-		monitor_fill_range(&range[0], "15250-16500, 40-80, 2.187, 4.688, 6.719, 0.190, 0.191, 1.018, 0, 0, 224, 288, 448, 576");
-		monitor_fill_range(&range[1], "23900-24420, 40-80, 2.910, 3.000, 4.440, 0.451, 0.164, 1.148, 0, 0, 384, 400, 0, 0");
-		monitor_fill_range(&range[2], "31000-32000, 40-80, 0.636, 3.813, 1.906, 0.318, 0.064, 1.048, 0, 0, 400, 512, 0, 0");
-		monitor_fill_range(&range[3], "37000-38000, 40-80, 1.000, 3.200, 2.200, 0.020, 0.106, 0.607, 0, 0, 512, 600, 0, 0");
-		return 4;
-	}
-	// Wells Gardner K7000
-	else if (!strcmp(type, "k7000"))
-	{
-		monitor_fill_range(&range[0], "15625-15800, 49.50-63.00, 2.000, 4.700, 8.000, 0.064, 0.160, 1.056, 0, 0, 192, 288, 448, 576");
-		return 1;
-	}
-	// Wells Gardner 25K7131
-	else if (!strcmp(type, "k7131"))
-	{
-		monitor_fill_range(&range[0], "15625-16670, 49.5-65, 2.000, 4.700, 8.000, 0.064, 0.160, 1.056, 0, 0, 192, 288, 448, 576");
-		return 1;
-	}
-	// Wei-Ya M3129
-	else if (!strcmp(type, "m3129"))
-	{
-		monitor_fill_range(&range[0], "15250-16500, 40-80, 2.187, 4.688, 6.719, 0.190, 0.191, 1.018, 1, 1, 192, 288, 448, 576");
-		monitor_fill_range(&range[1], "23900-24420, 40-80, 2.910, 3.000, 4.440, 0.451, 0.164, 1.048, 1, 1, 384, 400, 0, 0");
-		monitor_fill_range(&range[2], "31000-32000, 40-80, 0.636, 3.813, 1.906, 0.318, 0.064, 1.048, 1, 1, 400, 512, 0, 0");
-		return 3;
-	}
-	// Hantarex MTC 9110
-	else if (!strcmp(type, "h9110") || !strcmp(type, "polo"))
-	{
-		monitor_fill_range(&range[0], "15625-16670, 49.5-65, 2.000, 4.700, 8.000, 0.064, 0.160, 1.056, 0, 0, 192, 288, 448, 576");
-		return 1;
-	}
-	// Hantarex Polostar 25
-	else if (!strcmp(type, "pstar"))
-	{
-		monitor_fill_range(&range[0], "15700-15800, 50-65, 1.800, 0.400, 7.400, 0.064, 0.160, 1.056, 0, 0, 192, 256, 0, 0");
-		monitor_fill_range(&range[1], "16200-16300, 50-65, 0.200, 0.400, 8.000, 0.040, 0.040, 0.640, 0, 0, 256, 264, 512, 528");
-		monitor_fill_range(&range[2], "25300-25400, 50-65, 0.200, 0.400, 8.000, 0.040, 0.040, 0.640, 0, 0, 384, 400, 768, 800");
-		monitor_fill_range(&range[3], "31500-31600, 50-65, 0.170, 0.350, 5.500, 0.040, 0.040, 0.640, 0, 0, 400, 512, 0, 0");
-		return 4;
-	}
-	// Nanao MS-2930, MS-2931
-	else if (!strcmp(type, "ms2930"))
-	{
-		monitor_fill_range(&range[0], "15450-16050, 50-65, 3.190, 4.750, 6.450, 0.191, 0.191, 1.164, 0, 0, 192, 288, 448, 576");
-		monitor_fill_range(&range[1], "23900-24900, 50-65, 2.870, 3.000, 4.440, 0.451, 0.164, 1.148, 0, 0, 384, 400, 0, 0");
-		monitor_fill_range(&range[2], "31000-32000, 50-65, 0.330, 3.580, 1.750, 0.316, 0.063, 1.137, 0, 0, 480, 512, 0, 0");
-		return 3;
-	}
-	// Nanao MS9-29
-	else if (!strcmp(type, "ms929"))
-	{
-		monitor_fill_range(&range[0], "15450-16050, 50-65, 3.910, 4.700, 6.850, 0.190, 0.191, 1.018, 0, 0, 192, 288, 448, 576");
-		monitor_fill_range(&range[1], "23900-24900, 50-65, 2.910, 3.000, 4.440, 0.451, 0.164, 1.048, 0, 0, 384, 400, 0, 0");
-		return 2;
-	}
-	// Rodotron 666B-29
-	else if (!strcmp(type, "r666b"))
-	{
-		monitor_fill_range(&range[0], "15450-16050, 50-65, 3.190, 4.750, 6.450, 0.191, 0.191, 1.164, 0, 0, 192, 288, 448, 576");
-		monitor_fill_range(&range[1], "23900-24900, 50-65, 2.870, 3.000, 4.440, 0.451, 0.164, 1.148, 0, 0, 384, 400, 0, 0");
-		monitor_fill_range(&range[2], "31000-32500, 50-65, 0.330, 3.580, 1.750, 0.316, 0.063, 1.137, 0, 0, 400, 512, 0, 0");
-		return 3;
-	}
-	// PC CRT 70kHz/120Hz
-	else if (!strcmp(type, "pc_31_120"))
+	return { hfreq_min, hfreq_max, vfreq_min, vfreq_max, hfront_porch, hsync_pulse, hback_porch,
+		vfront_porch / 1000, vsync_pulse / 1000, vback_porch / 1000, hsync_polarity, vsync_polarity,
+		progressive_lines_min, progressive_lines_max, interlaced_lines_min, interlaced_lines_max,
+		vfront_porch / 1000 + vsync_pulse / 1000 + vback_porch / 1000 };
+}
+
+// Ranges shared by several presets
+static constexpr monitor_range arcade_15_range = preset_range(15625, 16200, 49.50, 65.00, 2.000, 4.700, 8.000, 0.064, 0.192, 1.024, 0, 0, 192, 288, 448, 576);
+static constexpr monitor_range arcade_25_range = preset_range(24960, 24960, 49.50, 65.00, 0.800, 4.000, 3.200, 0.080, 0.200, 1.000, 0, 0, 384, 400, 768, 800);
+static constexpr monitor_range arcade_31_range = preset_range(31400, 31500, 49.50, 65.00, 0.940, 3.770, 1.890, 0.349, 0.064, 1.017, 0, 0, 400, 512, 0, 0);
+static constexpr monitor_range hantarex_range = preset_range(15625, 16670, 49.5, 65, 2.000, 4.700, 8.000, 0.064, 0.160, 1.056, 0, 0, 192, 288, 448, 576);
+
+// PAL TV - 50 Hz/625
+static constexpr monitor_range pal_ranges[] =
+{
+	preset_range(15625.00, 15625.00, 50.00, 50.00, 1.500, 4.700, 5.800, 0.064, 0.160, 1.056, 0, 0, 192, 288, 448, 576)
+};
+
+// NTSC TV - 60 Hz/525
+static constexpr monitor_range ntsc_ranges[] =
+{
+	preset_range(15734.26, 15734.26, 59.94, 59.94, 1.500, 4.700, 4.700, 0.191, 0.191, 0.953, 0, 0, 192, 240, 448, 480)
+};
+
+// Generic 15.7 kHz
+static constexpr monitor_range generic_15_ranges[] =
+{
+	preset_range(15625, 15750, 49.50, 65.00, 2.000, 4.700, 8.000, 0.064, 0.192, 1.024, 0, 0, 192, 288, 448, 576)
+};
+
+// Arcade 15.7 kHz - standard resolution
+static constexpr monitor_range arcade_15_ranges[] = { arcade_15_range };
+
+// Arcade 15.7-16.5 kHz - extended resolution
+static constexpr monitor_range arcade_15ex_ranges[] =
+{
+	preset_range(15625, 16500, 49.50, 65.00, 2.000, 4.700, 8.000, 0.064, 0.192, 1.024, 0, 0, 192, 288, 448, 576)
+};
+
+// Arcade 25.0 kHz - medium resolution
+static constexpr monitor_range arcade_25_ranges[] = { arcade_25_range };
+
+// Arcade 31.5 kHz - medium resolution
+static constexpr monitor_range arcade_31_ranges[] = { arcade_31_range };
+
+// Arcade 15.7/25.0 kHz - dual-sync
+static constexpr monitor_range arcade_15_25_ranges[] = { arcade_15_range, arcade_25_range };
+
+// Arcade 15.7/31.5 kHz - dual-sync
+static constexpr monitor_range arcade_15_31_ranges[] = { arcade_15_range, arcade_31_range };
+
+// Arcade 15.7/25.0/31.5 kHz - tri-sync
+static constexpr monitor_range arcade_15_25_31_ranges[] = { arcade_15_range, arcade_25_range, arcade_31_range };
+
+// Makvision 2929D
+static constexpr monitor_range m2929_ranges[] =
+{
+	preset_range(30000, 40000, 47.00, 90.00, 0.600, 2.500, 2.800, 0.032, 0.096, 0.448, 0, 0, 384, 640, 0, 0)
+};
+
+// Wells Gardner D9800, D9400
+static constexpr monitor_range d9800_ranges[] =
+{
+	preset_range(15250, 18000, 40, 80, 2.187, 4.688, 6.719, 0.190, 0.191, 1.018, 0, 0, 224, 288, 448, 576),
+	preset_range(18001, 19000, 40, 80, 2.187, 4.688, 6.719, 0.140, 0.191, 0.950, 0, 0, 288, 320, 0, 0),
+	preset_range(20501, 29000, 40, 80, 2.910, 3.000, 4.440, 0.451, 0.164, 1.048, 0, 0, 320, 384, 0, 0),
+	preset_range(29001, 32000, 40, 80, 0.636, 3.813, 1.906, 0.318, 0.064, 1.048, 0, 0, 384, 480, 0, 0),
+	preset_range(32001, 34000, 40, 80, 0.636, 3.813, 1.906, 0.020, 0.106, 0.607, 0, 0, 480, 576, 0, 0),
+	preset_range(34001, 38000, 40, 80, 1.000, 3.200, 2.200, 0.020, 0.106, 0.607, 0, 0, 576, 600, 0, 0)
+};
+
+// Wells Gardner D9200
+static constexpr monitor_range d9200_ranges[] =
+{
+	preset_range(15250, 16500, 40, 80, 2.187, 4.688, 6.719, 0.190, 0.191, 1.018, 0, 0, 224, 288, 448, 576),
+	preset_range(23900, 24420, 40, 80, 2.910, 3.000, 4.440, 0.451, 0.164, 1.148, 0, 0, 384, 400, 0, 0),
+	preset_range(31000, 32000, 40, 80, 0.636, 3.813, 1.906, 0.318, 0.064, 1.048, 0, 0, 400, 512, 0, 0),
+	preset_range(37000, 38000, 40, 80, 1.000, 3.200, 2.200, 0.020, 0.106, 0.607, 0, 0, 512, 600, 0, 0)
+};
+
+// Wells Gardner K7000
+static constexpr monitor_range k7000_ranges[] =
+{
+	preset_range(15625, 15800, 49.50, 63.00, 2.000, 4.700, 8.000, 0.064, 0.160, 1.056, 0, 0, 192, 288, 448, 576)
+};
+
+// Wells Gardner 25K7131
+static constexpr monitor_range k7131_ranges[] = { hantarex_range };
+
+// Wei-Ya M3129
+static constexpr monitor_range m3129_ranges[] =
+{
+	preset_range(15250, 16500, 40, 80, 2.187, 4.688, 6.719, 0.190, 0.191, 1.018, 1, 1, 192, 288, 448, 576),
+	preset_range(23900, 24420, 40, 80, 2.910, 3.000, 4.440, 0.451, 0.164, 1.048, 1, 1, 384, 400, 0, 0),
+	preset_range(31000, 32000, 40, 80, 0.636, 3.813, 1.906, 0.318, 0.064, 1.048, 1, 1, 400, 512, 0, 0)
+};
+
+// Hantarex MTC 9110
+static constexpr monitor_range h9110_ranges[] = { hantarex_range };
+
+// Hantarex Polostar 25
+static constexpr monitor_range pstar_ranges[] =
+{
+	preset_range(15700, 15800, 50, 65, 1.800, 0.400, 7.400, 0.064, 0.160, 1.056, 0, 0, 192, 256, 0, 0),
+	preset_range(16200, 16300, 50, 65, 0.200, 0.400, 8.000, 0.040, 0.040, 0.640, 0, 0, 256, 264, 512, 528),
+	preset_range(25300, 25400, 50, 65, 0.200, 0.400, 8.000, 0.040, 0.040, 0.640, 0, 0, 384, 400, 768, 800),
+	preset_range(31500, 31600, 50, 65, 0.170, 0.350, 5.500, 0.040, 0.040, 0.640, 0, 0, 400, 512, 0, 0)
+};
+
+// Nanao MS-2930, MS-2931
+static constexpr monitor_range ms2930_ranges[] =
+{
+	preset_range(15450, 16050, 50, 65, 3.190, 4.750, 6.450, 0.191, 0.191, 1.164, 0, 0, 192, 288, 448, 576),
+	preset_range(23900, 24900, 50, 65, 2.870, 3.000, 4.440, 0.451, 0.164, 1.148, 0, 0, 384, 400, 0, 0),
+	preset_range(31000, 32000, 50, 65, 0.330, 3.580, 1.750, 0.316, 0.063, 1.137, 0, 0, 480, 512, 0, 0)
+};
+
+// Nanao MS9-29
+static constexpr monitor_range ms929_ranges[] =
+{
+	preset_range(15450, 16050, 50, 65, 3.910, 4.700, 6.850, 0.190, 0.191, 1.018, 0, 0, 192, 288, 448, 576),
+	preset_range(23900, 24900, 50, 65, 2.910, 3.000, 4.440, 0.451, 0.164, 1.048, 0, 0, 384, 400, 0, 0)
+};
+
+// Rodotron 666B-29
+static constexpr monitor_range r666b_ranges[] =
+{
+	preset_range(15450, 16050, 50, 65, 3.190, 4.750, 6.450, 0.191, 0.191, 1.164, 0, 0, 192, 288, 448, 576),
+	preset_range(23900, 24900, 50, 65, 2.870, 3.000, 4.440, 0.451, 0.164, 1.148, 0, 0, 384, 400, 0, 0),
+	preset_range(31000, 32500, 50, 65, 0.330, 3.580, 1.750, 0.316, 0.063, 1.137, 0, 0, 400, 512, 0, 0)
+};
+
+// PC CRT 31kHz/120Hz
+static constexpr monitor_range pc_31_120_ranges[] =
+{
+	preset_range(31400, 31600, 100, 130, 0.671, 2.683, 3.353, 0.034, 0.101, 0.436, 0, 0, 200, 256, 0, 0),
+	preset_range(31400, 31600, 50, 65, 0.671, 2.683, 3.353, 0.034, 0.101, 0.436, 0, 0, 400, 512, 0, 0)
+};
+
+// PC CRT 70kHz/120Hz
+static constexpr monitor_range pc_70_120_ranges[] =
+{
+	preset_range(30000, 70000, 100, 130, 2.201, 0.275, 4.678, 0.063, 0.032, 0.633, 0, 0, 192, 320, 0, 0),
+	preset_range(30000, 70000, 50, 65, 2.201, 0.275, 4.678, 0.063, 0.032, 0.633, 0, 0, 400, 1024, 0, 0)
+};
+
+#define PRESET(name, description, ranges) { name, description, sizeof(ranges) / sizeof(ranges[0]), ranges, 0 }
+#define VESA_PRESET(lines, count) { "vesa_" #lines, "VESA GTF, up to " #lines " lines", count, nullptr, lines }
+
+// Sorted by name, for monitor_find_preset
+static constexpr monitor_preset presets[] =
+{
+	PRESET("arcade_15",       "Arcade 15.7 kHz - standard resolution",       arcade_15_ranges),
+	PRESET("arcade_15_25",    "Arcade 15.7/25.0 kHz - dual-sync",            arcade_15_25_ranges),
+	PRESET("arcade_15_25_31", "Arcade 15.7/25.0/31.5 kHz - tri-sync",        arcade_15_25_31_ranges),
+	PRESET("arcade_15_31",    "Arcade 15.7/31.5 kHz - dual-sync",            arcade_15_31_ranges),
+	PRESET("arcade_15ex",     "Arcade 15.7-16.5 kHz - extended resolution",  arcade_15ex_ranges),
+	PRESET("arcade_25",       "Arcade 25.0 kHz - medium resolution",         arcade_25_ranges),
+	PRESET("arcade_31",       "Arcade 31.5 kHz - medium resolution",         arcade_31_ranges),
+	PRESET("d9200",           "Wells Gardner D9200",                         d9200_ranges),
+	PRESET("d9400",           "Wells Gardner D9400",                         d9800_ranges),
+	PRESET("d9800",           "Wells Gardner D9800",                         d9800_ranges),
+	PRESET("generic_15",      "Generic 15.7 kHz",                            generic_15_ranges),
+	PRESET("h9110",           "Hantarex MTC 9110",                           h9110_ranges),
+	PRESET("k7000",           "Wells Gardner K7000",                         k7000_ranges),
+	PRESET("k7131",           "Wells Gardner 25K7131",                       k7131_ranges),
+	PRESET("m2929",           "Makvision 2929D",                             m2929_ranges),
+	PRESET("m3129",           "Wei-Ya M3129",                                m3129_ranges),
+	PRESET("ms2930",          "Nanao MS-2930, MS-2931",                      ms2930_ranges),
+	PRESET("ms929",           "Nanao MS9-29",                                ms929_ranges),
+	PRESET("ntsc",            "NTSC TV - 60 Hz/525",                         ntsc_ranges),
+	PRESET("pal",             "PAL TV - 50 Hz/625",                          pal_ranges),
+	PRESET("pc_31_120",       "PC CRT 31kHz/120Hz",                          pc_31_120_ranges),
+	PRESET("pc_70_120",       "PC CRT 70kHz/120Hz",                          pc_70_120_ranges),
+	PRESET("polo",            "Hantarex Polo",                               h9110_ranges),
+	PRESET("pstar",           "Hantarex Polostar 25",                        pstar_ranges),
+	PRESET("r666b",           "Rodotron 666B-29",                            r666b_ranges),
+	VESA_PRESET(1024, 4),
+	VESA_PRESET(480, 1),
+	VESA_PRESET(600, 2),
+	VESA_PRESET(768, 3)
+};
+
+#define PRESET_COUNT int(sizeof(presets) / sizeof(presets[0]))
+
+static constexpr bool name_less(const char *a, const char *b)
+{
+	return *a != *b? (unsigned char)*a < (unsigned char)*b : *a != 0 && name_less(a + 1, b + 1);
+}
+
+static constexpr bool presets_sorted(int i = 1)
+{
+	return i >= PRESET_COUNT || (name_less(presets[i - 1].name, presets[i].name) && presets_sorted(i + 1));
+}
+
+static_assert(presets_sorted(), "monitor presets must be sorted by name");
+
+//============================================================
+//  monitor_get_presets
+//============================================================
+
+int monitor_get_presets(const monitor_preset **list)
+{
+	*list = presets;
+	return PRESET_COUNT;
+}
+
+//============================================================
+//  monitor_find_preset
+//============================================================
+
+const monitor_preset *monitor_find_preset(const char *type)
+{
+	int first = 0, last = PRESET_COUNT - 1;
+
+	while (first <= last)
 	{
-		monitor_fill_range(&range[0], "31400-31600, 100-130, 0.671, 2.683, 3.353, 0.034, 0.101, 0.436, 0, 0, 200, 256, 0, 0");
-		monitor_fill_range(&range[1], "31400-31600, 50-65, 0.671, 2.683, 3.353, 0.034, 0.101, 0.436, 0, 0, 400, 512, 0, 0");
-		return 2;
+		int middle = (first + last) / 2;
+		int order = strcmp(type, presets[middle].name);
+
+		if (order == 0)
+			return &presets[middle];
+
+		if (order < 0)
+			last = middle - 1;
+		else
+			first = middle + 1;
 	}
-	// PC CRT 70kHz/120Hz
-	else if (!strcmp(type, "pc_70_120"))
+
+	return nullptr;
+}
+
+//============================================================
+//  monitor_set_preset
+//============================================================
+
+int monitor_set_preset(const char *type, monitor_range *range)
+{
+	const monitor_preset *preset = monitor_find_preset(type);
+
+	if (preset == nullptr)
 	{
-		monitor_fill_range(&range[0], "30000-70000, 100-130, 2.201, 0.275, 4.678, 0.063, 0.032, 0.633, 0, 0, 192, 320, 0, 0");
-		monitor_fill_range(&range[1], "30000-70000, 50-65, 2.201, 0.275, 4.678, 0.063, 0.032, 0.633, 0, 0, 400, 1024, 0, 0");
-		return 2;
+		log_error("Switchres: Monitor type unknown: %s\n", type);
+		return 0;
 	}
-	// VESA GTF
-	else if (!strcmp(type, "vesa_480") || !strcmp(type, "vesa_600") || !strcmp(type, "vesa_768") || !strcmp(type, "vesa_1024"))
+
+	// VESA GTF ranges are generated, the rest are ready to use
+	if (preset->vesa_lines)
+		return monitor_fill_vesa_gtf(range, preset->vesa_lines);
+
+	for (int i = 0; i < preset->ranges; i++)
 	{
-		return monitor_fill_vesa_gtf(&range[0], type);
+		range[i] = preset->range[i];
+		monitor_show_range(&range[i]);
 	}
 
-	log_error("Switchres: Monitor type unknown: %s\n", type);
-	return 0;
+	return preset->ranges;
 }
 
 //============================================================
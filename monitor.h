@@ -49,6 +49,15 @@ typedef struct monitor_range
 	double vertical_blank;
 } monitor_range;
 
+typedef struct monitor_preset
+{
+	const char *name;
+	const char *description;
+	int         ranges;
+	const monitor_range *range; // nullptr for the VESA GTF presets, generated when set
+	int         vesa_lines;
+} monitor_preset;
+
 //============================================================
 //  PROTOTYPES
 //============================================================
@@ -56,8 +65,10 @@ typedef struct monitor_range
 int monitor_fill_range(monitor_range *range, const char *specs_line);
 int monitor_show_range(monitor_range *range);
 int monitor_set_preset(const char *type, monitor_range *range);
+const monitor_preset *monitor_find_preset(const char *type);
+int monitor_get_presets(const monitor_preset **list);
 int monitor_fill_lcd_range(monitor_range *range, const char *specs_line);
-int monitor_fill_vesa_gtf(monitor_range *range, const char *max_lines);
+int monitor_fill_vesa_gtf(monitor_range *range, int lines);
 int monitor_fill_vesa_range(monitor_range *range, int lines_min, int lines_max);
 int monitor_evaluate_range(monitor_range *range);
 
@@ -95,11 +95,14 @@ switchres_manager::switchres_manager()
 	display()->set_lock_unsupported_modes(true);
 	display()->set_lock_system_modes(true);
 	display()->set_refresh_dont_care(false);
+	display()->set_modeline_cache(false);
+	display()->set_mode_threads(0);
 
 	// Set modeline generator default options
 	display()->set_interlace(true);
 	display()->set_doublescan(true);
 	display()->set_dotclock_min(0.0f);
+	display()->set_dotclock_step(0.0f);
 	display()->set_monitor_aspect(STANDARD_CRT_ASPECT);
 	display()->set_refresh_tolerance(2.0f);
 	display()->set_super_width(2560);
@@ -111,6 +114,11 @@ switchres_manager::switchres_manager()
 	display()->set_interlace_force_even(0);
 	display()->set_scale_proportional(1);
 
+	// Set custom video backend default options
+	display()->set_kms_fb_pool_size(64);
+	display()->set_kms_atomic(false);
+	display()->set_kms_vrr("0");
+
 	// Set logger properties
 	set_log_info_fn((void*)printf);
 	set_log_error_fn((void*)printf);
@@ -186,6 +194,10 @@ bool switchres_manager::parse_config(const char *file_name)
 		if (config_file.is_open())
 		{
 			log_verbose("parsing %s\n", full_path);
+
+			// Our persistent files go next to the main ini
+			if (!strcmp(file_name, "switchres.ini"))
+				display()->set_config_dir(paths.substr(start, end - start).c_str());
 			break;
 		}
 		start = end + 1;
@@ -295,6 +307,12 @@ void switchres_manager::set_option(const char* key, const char* value)
 		case s2i("keep_changes"):
 			display()->set_keep_changes(atoi(value));
 			break;
+		case s2i("modeline_cache"):
+			display()->set_modeline_cache(atoi(value));
+			break;
+		case s2i("mode_threads"):
+			display()->set_mode_threads(atoi(value));
+			break;
 
 		// Modeline generation options
 		case s2i("interlace"):
@@ -310,6 +328,13 @@ void switchres_manager::set_option(const char* key, const char* value)
 			display()->set_dotclock_min(pclock_min);
 			break;
 		}
+		case s2i("dotclock_step"):
+		{
+			double pclock_step = 0.0f;
+			sscanf(value, "%lf", &pclock_step);
+			display()->set_dotclock_step(pclock_step);
+			break;
+		}
 		case s2i("sync_refresh_tolerance"):
 		{
 			double refresh_tolerance = 0.0f;
@@ -377,6 +402,15 @@ void switchres_manager::set_option(const char* key, const char* value)
 		case s2i("custom_timing"):
 			display()->set_custom_timing(value);
 			break;
+		case s2i("kms_fb_pool_size"):
+			display()->set_kms_fb_pool_size(atoi(value));
+			break;
+		case s2i("kms_atomic"):
+			display()->set_kms_atomic(atoi(value));
+			break;
+		case s2i("kms_vrr"):
+			display()->set_kms_vrr(value);
+			break;
 
 		// Various
 		case s2i("verbosity"):
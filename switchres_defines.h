@@ -20,10 +20,13 @@
 #define  SR_OPT_LOCK_SYSTEM_MODES       "lock_system_modes"
 #define  SR_OPT_REFRESH_DONT_CARE       "refresh_dont_care"
 #define  SR_OPT_KEEP_CHANGES            "keep_changes"
+#define  SR_OPT_MODELINE_CACHE          "modeline_cache"
+#define  SR_OPT_MODE_THREADS            "mode_threads"
 #define  SR_OPT_MODELINE_GENERATION     "modeline_generation"
 #define  SR_OPT_INTERLACE               "interlace"
 #define  SR_OPT_DOUBLESCAN              "doublescan"
 #define  SR_OPT_DOTCLOCK_MIN            "dotclock_min"
+#define  SR_OPT_DOTCLOCK_STEP           "dotclock_step"
 #define  SR_OPT_SYNC_REFRESH_TOLERANCE  "sync_refresh_tolerance"
 #define  SR_OPT_SUPER_WIDTH             "super_width"
 #define  SR_OPT_ASPECT                  "aspect"
@@ -38,6 +41,9 @@
 #define  SR_OPT_SCREEN_REORDERING       "screen_reordering"
 #define  SR_OPT_ALLOW_HARDWARE_REFRESH  "allow_hardware_refresh"
 #define  SR_OPT_CUSTOM_TIMING           "custom_timing"
+#define  SR_OPT_KMS_FB_POOL_SIZE        "kms_fb_pool_size"
+#define  SR_OPT_KMS_ATOMIC              "kms_atomic"
+#define  SR_OPT_KMS_VRR                 "kms_vrr"
 #define  SR_OPT_VERBOSE                 "verbose"
 #define  SR_OPT_VERBOSITY               "verbosity"
 
@@ -13,7 +13,10 @@
  **************************************************************/
 
 #include <iostream>
+#include <fstream>
+#include <sstream>
 #include <cstring>
+#include <cstdarg>
 #include <getopt.h>
 #include "switchres.h"
 #include "switchres_defines.h"
@@ -23,6 +26,9 @@ using namespace std;
 
 int show_version();
 int show_usage();
+int show_presets();
+int run_batch(display_manager *display, const char *file_name, bool json);
+void log_stderr(const char *format, ...);
 
 enum
  {
@@ -44,10 +50,13 @@ enum
 	OPT_LOCK_SYSTEM_MODES,
 	OPT_REFRESH_DONT_CARE,
 	OPT_KEEP_CHANGES,
+	OPT_MODELINE_CACHE,
+	OPT_MODE_THREADS,
 	OPT_MODELINE_GENERATION,
 	OPT_INTERLACE,
 	OPT_DOUBLESCAN,
 	OPT_DOTCLOCK_MIN,
+	OPT_DOTCLOCK_STEP,
 	OPT_SYNC_REFRESH_TOLERANCE,
 	OPT_SUPER_WIDTH,
 	OPT_V_SHIFT_CORRECT,
@@ -61,7 +70,13 @@ enum
 	OPT_SCREEN_REORDERING,
 	OPT_ALLOW_HARDWARE_REFRESH,
 	OPT_CUSTOM_TIMING,
-	OPT_VERBOSITY
+	OPT_VERBOSITY,
+	OPT_KMS_FB_POOL_SIZE,
+	OPT_KMS_ATOMIC,
+	OPT_KMS_VRR,
+	OPT_BATCH,
+	OPT_FORMAT,
+	OPT_PRESETS
  };
 
 //============================================================
@@ -95,10 +110,15 @@ int main(int argc, char **argv)
 	bool user_ini_flag = false;
 	bool keep_changes_flag = false;
 	bool geometry_flag = false;
+	bool verbose_flag = false;
+	bool batch_flag = false;
+	bool json_flag = false;
+	bool presets_flag = false;
 	int status_code = 0;
 
 	string ini_file;
 	string launch_command;
+	string batch_file;
 
 	while (1)
 	{
@@ -116,6 +136,9 @@ int main(int argc, char **argv)
 			{"ini",         required_argument, 0, 'i'},
 			{"keep",        no_argument,       0, 'k'}, // equ. --keep_changes
 			{"geometry",    required_argument, 0, 'g'},
+			{"batch",       required_argument, 0, OPT_BATCH},
+			{"format",      required_argument, 0, OPT_FORMAT},
+			{"presets",     no_argument,       0, OPT_PRESETS},
 			// Options available in short and long forms
 			{SR_OPT_VERBOSE,                no_argument,       0, 'v'},
 			{SR_OPT_DISPLAY,                required_argument, 0, 'd'},
@@ -140,10 +163,13 @@ int main(int argc, char **argv)
 			{SR_OPT_LOCK_SYSTEM_MODES,      required_argument, 0, OPT_LOCK_SYSTEM_MODES},
 			{SR_OPT_REFRESH_DONT_CARE,      required_argument, 0, OPT_REFRESH_DONT_CARE},
 			{SR_OPT_KEEP_CHANGES,           required_argument, 0, OPT_KEEP_CHANGES},
+			{SR_OPT_MODELINE_CACHE,         required_argument, 0, OPT_MODELINE_CACHE},
+			{SR_OPT_MODE_THREADS,           required_argument, 0, OPT_MODE_THREADS},
 			{SR_OPT_MODELINE_GENERATION,    required_argument, 0, OPT_MODELINE_GENERATION},
 			{SR_OPT_INTERLACE,              required_argument, 0, OPT_INTERLACE},
 			{SR_OPT_DOUBLESCAN,             required_argument, 0, OPT_DOUBLESCAN},
 			{SR_OPT_DOTCLOCK_MIN,           required_argument, 0, OPT_DOTCLOCK_MIN},
+			{SR_OPT_DOTCLOCK_STEP,          required_argument, 0, OPT_DOTCLOCK_STEP},
 			{SR_OPT_SYNC_REFRESH_TOLERANCE, required_argument, 0, OPT_SYNC_REFRESH_TOLERANCE},
 			{SR_OPT_SUPER_WIDTH,            required_argument, 0, OPT_SUPER_WIDTH},
 			{SR_OPT_V_SHIFT_CORRECT,        required_argument, 0, OPT_V_SHIFT_CORRECT},
@@ -158,6 +184,9 @@ int main(int argc, char **argv)
 			{SR_OPT_ALLOW_HARDWARE_REFRESH, required_argument, 0, OPT_ALLOW_HARDWARE_REFRESH},
 			{SR_OPT_CUSTOM_TIMING,          required_argument, 0, OPT_CUSTOM_TIMING},
 			{SR_OPT_VERBOSITY,              required_argument, 0, OPT_VERBOSITY},
+			{SR_OPT_KMS_FB_POOL_SIZE,       required_argument, 0, OPT_KMS_FB_POOL_SIZE},
+			{SR_OPT_KMS_ATOMIC,             required_argument, 0, OPT_KMS_ATOMIC},
+			{SR_OPT_KMS_VRR,                required_argument, 0, OPT_KMS_VRR},
 			{0, 0, 0, 0}
 		};
 
@@ -176,6 +205,7 @@ int main(int argc, char **argv)
 		switch (c)
 		{
 			case 'v':
+				verbose_flag = true;
 				switchres.set_log_level(3);
 				switchres.set_log_error_fn((void*)printf);
 				switchres.set_log_info_fn((void*)printf);
@@ -254,6 +284,25 @@ int main(int argc, char **argv)
 				df->set_v_shift(v_shift);
 				break;
 
+			case OPT_BATCH:
+				batch_flag = true;
+				batch_file = optarg;
+				break;
+
+			case OPT_FORMAT:
+				if (!strcmp(optarg, "json"))
+					json_flag = true;
+				else if (strcmp(optarg, "csv"))
+				{
+					log_error("Error: use format csv or json\n");
+					goto usage;
+				}
+				break;
+
+			case OPT_PRESETS:
+				presets_flag = true;
+				break;
+
 			// Long options
 			case OPT_CRT_RANGE0:
 			case OPT_CRT_RANGE1:
@@ -272,10 +321,13 @@ int main(int argc, char **argv)
 			case OPT_LOCK_SYSTEM_MODES:
 			case OPT_REFRESH_DONT_CARE:
 			case OPT_KEEP_CHANGES:
+			case OPT_MODELINE_CACHE:
+			case OPT_MODE_THREADS:
 			case OPT_MODELINE_GENERATION:
 			case OPT_INTERLACE:
 			case OPT_DOUBLESCAN:
 			case OPT_DOTCLOCK_MIN:
+			case OPT_DOTCLOCK_STEP:
 			case OPT_SYNC_REFRESH_TOLERANCE:
 			case OPT_SUPER_WIDTH:
 			case OPT_V_SHIFT_CORRECT:
@@ -290,6 +342,9 @@ int main(int argc, char **argv)
 			case OPT_ALLOW_HARDWARE_REFRESH:
 			case OPT_CUSTOM_TIMING:
 			case OPT_VERBOSITY:
+			case OPT_KMS_FB_POOL_SIZE:
+			case OPT_KMS_ATOMIC:
+			case OPT_KMS_VRR:
 				switchres.set_option(long_options[option_index].name, optarg);
 				break;
 
@@ -301,6 +356,44 @@ int main(int argc, char **argv)
 	if (help_flag)
 		goto usage;
 
+	if (presets_flag)
+		return show_presets();
+
+	// Batch mode, calculate all the requests in a file against a single display
+	if (batch_flag)
+	{
+		if (argc - optind > 0)
+		{
+			log_error("Error: too many arguments\n");
+			goto usage;
+		}
+
+		// Batch requests are only calculated, on a single display
+		if (switch_flag || launch_flag || edid_flag || index > 0)
+		{
+			log_error("Error: --batch can't be used with -s, -l, -d or -e\n");
+			goto usage;
+		}
+
+		if (user_ini_flag)
+			switchres.parse_config(ini_file.c_str());
+
+		// Keep stdout for our results
+		if (!verbose_flag)
+			switchres.set_log_level(1);
+		switchres.set_log_error_fn((void*)log_stderr);
+		switchres.set_log_info_fn((void*)log_stderr);
+		switchres.set_log_verbose_fn((void*)log_stderr);
+
+		switchres.display()->set_screen("dummy");
+		switchres.add_display();
+
+		if (force_flag)
+			switchres.display()->set_user_mode(&user_mode);
+
+		return run_batch(switchres.display(), batch_file.c_str(), json_flag);
+	}
+
 	// Get user video mode information from command line
 	if ((argc - optind) < 3)
 	{
@@ -360,7 +453,7 @@ int main(int argc, char **argv)
 				monitor_range range = {};
 				modeline_to_monitor_range(&range, mode);
 				log_info("Adjusted geometry (%.3f:%d:%d) H: %.3f, %.3f, %.3f V: %.3f, %.3f, %.3f\n",
-						display->h_size(), display->h_shift(), display->v_shift(),
+						display->applied_h_size(), display->applied_h_shift(), display->applied_v_shift(),
 						range.hfront_porch, range.hsync_pulse, range.hback_porch,
 						range.vfront_porch * 1000, range.vsync_pulse * 1000, range.vback_porch * 1000);
 			}
@@ -413,6 +506,111 @@ usage:
 	return 0;
 }
 
+//============================================================
+//  log_stderr
+//============================================================
+
+void log_stderr(const char *format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	vfprintf(stderr, format, args);
+	va_end(args);
+}
+
+//============================================================
+//  run_batch
+//============================================================
+
+int run_batch(display_manager *display, const char *file_name, bool json)
+{
+	ifstream batch_file;
+	bool from_stdin = !strcmp(file_name, "-");
+
+	if (!from_stdin)
+	{
+		batch_file.open(file_name);
+		if (!batch_file.is_open())
+		{
+			log_error("Error: can't open %s\n", file_name);
+			return 1;
+		}
+	}
+	istream &input = from_stdin? cin : batch_file;
+
+	static char out_buffer[1 << 16];
+	setvbuf(stdout, out_buffer, _IOFBF, sizeof(out_buffer));
+
+	if (!json)
+		printf("width,height,refresh,interlaced,rotated,found,hactive,vactive,vfreq,hfreq,pclock,interlace,doublescan,range,weight,x_scale,y_scale,v_scale,x_diff,y_diff,v_diff,modeline\n");
+
+	string line;
+	int line_num = 0;
+	while (getline(input, line))
+	{
+		line_num++;
+
+		// Requests as in the command line: <width> <height> <refresh>[i] [r]
+		istringstream fields(line);
+		string token;
+		int width = 0, height = 0;
+		if (!(fields >> token) || token[0] == '#')
+			continue;
+
+		width = atoi(token.c_str());
+		if (!(fields >> height >> token) || width <= 0 || height <= 0 || atof(token.c_str()) <= 0)
+		{
+			log_error("Error: line %d, wrong video mode request: %s\n", line_num, line.c_str());
+			continue;
+		}
+
+		float refresh = atof(token.c_str());
+		bool interlaced = token.back() == 'i';
+		bool rotated = false;
+		while (fields >> token)
+		{
+			if (token == "r" || token == "rotated")
+				rotated = true;
+			else if (token == "i" || token == "interlaced")
+				interlaced = true;
+		}
+
+		int flags = (interlaced? SR_MODE_INTERLACED : 0) | (rotated? SR_MODE_ROTATED : 0);
+		modeline *mode = display->get_mode(width, height, refresh, flags);
+
+		modeline result = {};
+		char modeline_txt[256] = "";
+		const char *params = modeline_txt;
+		if (mode)
+		{
+			result = *mode;
+			modeline_print(&result, modeline_txt, MS_PARAMS);
+			while (*params == ' ') params++;
+		}
+
+		if (json)
+			printf("{\"width\":%d,\"height\":%d,\"refresh\":%.6f,\"interlaced\":%s,\"rotated\":%s,\"found\":%s,"
+				"\"hactive\":%d,\"vactive\":%d,\"vfreq\":%.6f,\"hfreq\":%.6f,\"pclock\":%lu,\"interlace\":%d,\"doublescan\":%d,\"range\":%d,"
+				"\"weight\":%d,\"x_scale\":%.6f,\"y_scale\":%.6f,\"v_scale\":%.6f,\"x_diff\":%.6f,\"y_diff\":%.6f,\"v_diff\":%.6f,\"modeline\":\"%s\"}\n",
+				width, height, refresh, interlaced? "true" : "false", rotated? "true" : "false", mode? "true" : "false",
+				result.hactive, result.vactive, result.vfreq, result.hfreq, (unsigned long)result.pclock, result.interlace, result.doublescan, result.range,
+				result.result.weight, result.result.x_scale, result.result.y_scale, result.result.v_scale, result.result.x_diff, result.result.y_diff, result.result.v_diff,
+				params);
+		else
+			printf("%d,%d,%.6f,%d,%d,%d,%d,%d,%.6f,%.6f,%lu,%d,%d,%d,%d,%.6f,%.6f,%.6f,%.6f,%.6f,%.6f,\"%s\"\n",
+				width, height, refresh, interlaced, rotated, mode? 1 : 0,
+				result.hactive, result.vactive, result.vfreq, result.hfreq, (unsigned long)result.pclock, result.interlace, result.doublescan, result.range,
+				result.result.weight, result.result.x_scale, result.result.y_scale, result.result.v_scale, result.result.x_diff, result.result.y_diff, result.result.v_diff,
+				params);
+
+		// Drop the new mode, so each request is calculated against the same mode list
+		display->restore_modes();
+	}
+
+	fflush(stdout);
+	return 0;
+}
+
 //============================================================
 //  show_version
 //============================================================
@@ -433,6 +631,21 @@ int show_version()
 	return 0;
 }
 
+//============================================================
+//  show_presets
+//============================================================
+
+int show_presets()
+{
+	const monitor_preset *presets;
+	int count = monitor_get_presets(&presets);
+
+	for (int i = 0; i < count; i++)
+		log_info("%-16s %d range%s  %s\n", presets[i].name, presets[i].ranges, presets[i].ranges > 1? "s" : " ", presets[i].description);
+
+	return 0;
+}
+
 //============================================================
 //  show_usage
 //============================================================
@@ -447,6 +660,7 @@ int show_usage()
 		"  -s, --switch                      Switch to video mode\n"
 		"  -l, --launch <command>            Launch <command>\n"
 		"  -m, --monitor <preset>            Monitor preset (generic_15, arcade_15, pal, ntsc, etc.)\n"
+		"      --presets                     List the monitor presets and exit\n"
 		"  -a, --aspect <num:den>            Monitor aspect ratio\n"
 		"  -r, --rotated                     Rotate axes, preserving aspect ratio.\n"
 		"  -d, --display <display_index>     Use target display (index = 0, 1, 2...)\n"
@@ -456,7 +670,10 @@ int show_usage()
 		"  -k, --keep                        Keep changes on exit (warning: this disables cleanup)\n"
 		"  -g, --geometry <adjustment>       Adjust geometry of generated modeline\n"
 		"                                    adjustment = <h_size>:<h_shift>:<v_shift>\n"
-		"                                    e.g. switchres 640 480 60 -c -g 1.1:-1:2\n\n"
+		"                                    e.g. switchres 640 480 60 -c -g 1.1:-1:2\n"
+		"      --batch <file>                Calculate the video modes requested in <file> (- for stdin),\n"
+		"                                    one per line as <width> <height> <refresh>[i] [r]\n"
+		"      --format <csv|json>           Batch output as CSV (default) or JSON lines\n\n"
 		"For more options, refer to switchres.ini. All options in switchres.ini can be applied in\n"
 		"command line as long options, e.g.: switchres 256 224 57.55 -c --dotclock_min 8.0\n\n"
 	};
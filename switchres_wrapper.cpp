@@ -18,6 +18,8 @@
 #include "log.h"
 #include <stdio.h>
 #include <locale>
+#include <cmath>
+#include <algorithm>
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -155,9 +157,9 @@ MODULE_API void sr_get_state(sr_state *state)
 	state->refresh_tolerance =   swr->display()->refresh_tolerance();
 	state->super_width =         swr->display()->super_width();
 	state->monitor_aspect =      swr->display()->monitor_aspect();
-	state->h_size =              swr->display()->h_size();
-	state->h_shift =             swr->display()->h_shift();
-	state->v_shift =             swr->display()->v_shift();
+	state->h_size =              swr->display()->applied_h_size();
+	state->h_shift =             swr->display()->applied_h_shift();
+	state->v_shift =             swr->display()->applied_v_shift();
 	state->pixel_precision =     swr->display()->pixel_precision();
 	state->selected_mode =       swr->display()->selected_mode() == nullptr? -1 : swr->display()->selected_mode()->id;
 	state->current_mode =        swr->display()->current_mode() == nullptr? -1 : swr->display()->current_mode()->id;
@@ -215,6 +217,53 @@ MODULE_API int sr_add_mode(int width, int height, double refresh, int flags, sr_
 }
 
 
+//============================================================
+//  sr_add_modes
+//============================================================
+
+MODULE_API int sr_add_modes(const sr_request *srq, int count, sr_mode *srm)
+{
+	// Returns how many requests got a mode, the ones that didn't are returned with id 0.
+	// The modes are flushed once at the end, unless a request has SR_MODE_DONT_FLUSH
+	display_manager *disp = swr->display();
+	if (disp == nullptr)
+	{
+		log_error("%s: error, didn't get a display\n", __FUNCTION__);
+		return 0;
+	}
+
+	if (srq == nullptr || srm == nullptr || count <= 0)
+	{
+		log_error("%s: error, invalid sr_request or sr_mode pointer\n", __FUNCTION__);
+		return 0;
+	}
+
+	bool flush = true;
+	std::vector<mode_request> requests(count);
+	for (int i = 0; i < count; i++)
+	{
+		requests[i].width = srq[i].width;
+		requests[i].height = srq[i].height;
+		requests[i].refresh = srq[i].refresh;
+		requests[i].flags = srq[i].flags & ~(SR_MODE_DONT_FLUSH);
+		if (srq[i].flags & SR_MODE_DONT_FLUSH)
+			flush = false;
+	}
+
+	std::vector<modeline> modes(count);
+	int found = disp->add_modes(requests.data(), count, modes.data(), flush);
+
+	for (int i = 0; i < count; i++)
+	{
+		srm[i] = {};
+		if (modes[i].id != 0)
+			modeline_to_sr_mode(&modes[i], &srm[i]);
+	}
+
+	return found;
+}
+
+
 //============================================================
 //  sr_flush
 //============================================================
@@ -235,6 +284,152 @@ MODULE_API int sr_switch_to_mode(int width, int height, double refresh, int flag
 }
 
 
+//============================================================
+//  sr_get_modes_ranked
+//============================================================
+
+MODULE_API int sr_get_modes_ranked(int width, int height, double refresh, int flags, sr_ranked_mode *srr, int k)
+{
+	display_manager *disp = swr->display();
+	if (disp == nullptr)
+	{
+		log_error("%s: error, didn't get a display\n", __FUNCTION__);
+		return 0;
+	}
+
+	if (srr == nullptr || k <= 0)
+	{
+		log_error("%s: error, invalid sr_ranked_mode pointer\n", __FUNCTION__);
+		return 0;
+	}
+
+	// Nothing is added to the mode list, so there's nothing to flush
+	std::vector<modeline> modes(k);
+	int count = disp->get_modes_ranked(width, height, refresh, flags, modes.data(), k);
+
+	for (int i = 0; i < count; i++)
+	{
+		modeline *m = &modes[i];
+		modeline_to_sr_mode(m, &srr[i].mode);
+		srr[i].range        = m->range;
+		srr[i].weight       = m->result.weight;
+		srr[i].scan_penalty = m->result.scan_penalty;
+		srr[i].x_diff       = m->result.x_diff;
+		srr[i].y_diff       = m->result.y_diff;
+		srr[i].v_diff       = m->result.v_diff;
+		srr[i].is_new       = m->type & MODE_ADD ? 1 : 0;
+	}
+
+	return count;
+}
+
+//============================================================
+//  sr_get_presets
+//============================================================
+
+MODULE_API int sr_get_presets(sr_preset *srp, int max)
+{
+	// Returns the number of presets, and fills in up to max of them if srp is given
+	const monitor_preset *presets;
+	int count = monitor_get_presets(&presets);
+
+	for (int i = 0; srp != nullptr && i < count && i < max; i++)
+	{
+		srp[i].name        = presets[i].name;
+		srp[i].description = presets[i].description;
+		srp[i].ranges      = presets[i].ranges;
+	}
+
+	return count;
+}
+
+//============================================================
+//  sr_get_refresh
+//============================================================
+
+MODULE_API int sr_get_refresh(int id, sr_refresh *srr)
+{
+	display_manager *disp = swr->display();
+	if (disp == nullptr)
+	{
+		log_error("%s: error, didn't get a display\n", __FUNCTION__);
+		return 0;
+	}
+
+	if (srr == nullptr)
+	{
+		log_error("%s: error, invalid sr_refresh pointer\n", __FUNCTION__);
+		return 0;
+	}
+
+	modeline *m = disp->find_mode_by_id(id);
+	if (m == nullptr || m->htotal == 0 || m->vtotal == 0)
+	{
+		log_error("%s: error, no mode with id %d\n", __FUNCTION__, id);
+		return 0;
+	}
+
+	*srr = {};
+	modeline_refresh(m, &srr->num, &srr->den);
+	srr->vfreq = srr->den? double(srr->num) / srr->den : 0;
+
+	// Modes that show each source frame several times are paced against that multiple
+	srr->requested = m->result.v_source > 0? m->result.v_source : srr->vfreq;
+	srr->target = srr->requested * std::max(1.0, round(srr->vfreq / srr->requested));
+
+	// With variable refresh, the frame pacing sets the refresh
+	if (m->result.v_vrr > 0)
+		srr->vfreq = srr->target = m->result.v_vrr;
+
+	// A mode without a dot clock has no refresh to measure the error of
+	if (srr->num == 0 || srr->target <= 0)
+	{
+		log_error("%s: error, mode with id %d has no refresh\n", __FUNCTION__, id);
+		return 0;
+	}
+
+	double error = (srr->vfreq - srr->target) / srr->target;
+	srr->ppm = error * 1000000.0;
+	srr->frames_to_slip = error != 0? 1.0 / fabs(error) : 0;
+
+	return 1;
+}
+
+//============================================================
+//  sr_get_vrr
+//============================================================
+
+MODULE_API int sr_get_vrr(int id, sr_vrr *srv)
+{
+	display_manager *disp = swr->display();
+	if (disp == nullptr)
+	{
+		log_error("%s: error, didn't get a display\n", __FUNCTION__);
+		return 0;
+	}
+
+	if (srv == nullptr)
+	{
+		log_error("%s: error, invalid sr_vrr pointer\n", __FUNCTION__);
+		return 0;
+	}
+
+	modeline *m = disp->find_mode_by_id(id);
+	if (m == nullptr)
+	{
+		log_error("%s: error, no mode with id %d\n", __FUNCTION__, id);
+		return 0;
+	}
+
+	// The window stops at the refresh of the mode
+	*srv = {};
+	srv->vfreq = m->result.v_vrr;
+	if (disp->vrr_range(&srv->vfreq_min, &srv->vfreq_max))
+		srv->vfreq_max = std::min(srv->vfreq_max, m->vfreq);
+
+	return 1;
+}
+
 //============================================================
 //  sr_set_mode
 //============================================================
@@ -303,6 +498,11 @@ MODULE_API srAPI srlib =
 	sr_set_log_callback_error,
 	sr_set_log_callback_info,
 	sr_set_log_callback_debug,
+	sr_get_modes_ranked,
+	sr_get_presets,
+	sr_get_refresh,
+	sr_add_modes,
+	sr_get_vrr,
 };
 
 
@@ -346,25 +546,16 @@ int sr_mode_internal(int width, int height, double refresh, int flags, sr_mode *
 
 	else if (action & SR_ACTION_GET_FROM_ID)
 	{
-		bool found = false;
-
-		for (auto mode : disp->video_modes)
-		{
-			if (mode.id == srm->id)
-			{
-				found = true;
-				disp->set_selected_mode(&mode);
-				log_verbose("%s: got mode %dx%d@%f type(%x)\n", caller, disp->width(), disp->height(), disp->v_freq(), disp->selected_mode()->type);
-				modeline_to_sr_mode(disp->selected_mode(), srm);
-				break;
-			}
-		}
-
-		if (!found)
+		modeline *mode = disp->find_mode_by_id(srm->id);
+		if (mode == nullptr)
 		{
 			log_error("%s: mode ID %d not found\n", caller, srm->id);
 			return 0;
 		}
+
+		disp->set_selected_mode(mode);
+		log_verbose("%s: got mode %dx%d@%f type(%x)\n", caller, disp->width(), disp->height(), disp->v_freq(), disp->selected_mode()->type);
+		modeline_to_sr_mode(disp->selected_mode(), srm);
 	}
 
 	if (action & SR_ACTION_FLUSH)
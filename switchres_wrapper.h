@@ -114,6 +114,56 @@ typedef struct MODULE_API sr_mode
 	int      id;
 } sr_mode;
 
+/* One of the candidates from sr_get_modes_ranked, with the metrics it was ranked by */
+typedef struct MODULE_API sr_ranked_mode
+{
+	sr_mode  mode;
+	int      range;
+	int      weight;
+	int      scan_penalty;
+	double   x_diff;
+	double   y_diff;
+	double   v_diff;
+	int      is_new;
+} sr_ranked_mode;
+
+/* One of the requests of sr_add_modes */
+typedef struct MODULE_API sr_request
+{
+	int      width;
+	int      height;
+	double   refresh;
+	int      flags;
+} sr_request;
+
+/* Refresh actually achieved by a mode, for frame pacing */
+typedef struct MODULE_API sr_refresh
+{
+	uint64_t num;            /* refresh of the mode's timings is num / den Hz, exactly */
+	uint64_t den;
+	double   vfreq;          /* achieved refresh: num / den, or the paced one with variable refresh */
+	double   requested;      /* refresh the mode was picked for */
+	double   target;         /* requested, times the frames shown per source frame (e.g. 60 for 30 Hz) */
+	double   ppm;            /* signed error of vfreq against target, in parts per million */
+	double   frames_to_slip; /* frames until the error adds up to a whole frame, 0 = never */
+} sr_refresh;
+
+/* Variable refresh of a mode, as given by sr_get_vrr */
+typedef struct MODULE_API sr_vrr
+{
+	double   vfreq;          /* refresh the frames are paced at, 0 = the mode's own vfreq */
+	double   vfreq_min;      /* variable refresh window, 0 when it's off */
+	double   vfreq_max;
+} sr_vrr;
+
+/* A monitor preset, as listed by sr_get_presets */
+typedef struct MODULE_API sr_preset
+{
+	const char *name;
+	const char *description;
+	int      ranges;
+} sr_preset;
+
 /* Used to retrieve SR settings and state */
 typedef struct MODULE_API sr_state
 {
@@ -143,13 +193,18 @@ MODULE_API int sr_init_disp(const char*, void*);
 MODULE_API void sr_set_disp(int);
 MODULE_API int sr_get_mode(int, sr_mode*);
 MODULE_API int sr_add_mode(int, int, double, int, sr_mode*);
+MODULE_API int sr_add_modes(const sr_request*, int, sr_mode*);
 MODULE_API int sr_switch_to_mode(int, int, double, int, sr_mode*);
+MODULE_API int sr_get_modes_ranked(int, int, double, int, sr_ranked_mode*, int);
 MODULE_API int sr_flush();
 MODULE_API int sr_set_mode(int);
 MODULE_API void sr_set_monitor(const char*);
 MODULE_API void sr_set_user_mode(int, int, int);
 MODULE_API void sr_set_option(const char* key, const char* value);
 MODULE_API void sr_get_state(sr_state *state);
+MODULE_API int sr_get_presets(sr_preset*, int);
+MODULE_API int sr_get_refresh(int, sr_refresh*);
+MODULE_API int sr_get_vrr(int, sr_vrr*);
 
 /* Logging related functions */
 MODULE_API void sr_set_log_level(int);
@@ -182,6 +237,11 @@ typedef struct MODULE_API srAPI
 	void (*set_log_callback_error)(void *);
 	void (*set_log_callback_info)(void *);
 	void (*set_log_callback_debug)(void *);
+	int (*get_modes_ranked)(int, int, double, int, sr_ranked_mode*, int);
+	int (*get_presets)(sr_preset*, int);
+	int (*get_refresh)(int, sr_refresh*);
+	int (*add_modes)(const sr_request*, int, sr_mode*);
+	int (*get_vrr)(int, sr_vrr*);
 } srAPI;
 
 
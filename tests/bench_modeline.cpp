@@ -0,0 +1,329 @@
+/**************************************************************
+
+   bench_modeline.cpp - Modeline engine benchmark
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../switchres.h"
+#include "../switchres_defines.h"
+#include "../log.h"
+
+using namespace std;
+typedef chrono::steady_clock bench_clock;
+
+//============================================================
+//  Allocation counter
+//============================================================
+
+static uint64_t alloc_count = 0;
+
+void *operator new(size_t size)
+{
+	alloc_count++;
+	void *p = malloc(size? size : 1);
+	if (p == nullptr)
+		throw bad_alloc();
+	return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+//============================================================
+//  Benchmark data
+//============================================================
+
+// Every preset known to monitor_set_preset
+static const char *bench_presets[] =
+{
+	"pal", "ntsc", "generic_15", "arcade_15", "arcade_15ex", "arcade_25", "arcade_31",
+	"arcade_15_25", "arcade_15_31", "arcade_15_25_31", "m2929", "d9800", "d9400", "d9200",
+	"k7000", "k7131", "m3129", "h9110", "polo", "pstar", "ms2930", "ms929", "r666b",
+	"pc_31_120", "pc_70_120", "vesa_480", "vesa_600", "vesa_768", "vesa_1024", nullptr
+};
+
+typedef struct bench_request
+{
+	int width;
+	int height;
+	float refresh;
+	int flags;
+} bench_request;
+
+typedef struct bench_result
+{
+	const char *name;
+	uint64_t ops;
+	uint64_t ns;
+	uint64_t allocs;
+	uint64_t candidates;
+} bench_result;
+
+//============================================================
+//  load_corpus
+//============================================================
+
+static bool load_corpus(const char *file_name, vector<bench_request> &requests)
+{
+	ifstream corpus(file_name);
+	if (!corpus.is_open())
+	{
+		printf("Error: can't open %s\n", file_name);
+		return false;
+	}
+
+	string line;
+	while (getline(corpus, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		istringstream fields(line);
+		string refresh, flag;
+		bench_request request = {};
+
+		if (!(fields >> request.width >> request.height >> refresh))
+			continue;
+
+		request.refresh = atof(refresh.c_str());
+		if (refresh.back() == 'i')
+			request.flags |= SR_MODE_INTERLACED;
+
+		while (fields >> flag)
+			if (flag == "r")
+				request.flags |= SR_MODE_ROTATED;
+
+		requests.push_back(request);
+	}
+
+	return requests.size() > 0;
+}
+
+//============================================================
+//  source_mode
+//============================================================
+
+// Build the source and target modes the same way get_mode does for a new mode
+static void source_mode(const bench_request &request, modeline *s_mode, modeline *t_mode)
+{
+	memset(s_mode, 0, sizeof(modeline));
+	s_mode->interlace = request.flags & SR_MODE_INTERLACED? 1 : 0;
+	s_mode->vfreq = request.refresh;
+	s_mode->hactive = request.width;
+	s_mode->vactive = request.height;
+
+	if (request.flags & SR_MODE_ROTATED)
+	{
+		swap(s_mode->hactive, s_mode->vactive);
+		s_mode->type |= MODE_ROTATED;
+	}
+
+	memset(t_mode, 0, sizeof(modeline));
+	t_mode->type = XYV_EDITABLE | V_FREQ_EDITABLE | SCAN_EDITABLE | MODE_ADD;
+	t_mode->hactive = s_mode->hactive;
+	t_mode->vactive = s_mode->vactive;
+	t_mode->vfreq = s_mode->vfreq;
+}
+
+//============================================================
+//  bench_preset
+//============================================================
+
+static void bench_preset(const char *preset, const vector<bench_request> &requests, const generator_settings *gs, bench_result *results)
+{
+	monitor_range range[MAX_RANGES] = {};
+	monitor_set_preset(preset, range);
+
+	vector<modeline> created;
+	vector<float> hfreq_max;
+	created.reserve(requests.size() * MAX_RANGES);
+	hfreq_max.reserve(requests.size() * MAX_RANGES);
+
+	// modeline_create
+	bench_result *r = &results[0];
+	for (auto &request : requests)
+	{
+		modeline s_mode, t_mode;
+		for (int i = 0; i < MAX_RANGES; i++)
+		{
+			if (range[i].hfreq_min == 0)
+				continue;
+
+			source_mode(request, &s_mode, &t_mode);
+
+			uint64_t allocs = alloc_count;
+			auto start = bench_clock::now();
+			modeline_create(&s_mode, &t_mode, &range[i], gs);
+			r->ns += chrono::duration_cast<chrono::nanoseconds>(bench_clock::now() - start).count();
+			r->allocs += alloc_count - allocs;
+			r->ops++;
+			r->candidates++;
+
+			t_mode.range = i;
+			created.push_back(t_mode);
+			hfreq_max.push_back(range[i].hfreq_max);
+		}
+	}
+
+	// modeline_compare, reduce all the candidates to a single best mode
+	r = &results[1];
+	{
+		modeline best_mode = {};
+		best_mode.result.weight |= R_OUT_OF_RANGE;
+
+		uint64_t allocs = alloc_count;
+		auto start = bench_clock::now();
+		for (auto &mode : created)
+			if (modeline_compare(&mode, &best_mode))
+				best_mode = mode;
+		r->ns += chrono::duration_cast<chrono::nanoseconds>(bench_clock::now() - start).count();
+		r->allocs += alloc_count - allocs;
+		r->ops += created.size();
+		r->candidates += created.size();
+	}
+
+	// modeline_adjust, on the candidates that are in range
+	r = &results[2];
+	vector<string> printed;
+	printed.reserve(created.size());
+	for (size_t i = 0; i < created.size(); i++)
+	{
+		if (created[i].result.weight & R_OUT_OF_RANGE)
+			continue;
+
+		modeline mode;
+
+		uint64_t allocs = alloc_count;
+		auto start = bench_clock::now();
+		modeline_adjust_r(&created[i], hfreq_max[i], gs, &mode, nullptr);
+		r->ns += chrono::duration_cast<chrono::nanoseconds>(bench_clock::now() - start).count();
+		r->allocs += alloc_count - allocs;
+		r->ops++;
+		r->candidates++;
+
+		char modeline_txt[256];
+		printed.push_back(modeline_print(&mode, modeline_txt, MS_FULL));
+	}
+
+	// modeline_parse, on the adjusted modelines
+	r = &results[3];
+	{
+		modeline mode;
+		uint64_t allocs = alloc_count;
+		auto start = bench_clock::now();
+		for (auto &line : printed)
+			modeline_parse(line.c_str(), &mode);
+		r->ns += chrono::duration_cast<chrono::nanoseconds>(bench_clock::now() - start).count();
+		r->allocs += alloc_count - allocs;
+		r->ops += printed.size();
+		r->candidates += printed.size();
+	}
+
+	// display_manager::get_mode on a dummy display
+	r = &results[4];
+	{
+		switchres_manager switchres;
+		switchres.set_log_level(0);
+		switchres.display()->set_screen("dummy");
+		switchres.display()->set_monitor(preset);
+
+		display_manager *display = switchres.add_display();
+		uint64_t candidates = display->mode_candidates();
+
+		for (auto &request : requests)
+		{
+			uint64_t allocs = alloc_count;
+			auto start = bench_clock::now();
+			display->get_mode(request.width, request.height, request.refresh, request.flags);
+			r->ns += chrono::duration_cast<chrono::nanoseconds>(bench_clock::now() - start).count();
+			r->allocs += alloc_count - allocs;
+			r->ops++;
+
+			// Drop the new mode so every request starts from the same mode list
+			display->restore_modes();
+		}
+		r->candidates += display->mode_candidates() - candidates;
+	}
+}
+
+//============================================================
+//  print_result
+//============================================================
+
+static void print_result(const char *label, bench_result *r)
+{
+	double ops = r->ops? (double)r->ops : 1.0;
+	printf("%-20s %10lu %12.1f %12.3f %14.2f\n", label, (unsigned long)r->ops, r->ns / ops, r->allocs / ops, r->candidates / ops);
+}
+
+//============================================================
+//  main
+//============================================================
+
+int main(int argc, char **argv)
+{
+	const char *corpus_file = argc > 1? argv[1] : "tests/bench_corpus.txt";
+
+	vector<bench_request> requests;
+	if (!load_corpus(corpus_file, requests))
+		return 1;
+
+	// Take the generator defaults from the manager
+	switchres_manager switchres;
+	switchres.set_log_level(0);
+	generator_settings gs = switchres.display()->m_ds.gs;
+
+	// Presets given in the command line, or all of them
+	vector<const char *> presets;
+	for (int i = 2; i < argc; i++)
+		presets.push_back(argv[i]);
+	if (presets.empty())
+		for (int i = 0; bench_presets[i] != nullptr; i++)
+			presets.push_back(bench_presets[i]);
+
+	const char *names[] = { "modeline_create", "modeline_compare", "modeline_adjust", "modeline_parse", "get_mode" };
+	bench_result total[5] = {};
+	for (int i = 0; i < 5; i++) total[i].name = names[i];
+
+	printf("Switchres %s benchmark, %s: %d requests, %d presets\n\n", SWITCHRES_VERSION, corpus_file, (int)requests.size(), (int)presets.size());
+	printf("%-20s %10s %12s %12s %14s\n", "get_mode", "ops", "ns/op", "allocs/op", "candidates/op");
+
+	for (auto preset : presets)
+	{
+		bench_result results[5] = {};
+		bench_preset(preset, requests, &gs, results);
+
+		for (int i = 0; i < 5; i++)
+		{
+			total[i].ops += results[i].ops;
+			total[i].ns += results[i].ns;
+			total[i].allocs += results[i].allocs;
+			total[i].candidates += results[i].candidates;
+		}
+
+		print_result(preset, &results[4]);
+	}
+
+	printf("\n%-20s %10s %12s %12s %14s\n", "total", "ops", "ns/op", "allocs/op", "candidates/op");
+	for (int i = 0; i < 5; i++)
+		print_result(total[i].name, &total[i]);
+
+	return 0;
+}
@@ -0,0 +1,1444 @@
+/**************************************************************
+
+   fake_drm.cpp - Stand-in libdrm for the DRM/KMS backend
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/falloc.h>
+#include <xf86drm.h>
+#include <xf86drmMode.h>
+#include "fake_drm.h"
+
+static const char *op_names[FAKE_DRM_OPS] = { "connector", "probe", "attach", "detach", "setcrtc", "commit", "dumb", "addfb", "getfb" };
+
+//============================================================
+//  properties
+//============================================================
+
+enum
+{
+	PROP_NONE,
+	PROP_CRTC_ID,
+	PROP_EDID,
+	PROP_VRR_CAPABLE,
+	PROP_MODE_ID,
+	PROP_ACTIVE,
+	PROP_VRR_ENABLED,
+	PROP_TYPE,
+	PROP_FB_ID,
+	PROP_SRC_X,
+	PROP_SRC_Y,
+	PROP_SRC_W,
+	PROP_SRC_H,
+	PROP_CRTC_X,
+	PROP_CRTC_Y,
+	PROP_CRTC_W,
+	PROP_CRTC_H,
+	PROP_COUNT
+};
+
+static const char *prop_names[PROP_COUNT] = { "", "CRTC_ID", "EDID", "vrr_capable", "MODE_ID", "ACTIVE", "VRR_ENABLED", "type",
+	"FB_ID", "SRC_X", "SRC_Y", "SRC_W", "SRC_H", "CRTC_X", "CRTC_Y", "CRTC_W", "CRTC_H" };
+
+static const std::vector<int> connector_props = { PROP_CRTC_ID, PROP_EDID, PROP_VRR_CAPABLE };
+static const std::vector<int> crtc_props = { PROP_MODE_ID, PROP_ACTIVE, PROP_VRR_ENABLED };
+static const std::vector<int> plane_props = { PROP_TYPE, PROP_FB_ID, PROP_CRTC_ID, PROP_SRC_X, PROP_SRC_Y, PROP_SRC_W, PROP_SRC_H,
+	PROP_CRTC_X, PROP_CRTC_Y, PROP_CRTC_W, PROP_CRTC_H };
+
+// Only shown to atomic clients, like the kernel does
+static bool atomic_only(int prop)
+{
+	return prop != PROP_EDID && prop != PROP_VRR_CAPABLE && prop != PROP_VRR_ENABLED && prop != PROP_TYPE;
+}
+
+static bool immutable(int prop)
+{
+	return prop == PROP_EDID || prop == PROP_VRR_CAPABLE || prop == PROP_TYPE;
+}
+
+//============================================================
+//  device state
+//============================================================
+
+typedef struct fake_config
+{
+	int cards = 1;
+	int connectors = 1;
+	int connected = -1;
+	bool user_modes = true;
+	bool atomic = true;
+	bool dumb = true;
+	bool vrr = false;
+	int edid_min = 0;
+	int edid_max = 0;
+	uint32_t max_clock = 0;
+	bool seamless = false;
+	unsigned int latency[FAKE_DRM_OPS] = {};
+	unsigned int fail[FAKE_DRM_OPS] = {};
+} fake_config;
+
+typedef struct fake_object
+{
+	uint32_t id = 0;
+	uint32_t type = 0;
+	uint64_t prop[PROP_COUNT] = {};
+} fake_object;
+
+typedef struct fake_connector : fake_object
+{
+	uint32_t encoder_id = 0;
+	bool connected = false;
+	std::vector<drmModeModeInfo> modes;
+} fake_connector;
+
+typedef struct fake_crtc : fake_object
+{
+	drmModeModeInfo mode = {};
+} fake_crtc;
+
+typedef struct fake_dumb
+{
+	drm_mode_create_dumb create;
+	uint64_t offset;
+} fake_dumb;
+
+typedef struct fake_card
+{
+	int memfd = -1;
+	dev_t dev = 0;
+	ino_t ino = 0;
+	char node[32] = {};
+	int master_fd = -1;
+	bool universal_planes = false;
+	bool atomic_client = false;
+	uint32_t next_id = 30;
+	uint32_t next_handle = 1;
+	uint64_t next_offset = 0;
+	uint32_t console_fb = 0;
+	uint32_t console_handle = 0;
+	std::vector<fake_connector> connectors;
+	std::vector<fake_crtc> crtcs;
+	std::vector<fake_object> planes;
+	std::map<uint32_t, std::vector<uint8_t>> blobs;
+	std::map<uint32_t, drmModeFB> fbs;
+	std::map<uint32_t, fake_dumb> dumbs;
+} fake_card;
+
+struct _drmModeAtomicReq
+{
+	struct item { uint32_t object_id, property_id; uint64_t value; };
+	std::vector<item> items;
+};
+
+static bool s_configured = false;
+static fake_config s_config;
+static std::vector<fake_card> s_cards;
+static std::vector<drmDevice> s_devices;
+static std::vector<char *> s_device_nodes;
+static unsigned int s_calls[FAKE_DRM_OPS] = {};
+static unsigned int s_modesets = 0;
+static unsigned int s_seamless = 0;
+
+static const drmModeModeInfo default_modes[] =
+{
+	{ 65000, 1024, 1048, 1184, 1344, 0, 768, 771, 777, 806, 0, 60, DRM_MODE_FLAG_NHSYNC | DRM_MODE_FLAG_NVSYNC, DRM_MODE_TYPE_DRIVER | DRM_MODE_TYPE_PREFERRED, "1024x768" },
+	{ 40000, 800, 840, 968, 1056, 0, 600, 601, 605, 628, 0, 60, DRM_MODE_FLAG_PHSYNC | DRM_MODE_FLAG_PVSYNC, DRM_MODE_TYPE_DRIVER, "800x600" },
+	{ 25175, 640, 656, 752, 800, 0, 480, 490, 492, 525, 0, 60, DRM_MODE_FLAG_NHSYNC | DRM_MODE_FLAG_NVSYNC, DRM_MODE_TYPE_DRIVER, "640x480" }
+};
+
+static int fake_configure(const char *config);
+
+//============================================================
+//  run_op
+//============================================================
+
+// Counts the call and waits for its latency, returns false when it must fail
+static bool run_op(fake_drm_op op)
+{
+	unsigned int call = ++s_calls[op];
+
+	if (s_config.latency[op])
+	{
+		timespec delay = { time_t(s_config.latency[op] / 1000000), long(s_config.latency[op] % 1000000) * 1000 };
+		nanosleep(&delay, nullptr);
+	}
+
+	return s_config.fail[op] != call;
+}
+
+//============================================================
+//  get_card
+//============================================================
+
+static bool same_file(const fake_card &card, int fd)
+{
+	struct stat st;
+	return fd >= 0 && !fstat(fd, &st) && st.st_dev == card.dev && st.st_ino == card.ino;
+}
+
+static bool has_master(const fake_card &card)
+{
+	return same_file(card, card.master_fd) && (fcntl(card.master_fd, F_GETFL) & O_NONBLOCK);
+}
+
+static bool is_master(const fake_card &card, int fd)
+{
+	return card.master_fd == fd && has_master(card);
+}
+
+static fake_card *get_card(int fd)
+{
+	if (!s_configured)
+		fake_configure(getenv("FAKE_DRM"));
+
+	for (auto &card : s_cards)
+	{
+		if (!same_file(card, fd))
+			continue;
+
+		// File status flags belong to the open file description, so O_NONBLOCK, which does
+		// nothing on a memfd otherwise, tells a new open() from a reused fd number
+		int flags = fcntl(fd, F_GETFL);
+		if (!(flags & O_NONBLOCK))
+		{
+			fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+
+			// Like the kernel, the first one to open the device becomes its master
+			if (card.master_fd == fd || !has_master(card))
+				card.master_fd = fd;
+		}
+		return &card;
+	}
+
+	errno = EBADF;
+	return nullptr;
+}
+
+//============================================================
+//  object lookup
+//============================================================
+
+static fake_object *find_object(fake_card *card, uint32_t id)
+{
+	for (auto &conn : card->connectors)
+		if (conn.id == id)
+			return &conn;
+
+	for (auto &crtc : card->crtcs)
+		if (crtc.id == id)
+			return &crtc;
+
+	for (auto &plane : card->planes)
+		if (plane.id == id)
+			return &plane;
+
+	return nullptr;
+}
+
+static fake_connector *find_connector(fake_card *card, uint32_t id)
+{
+	for (auto &conn : card->connectors)
+		if (conn.id == id)
+			return &conn;
+
+	return nullptr;
+}
+
+static int find_crtc(fake_card *card, uint32_t id)
+{
+	for (size_t i = 0; i < card->crtcs.size(); i++)
+		if (card->crtcs[i].id == id)
+			return i;
+
+	return -1;
+}
+
+static const std::vector<int> &object_props(uint32_t type)
+{
+	static const std::vector<int> none;
+	return type == DRM_MODE_OBJECT_CONNECTOR? connector_props : type == DRM_MODE_OBJECT_CRTC? crtc_props : type == DRM_MODE_OBJECT_PLANE? plane_props : none;
+}
+
+static bool has_prop(const fake_object *object, int prop)
+{
+	for (int p : object_props(object->type))
+		if (p == prop)
+			return true;
+
+	return false;
+}
+
+//============================================================
+//  mode comparison
+//============================================================
+
+static bool same_timings(const drmModeModeInfo *a, const drmModeModeInfo *b)
+{
+	return a->clock == b->clock && a->hdisplay == b->hdisplay && a->hsync_start == b->hsync_start && a->hsync_end == b->hsync_end &&
+		a->htotal == b->htotal && a->hskew == b->hskew && a->vdisplay == b->vdisplay && a->vsync_start == b->vsync_start &&
+		a->vsync_end == b->vsync_end && a->vtotal == b->vtotal && a->vscan == b->vscan && a->flags == b->flags;
+}
+
+// What variable refresh drivers can do on the fly: move the vertical porches
+static bool seamless_change(const drmModeModeInfo *a, const drmModeModeInfo *b)
+{
+	return a->clock == b->clock && a->hdisplay == b->hdisplay && a->hsync_start == b->hsync_start && a->hsync_end == b->hsync_end &&
+		a->htotal == b->htotal && a->vdisplay == b->vdisplay && a->flags == b->flags;
+}
+
+//============================================================
+//  dumb buffers
+//============================================================
+
+static int create_dumb(fake_card *card, drm_mode_create_dumb *create)
+{
+	if (!create->width || !create->height || !create->bpp)
+		return -EINVAL;
+
+	uint64_t page = sysconf(_SC_PAGESIZE);
+	create->pitch = (create->width * ((create->bpp + 7) / 8) + 63) & ~63;
+	create->size = uint64_t(create->pitch) * create->height;
+	create->handle = card->next_handle++;
+
+	// Each buffer gets its own range of the memfd, so it can be mapped through the device
+	fake_dumb dumb = { *create, card->next_offset };
+	card->next_offset += (create->size + page - 1) / page * page;
+	if (ftruncate(card->memfd, card->next_offset))
+		return -errno;
+
+	card->dumbs[create->handle] = dumb;
+	return 0;
+}
+
+//============================================================
+//  make_edid
+//============================================================
+
+// Base block with a display range limits descriptor
+static std::vector<uint8_t> make_edid(int vfreq_min, int vfreq_max)
+{
+	std::vector<uint8_t> edid(128, 0);
+	const uint8_t header[] = { 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00 };
+	memcpy(&edid[0], header, sizeof(header));
+	edid[18] = 1;
+	edid[19] = 4;
+
+	uint8_t *desc = &edid[54];
+	desc[3] = 0xfd;
+	desc[4] = (vfreq_max > 255? 0x02 : 0) | (vfreq_min > 255? 0x01 : 0);
+	desc[5] = vfreq_min > 255? vfreq_min - 255 : vfreq_min;
+	desc[6] = vfreq_max > 255? vfreq_max - 255 : vfreq_max;
+	desc[7] = 30;
+	desc[8] = 135;
+	desc[9] = 30;
+	desc[10] = 0x01;
+	desc[11] = 0x0a;
+	memset(&desc[12], 0x20, 6);
+
+	uint8_t sum = 0;
+	for (int i = 0; i < 127; i++)
+		sum += edid[i];
+	edid[127] = -sum;
+
+	return edid;
+}
+
+//============================================================
+//  parse_config
+//============================================================
+
+static bool parse_op(const char *key, const char *prefix, int *op)
+{
+	size_t length = strlen(prefix);
+	if (strncmp(key, prefix, length))
+		return false;
+
+	for (*op = 0; *op < FAKE_DRM_OPS; (*op)++)
+		if (!strcmp(key + length, op_names[*op]))
+			return true;
+
+	return false;
+}
+
+static bool parse_config(const char *config, fake_config *cfg)
+{
+	std::string options = config? config : "";
+	char *save = nullptr;
+
+	for (char *option = strtok_r(&options[0], ", \t\n", &save); option; option = strtok_r(nullptr, ", \t\n", &save))
+	{
+		char *value = strchr(option, '=');
+		if (!value)
+		{
+			fprintf(stderr, "fake_drm: option %s has no value\n", option);
+			return false;
+		}
+		*value++ = 0;
+
+		int op, number = atoi(value);
+		if (!strcmp(option, "cards")) cfg->cards = number;
+		else if (!strcmp(option, "connectors")) cfg->connectors = number;
+		else if (!strcmp(option, "connected")) cfg->connected = number;
+		else if (!strcmp(option, "user_modes")) cfg->user_modes = number;
+		else if (!strcmp(option, "atomic")) cfg->atomic = number;
+		else if (!strcmp(option, "dumb")) cfg->dumb = number;
+		else if (!strcmp(option, "vrr")) cfg->vrr = number;
+		else if (!strcmp(option, "max_clock")) cfg->max_clock = number;
+		else if (!strcmp(option, "seamless")) cfg->seamless = number;
+		else if (!strcmp(option, "edid"))
+		{
+			if (sscanf(value, "%d-%d", &cfg->edid_min, &cfg->edid_max) != 2)
+				cfg->edid_min = cfg->edid_max = 0;
+		}
+		else if (parse_op(option, "latency_", &op)) cfg->latency[op] = number;
+		else if (parse_op(option, "fail_", &op)) cfg->fail[op] = number;
+		else
+		{
+			fprintf(stderr, "fake_drm: unknown option %s\n", option);
+			return false;
+		}
+	}
+
+	if (cfg->cards < 0 || cfg->connectors < 1 || cfg->cards > 16)
+	{
+		fprintf(stderr, "fake_drm: bad device count\n");
+		return false;
+	}
+
+	return true;
+}
+
+//============================================================
+//  fake_configure
+//============================================================
+
+static void add_object(fake_card *card, fake_object *object, uint32_t type)
+{
+	object->id = card->next_id++;
+	object->type = type;
+}
+
+static int fake_configure(const char *config)
+{
+	fake_config cfg;
+	if (!parse_config(config, &cfg))
+	{
+		if (s_configured)
+			return -EINVAL;
+		cfg = fake_config();
+	}
+
+	for (auto &card : s_cards)
+		close(card.memfd);
+	for (auto node : s_device_nodes)
+		free(node);
+
+	s_cards.clear();
+	s_devices.clear();
+	s_device_nodes.clear();
+	memset(s_calls, 0, sizeof(s_calls));
+	s_modesets = s_seamless = 0;
+	s_config = cfg;
+	s_configured = true;
+
+	int connected = cfg.connected < 0? cfg.connectors : cfg.connected;
+	s_cards.resize(cfg.cards);
+	s_devices.resize(cfg.cards);
+
+	for (int c = 0; c < cfg.cards; c++)
+	{
+		fake_card *card = &s_cards[c];
+		char name[32];
+		snprintf(name, sizeof(name), "fake_drm-card%d", c);
+
+		struct stat st;
+		card->memfd = memfd_create(name, MFD_CLOEXEC);
+		if (card->memfd < 0 || fstat(card->memfd, &st))
+			return -errno;
+
+		card->dev = st.st_dev;
+		card->ino = st.st_ino;
+		fcntl(card->memfd, F_SETFL, fcntl(card->memfd, F_GETFL) | O_NONBLOCK);
+		snprintf(card->node, sizeof(card->node), "/proc/self/fd/%d", card->memfd);
+
+		// The console frame buffer, on screen for the connected outputs
+		const drmModeModeInfo *desktop = &default_modes[0];
+		drm_mode_create_dumb create = {};
+		create.width = desktop->hdisplay;
+		create.height = desktop->vdisplay;
+		create.bpp = 32;
+		if (create_dumb(card, &create))
+			return -errno;
+
+		card->console_handle = create.handle;
+		card->console_fb = card->next_id++;
+		card->fbs[card->console_fb] = { card->console_fb, create.width, create.height, create.pitch, 32, 24, create.handle };
+
+		card->crtcs.resize(cfg.connectors);
+		card->planes.resize(cfg.connectors);
+		card->connectors.resize(cfg.connectors);
+
+		for (int i = 0; i < cfg.connectors; i++)
+		{
+			fake_crtc *crtc = &card->crtcs[i];
+			fake_object *plane = &card->planes[i];
+			fake_connector *conn = &card->connectors[i];
+
+			add_object(card, crtc, DRM_MODE_OBJECT_CRTC);
+			add_object(card, plane, DRM_MODE_OBJECT_PLANE);
+			add_object(card, conn, DRM_MODE_OBJECT_CONNECTOR);
+			conn->encoder_id = card->next_id++;
+			plane->prop[PROP_TYPE] = DRM_PLANE_TYPE_PRIMARY;
+			conn->prop[PROP_VRR_CAPABLE] = cfg.vrr;
+
+			if (cfg.edid_min > 0 && cfg.edid_max > cfg.edid_min)
+			{
+				uint32_t blob_id = card->next_id++;
+				card->blobs[blob_id] = make_edid(cfg.edid_min, cfg.edid_max);
+				conn->prop[PROP_EDID] = blob_id;
+			}
+
+			if (i >= connected)
+				continue;
+
+			conn->connected = true;
+			conn->modes.assign(default_modes, default_modes + sizeof(default_modes) / sizeof(default_modes[0]));
+			conn->prop[PROP_CRTC_ID] = crtc->id;
+
+			crtc->mode = *desktop;
+			crtc->prop[PROP_ACTIVE] = 1;
+			plane->prop[PROP_FB_ID] = card->console_fb;
+			plane->prop[PROP_CRTC_ID] = crtc->id;
+			plane->prop[PROP_SRC_W] = uint64_t(desktop->hdisplay) << 16;
+			plane->prop[PROP_SRC_H] = uint64_t(desktop->vdisplay) << 16;
+			plane->prop[PROP_CRTC_W] = desktop->hdisplay;
+			plane->prop[PROP_CRTC_H] = desktop->vdisplay;
+		}
+
+		s_device_nodes.push_back(strdup(card->node));
+		s_device_nodes.resize(s_device_nodes.size() + DRM_NODE_MAX - 1, nullptr);
+	}
+
+	for (int c = 0; c < cfg.cards; c++)
+	{
+		drmDevice *device = &s_devices[c];
+		memset(device, 0, sizeof(drmDevice));
+		device->available_nodes = 1 << DRM_NODE_PRIMARY;
+		device->nodes = &s_device_nodes[c * DRM_NODE_MAX];
+	}
+
+	return 0;
+}
+
+//============================================================
+//  fake_drm_configure
+//============================================================
+
+int fake_drm_configure(const char *config)
+{
+	// A bad configuration leaves the device as it was
+	fake_config cfg;
+	if (!parse_config(config, &cfg))
+		return -EINVAL;
+
+	return fake_configure(config);
+}
+
+//============================================================
+//  fake_drm_get_state
+//============================================================
+
+void fake_drm_get_state(fake_drm_state *state)
+{
+	if (!s_configured)
+		fake_configure(getenv("FAKE_DRM"));
+
+	*state = {};
+	memcpy(state->calls, s_calls, sizeof(s_calls));
+	state->modesets = s_modesets;
+	state->seamless = s_seamless;
+
+	if (s_cards.empty())
+		return;
+
+	fake_card *card = &s_cards[0];
+	state->dumb_buffers = card->dumbs.size() - 1;
+	state->framebuffers = card->fbs.size() - 1;
+	state->console_fb = card->console_fb;
+
+	state->blobs = card->blobs.size();
+	for (auto &conn : card->connectors)
+		if (conn.prop[PROP_EDID])
+			state->blobs--;
+
+	for (auto &conn : card->connectors)
+	{
+		if (!conn.connected)
+			continue;
+
+		state->modes = conn.modes.size();
+		int c = find_crtc(card, conn.prop[PROP_CRTC_ID]);
+		if (c != -1)
+		{
+			state->crtc_active = card->crtcs[c].prop[PROP_ACTIVE];
+			state->vrr_enabled = card->crtcs[c].prop[PROP_VRR_ENABLED];
+			state->crtc_mode = card->crtcs[c].mode;
+			state->crtc_fb = card->planes[c].prop[PROP_FB_ID];
+		}
+		break;
+	}
+}
+
+//============================================================
+//  libdrm: devices and master
+//============================================================
+
+int drmGetDevices2(uint32_t, drmDevicePtr devices[], int max_devices)
+{
+	if (!s_configured)
+		fake_configure(getenv("FAKE_DRM"));
+
+	if (!devices)
+		return s_devices.size();
+
+	int count = 0;
+	for (; count < max_devices && count < (int)s_devices.size(); count++)
+		devices[count] = &s_devices[count];
+
+	return count;
+}
+
+drmVersionPtr drmGetVersion(int fd)
+{
+	if (!get_card(fd))
+		return nullptr;
+
+	drmVersion *version = (drmVersion *)calloc(1, sizeof(drmVersion));
+	version->version_major = 1;
+	version->name = strdup("fake_drm");
+	version->name_len = strlen(version->name);
+	version->date = strdup("20211010");
+	version->date_len = strlen(version->date);
+	version->desc = strdup("switchres test device");
+	version->desc_len = strlen(version->desc);
+	return version;
+}
+
+void drmFreeVersion(drmVersionPtr version)
+{
+	if (!version)
+		return;
+
+	free(version->name);
+	free(version->date);
+	free(version->desc);
+	free(version);
+}
+
+int drmIsMaster(int fd)
+{
+	fake_card *card = get_card(fd);
+	return card && is_master(*card, fd);
+}
+
+int drmSetMaster(int fd)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return -1;
+
+	if (has_master(*card) && card->master_fd != fd)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	card->master_fd = fd;
+	return 0;
+}
+
+int drmDropMaster(int fd)
+{
+	fake_card *card = get_card(fd);
+	if (!card || !is_master(*card, fd))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	card->master_fd = -1;
+	return 0;
+}
+
+int drmGetCap(int fd, uint64_t capability, uint64_t *value)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return -1;
+
+	if (capability != DRM_CAP_DUMB_BUFFER)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	*value = s_config.dumb;
+	return 0;
+}
+
+int drmSetClientCap(int fd, uint64_t capability, uint64_t value)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return -1;
+
+	if (capability == DRM_CLIENT_CAP_UNIVERSAL_PLANES)
+		card->universal_planes = value;
+	else if (capability == DRM_CLIENT_CAP_ATOMIC && s_config.atomic)
+		card->atomic_client = card->universal_planes = value;
+	else
+	{
+		errno = EOPNOTSUPP;
+		return -1;
+	}
+
+	return 0;
+}
+
+int drmPrimeHandleToFD(int, uint32_t, uint32_t, int *)
+{
+	errno = ENOSYS;
+	return -1;
+}
+
+//============================================================
+//  libdrm: dumb buffer ioctls
+//============================================================
+
+int drmIoctl(int fd, unsigned long request, void *arg)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return -1;
+
+	int ret = -EINVAL;
+	if (request == DRM_IOCTL_MODE_CREATE_DUMB && s_config.dumb)
+		ret = run_op(FAKE_DRM_DUMB)? create_dumb(card, (drm_mode_create_dumb *)arg) : -ENOMEM;
+
+	else if (request == DRM_IOCTL_MODE_MAP_DUMB)
+	{
+		drm_mode_map_dumb *map = (drm_mode_map_dumb *)arg;
+		auto dumb = card->dumbs.find(map->handle);
+		ret = dumb == card->dumbs.end()? -ENOENT : 0;
+		if (!ret)
+			map->offset = dumb->second.offset;
+	}
+
+	else if (request == DRM_IOCTL_MODE_DESTROY_DUMB)
+	{
+		drm_mode_destroy_dumb *destroy = (drm_mode_destroy_dumb *)arg;
+		auto dumb = card->dumbs.find(destroy->handle);
+		ret = dumb == card->dumbs.end()? -ENOENT : 0;
+		if (!ret)
+		{
+			// Give the memory back, mappings still alive read zeros from now on
+			fallocate(card->memfd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, dumb->second.offset, dumb->second.create.size);
+			card->dumbs.erase(dumb);
+		}
+	}
+
+	if (ret)
+	{
+		errno = -ret;
+		return -1;
+	}
+	return 0;
+}
+
+//============================================================
+//  libdrm: resources
+//============================================================
+
+drmModeResPtr drmModeGetResources(int fd)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return nullptr;
+
+	drmModeRes *res = (drmModeRes *)calloc(1, sizeof(drmModeRes));
+	res->count_crtcs = card->crtcs.size();
+	res->count_connectors = res->count_encoders = card->connectors.size();
+	res->crtcs = (uint32_t *)calloc(res->count_crtcs + 1, sizeof(uint32_t));
+	res->connectors = (uint32_t *)calloc(res->count_connectors + 1, sizeof(uint32_t));
+	res->encoders = (uint32_t *)calloc(res->count_encoders + 1, sizeof(uint32_t));
+
+	for (int i = 0; i < res->count_crtcs; i++)
+		res->crtcs[i] = card->crtcs[i].id;
+
+	for (int i = 0; i < res->count_connectors; i++)
+	{
+		res->connectors[i] = card->connectors[i].id;
+		res->encoders[i] = card->connectors[i].encoder_id;
+	}
+
+	res->min_width = res->min_height = 1;
+	res->max_width = res->max_height = 16384;
+	return res;
+}
+
+void drmModeFreeResources(drmModeResPtr res)
+{
+	if (!res)
+		return;
+
+	free(res->fbs);
+	free(res->crtcs);
+	free(res->connectors);
+	free(res->encoders);
+	free(res);
+}
+
+//============================================================
+//  libdrm: connectors and encoders
+//============================================================
+
+static drmModeConnector *get_connector(int fd, uint32_t connector_id, fake_drm_op op)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return nullptr;
+
+	fake_connector *conn = find_connector(card, connector_id);
+	if (!conn)
+	{
+		errno = ENOENT;
+		return nullptr;
+	}
+
+	if (!run_op(op))
+	{
+		errno = EIO;
+		return nullptr;
+	}
+
+	drmModeConnector *p_conn = (drmModeConnector *)calloc(1, sizeof(drmModeConnector));
+	p_conn->connector_id = conn->id;
+	p_conn->encoder_id = conn->connected? conn->encoder_id : 0;
+	p_conn->connector_type = DRM_MODE_CONNECTOR_VGA;
+	p_conn->connector_type_id = conn - &card->connectors[0] + 1;
+	p_conn->connection = conn->connected? DRM_MODE_CONNECTED : DRM_MODE_DISCONNECTED;
+	p_conn->mmWidth = 400;
+	p_conn->mmHeight = 300;
+	p_conn->subpixel = DRM_MODE_SUBPIXEL_UNKNOWN;
+
+	p_conn->count_modes = conn->modes.size();
+	p_conn->modes = (drmModeModeInfo *)calloc(p_conn->count_modes + 1, sizeof(drmModeModeInfo));
+	if (p_conn->count_modes)
+		memcpy(p_conn->modes, &conn->modes[0], p_conn->count_modes * sizeof(drmModeModeInfo));
+
+	p_conn->props = (uint32_t *)calloc(connector_props.size(), sizeof(uint32_t));
+	p_conn->prop_values = (uint64_t *)calloc(connector_props.size(), sizeof(uint64_t));
+	for (int prop : connector_props)
+	{
+		if (atomic_only(prop) && !card->atomic_client)
+			continue;
+		p_conn->props[p_conn->count_props] = prop;
+		p_conn->prop_values[p_conn->count_props++] = conn->prop[prop];
+	}
+
+	p_conn->count_encoders = 1;
+	p_conn->encoders = (uint32_t *)calloc(1, sizeof(uint32_t));
+	p_conn->encoders[0] = conn->encoder_id;
+	return p_conn;
+}
+
+drmModeConnectorPtr drmModeGetConnector(int fd, uint32_t connector_id)
+{
+	return get_connector(fd, connector_id, FAKE_DRM_PROBE);
+}
+
+drmModeConnectorPtr drmModeGetConnectorCurrent(int fd, uint32_t connector_id)
+{
+	return get_connector(fd, connector_id, FAKE_DRM_CONNECTOR);
+}
+
+void drmModeFreeConnector(drmModeConnectorPtr conn)
+{
+	if (!conn)
+		return;
+
+	free(conn->modes);
+	free(conn->props);
+	free(conn->prop_values);
+	free(conn->encoders);
+	free(conn);
+}
+
+drmModeEncoderPtr drmModeGetEncoder(int fd, uint32_t encoder_id)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return nullptr;
+
+	for (auto &conn : card->connectors)
+	{
+		if (conn.encoder_id != encoder_id)
+			continue;
+
+		drmModeEncoder *encoder = (drmModeEncoder *)calloc(1, sizeof(drmModeEncoder));
+		encoder->encoder_id = encoder_id;
+		encoder->encoder_type = 1;
+		encoder->crtc_id = conn.prop[PROP_CRTC_ID];
+		encoder->possible_crtcs = (1 << card->crtcs.size()) - 1;
+		return encoder;
+	}
+
+	errno = ENOENT;
+	return nullptr;
+}
+
+void drmModeFreeEncoder(drmModeEncoderPtr encoder)
+{
+	free(encoder);
+}
+
+//============================================================
+//  libdrm: user modes
+//============================================================
+
+int drmModeAttachMode(int fd, uint32_t connector_id, drmModeModeInfoPtr mode_info)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return -EBADF;
+
+	if (!is_master(*card, fd))
+		return -EACCES;
+
+	// A stock kernel takes anything without a word, a patched one checks the connector
+	fake_connector *conn = find_connector(card, connector_id);
+	if (!s_config.user_modes)
+		return 0;
+
+	if (!conn)
+		return -ENOENT;
+
+	if (!run_op(FAKE_DRM_ATTACH))
+		return -EINVAL;
+
+	for (auto &mode : conn->modes)
+		if (same_timings(&mode, mode_info) && !strcmp(mode.name, mode_info->name))
+			return 0;
+
+	conn->modes.push_back(*mode_info);
+	return 0;
+}
+
+int drmModeDetachMode(int fd, uint32_t connector_id, drmModeModeInfoPtr mode_info)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return -EBADF;
+
+	if (!is_master(*card, fd))
+		return -EACCES;
+
+	fake_connector *conn = find_connector(card, connector_id);
+	if (!conn)
+		return -ENOENT;
+
+	if (!run_op(FAKE_DRM_DETACH))
+		return -EINVAL;
+
+	for (size_t i = 0; i < conn->modes.size(); i++)
+		if (same_timings(&conn->modes[i], mode_info))
+		{
+			conn->modes.erase(conn->modes.begin() + i);
+			return 0;
+		}
+
+	return -EINVAL;
+}
+
+//============================================================
+//  libdrm: frame buffers
+//============================================================
+
+int drmModeAddFB(int fd, uint32_t width, uint32_t height, uint8_t depth, uint8_t bpp, uint32_t pitch, uint32_t bo_handle, uint32_t *buf_id)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return -EBADF;
+
+	if (!run_op(FAKE_DRM_ADDFB))
+		return -EINVAL;
+
+	auto dumb = card->dumbs.find(bo_handle);
+	if (dumb == card->dumbs.end())
+		return -ENOENT;
+
+	if (!width || !height || pitch < width * ((bpp + 7) / 8) || uint64_t(pitch) * height > dumb->second.create.size)
+		return -EINVAL;
+
+	*buf_id = card->next_id++;
+	card->fbs[*buf_id] = { *buf_id, width, height, pitch, bpp, depth, bo_handle };
+	return 0;
+}
+
+int drmModeRmFB(int fd, uint32_t buffer_id)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return -EBADF;
+
+	if (!card->fbs.erase(buffer_id))
+		return -ENOENT;
+
+	// The kernel turns off whatever still shows it
+	for (size_t i = 0; i < card->planes.size(); i++)
+		if (card->planes[i].prop[PROP_FB_ID] == buffer_id)
+		{
+			card->planes[i].prop[PROP_FB_ID] = 0;
+			card->crtcs[i].prop[PROP_ACTIVE] = 0;
+		}
+
+	return 0;
+}
+
+drmModeFBPtr drmModeGetFB(int fd, uint32_t buffer_id)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return nullptr;
+
+	if (!run_op(FAKE_DRM_GETFB))
+	{
+		errno = EINVAL;
+		return nullptr;
+	}
+
+	auto fb = card->fbs.find(buffer_id);
+	if (fb == card->fbs.end())
+	{
+		errno = ENOENT;
+		return nullptr;
+	}
+
+	drmModeFB *p_fb = (drmModeFB *)calloc(1, sizeof(drmModeFB));
+	*p_fb = fb->second;
+	return p_fb;
+}
+
+void drmModeFreeFB(drmModeFBPtr fb)
+{
+	free(fb);
+}
+
+//============================================================
+//  libdrm: crtcs and planes
+//============================================================
+
+drmModeCrtcPtr drmModeGetCrtc(int fd, uint32_t crtc_id)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return nullptr;
+
+	int c = find_crtc(card, crtc_id);
+	if (c == -1)
+	{
+		errno = ENOENT;
+		return nullptr;
+	}
+
+	fake_crtc *crtc = &card->crtcs[c];
+	fake_object *plane = &card->planes[c];
+	drmModeCrtc *p_crtc = (drmModeCrtc *)calloc(1, sizeof(drmModeCrtc));
+	p_crtc->crtc_id = crtc->id;
+	p_crtc->buffer_id = plane->prop[PROP_FB_ID];
+	p_crtc->x = plane->prop[PROP_SRC_X] >> 16;
+	p_crtc->y = plane->prop[PROP_SRC_Y] >> 16;
+	p_crtc->mode_valid = crtc->prop[PROP_ACTIVE];
+	if (p_crtc->mode_valid)
+	{
+		p_crtc->mode = crtc->mode;
+		p_crtc->width = crtc->mode.hdisplay;
+		p_crtc->height = crtc->mode.vdisplay;
+	}
+	p_crtc->gamma_size = 256;
+	return p_crtc;
+}
+
+void drmModeFreeCrtc(drmModeCrtcPtr crtc)
+{
+	free(crtc);
+}
+
+static bool check_mode(fake_card *card, const drmModeModeInfo *mode, uint32_t fb_id, uint32_t x, uint32_t y, int *ret)
+{
+	auto fb = card->fbs.find(fb_id);
+	if (!mode->hdisplay || !mode->vdisplay || fb == card->fbs.end() || (s_config.max_clock && mode->clock > s_config.max_clock))
+		*ret = -EINVAL;
+	else if (x + mode->hdisplay > fb->second.width || y + mode->vdisplay > fb->second.height)
+		*ret = -ENOSPC;
+	else
+		*ret = 0;
+
+	return *ret == 0;
+}
+
+int drmModeSetCrtc(int fd, uint32_t crtc_id, uint32_t buffer_id, uint32_t x, uint32_t y, uint32_t *connectors, int count, drmModeModeInfoPtr mode)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return -EBADF;
+
+	if (!is_master(*card, fd))
+		return -EACCES;
+
+	int c = find_crtc(card, crtc_id);
+	if (c == -1)
+		return -ENOENT;
+
+	if (!run_op(FAKE_DRM_SETCRTC))
+		return -EINVAL;
+
+	fake_crtc *crtc = &card->crtcs[c];
+	fake_object *plane = &card->planes[c];
+
+	if (!mode)
+	{
+		crtc->prop[PROP_ACTIVE] = 0;
+		plane->prop[PROP_FB_ID] = 0;
+		return 0;
+	}
+
+	int ret;
+	if (!check_mode(card, mode, buffer_id, x, y, &ret))
+		return ret;
+
+	for (int i = 0; i < count; i++)
+	{
+		fake_connector *conn = find_connector(card, connectors[i]);
+		if (!conn)
+			return -ENOENT;
+		conn->prop[PROP_CRTC_ID] = crtc_id;
+	}
+
+	// The legacy interface always does a full modeset for new timings
+	if (!crtc->prop[PROP_ACTIVE] || !same_timings(&crtc->mode, mode))
+		s_modesets++;
+
+	crtc->mode = *mode;
+	crtc->prop[PROP_ACTIVE] = 1;
+	crtc->prop[PROP_MODE_ID] = 0;
+	plane->prop[PROP_FB_ID] = buffer_id;
+	plane->prop[PROP_CRTC_ID] = crtc_id;
+	plane->prop[PROP_SRC_X] = uint64_t(x) << 16;
+	plane->prop[PROP_SRC_Y] = uint64_t(y) << 16;
+	plane->prop[PROP_SRC_W] = uint64_t(mode->hdisplay) << 16;
+	plane->prop[PROP_SRC_H] = uint64_t(mode->vdisplay) << 16;
+	plane->prop[PROP_CRTC_W] = mode->hdisplay;
+	plane->prop[PROP_CRTC_H] = mode->vdisplay;
+	return 0;
+}
+
+drmModePlaneResPtr drmModeGetPlaneResources(int fd)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return nullptr;
+
+	// There are only primary planes here, which need the universal planes cap
+	drmModePlaneRes *res = (drmModePlaneRes *)calloc(1, sizeof(drmModePlaneRes));
+	res->count_planes = card->universal_planes? card->planes.size() : 0;
+	res->planes = (uint32_t *)calloc(res->count_planes + 1, sizeof(uint32_t));
+	for (uint32_t i = 0; i < res->count_planes; i++)
+		res->planes[i] = card->planes[i].id;
+
+	return res;
+}
+
+void drmModeFreePlaneResources(drmModePlaneResPtr res)
+{
+	if (!res)
+		return;
+
+	free(res->planes);
+	free(res);
+}
+
+drmModePlanePtr drmModeGetPlane(int fd, uint32_t plane_id)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return nullptr;
+
+	for (size_t i = 0; i < card->planes.size(); i++)
+	{
+		if (card->planes[i].id != plane_id)
+			continue;
+
+		drmModePlane *plane = (drmModePlane *)calloc(1, sizeof(drmModePlane));
+		plane->plane_id = plane_id;
+		plane->crtc_id = card->planes[i].prop[PROP_CRTC_ID];
+		plane->fb_id = card->planes[i].prop[PROP_FB_ID];
+		plane->possible_crtcs = 1 << i;
+		plane->gamma_size = 256;
+		return plane;
+	}
+
+	errno = ENOENT;
+	return nullptr;
+}
+
+void drmModeFreePlane(drmModePlanePtr plane)
+{
+	if (!plane)
+		return;
+
+	free(plane->formats);
+	free(plane);
+}
+
+//============================================================
+//  libdrm: properties and blobs
+//============================================================
+
+drmModeObjectPropertiesPtr drmModeObjectGetProperties(int fd, uint32_t object_id, uint32_t object_type)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return nullptr;
+
+	fake_object *object = find_object(card, object_id);
+	if (!object || (object_type && object->type != object_type))
+	{
+		errno = ENOENT;
+		return nullptr;
+	}
+
+	const std::vector<int> &props = object_props(object->type);
+	drmModeObjectProperties *p_props = (drmModeObjectProperties *)calloc(1, sizeof(drmModeObjectProperties));
+	p_props->props = (uint32_t *)calloc(props.size(), sizeof(uint32_t));
+	p_props->prop_values = (uint64_t *)calloc(props.size(), sizeof(uint64_t));
+
+	for (int prop : props)
+	{
+		if (atomic_only(prop) && !card->atomic_client)
+			continue;
+		p_props->props[p_props->count_props] = prop;
+		p_props->prop_values[p_props->count_props++] = object->prop[prop];
+	}
+
+	return p_props;
+}
+
+void drmModeFreeObjectProperties(drmModeObjectPropertiesPtr props)
+{
+	if (!props)
+		return;
+
+	free(props->props);
+	free(props->prop_values);
+	free(props);
+}
+
+drmModePropertyPtr drmModeGetProperty(int fd, uint32_t property_id)
+{
+	if (!get_card(fd))
+		return nullptr;
+
+	if (property_id <= PROP_NONE || property_id >= PROP_COUNT)
+	{
+		errno = ENOENT;
+		return nullptr;
+	}
+
+	drmModePropertyRes *prop = (drmModePropertyRes *)calloc(1, sizeof(drmModePropertyRes));
+	prop->prop_id = property_id;
+	prop->flags = property_id == PROP_EDID || property_id == PROP_MODE_ID? DRM_MODE_PROP_BLOB : DRM_MODE_PROP_RANGE;
+	strncpy(prop->name, prop_names[property_id], DRM_PROP_NAME_LEN - 1);
+	return prop;
+}
+
+void drmModeFreeProperty(drmModePropertyPtr prop)
+{
+	if (!prop)
+		return;
+
+	free(prop->values);
+	free(prop->enums);
+	free(prop->blob_ids);
+	free(prop);
+}
+
+int drmModeCreatePropertyBlob(int fd, const void *data, size_t size, uint32_t *id)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return -EBADF;
+
+	if (!data || !size)
+		return -EINVAL;
+
+	*id = card->next_id++;
+	card->blobs[*id].assign((const uint8_t *)data, (const uint8_t *)data + size);
+	return 0;
+}
+
+int drmModeDestroyPropertyBlob(int fd, uint32_t id)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return -EBADF;
+
+	return card->blobs.erase(id)? 0 : -ENOENT;
+}
+
+drmModePropertyBlobPtr drmModeGetPropertyBlob(int fd, uint32_t blob_id)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return nullptr;
+
+	auto blob = card->blobs.find(blob_id);
+	if (blob == card->blobs.end())
+	{
+		errno = ENOENT;
+		return nullptr;
+	}
+
+	drmModePropertyBlobRes *p_blob = (drmModePropertyBlobRes *)calloc(1, sizeof(drmModePropertyBlobRes) + blob->second.size());
+	p_blob->id = blob_id;
+	p_blob->length = blob->second.size();
+	p_blob->data = p_blob + 1;
+	memcpy(p_blob->data, &blob->second[0], blob->second.size());
+	return p_blob;
+}
+
+void drmModeFreePropertyBlob(drmModePropertyBlobPtr blob)
+{
+	free(blob);
+}
+
+//============================================================
+//  libdrm: atomic modesetting
+//============================================================
+
+drmModeAtomicReqPtr drmModeAtomicAlloc(void)
+{
+	return new _drmModeAtomicReq();
+}
+
+void drmModeAtomicFree(drmModeAtomicReqPtr req)
+{
+	delete req;
+}
+
+int drmModeAtomicAddProperty(drmModeAtomicReqPtr req, uint32_t object_id, uint32_t property_id, uint64_t value)
+{
+	if (!req)
+		return -EINVAL;
+
+	req->items.push_back({ object_id, property_id, value });
+	return req->items.size();
+}
+
+int drmModeAtomicCommit(int fd, drmModeAtomicReqPtr req, uint32_t flags, void *)
+{
+	fake_card *card = get_card(fd);
+	if (!card)
+		return -EBADF;
+
+	if (!is_master(*card, fd))
+		return -EACCES;
+
+	if (!req || !card->atomic_client)
+		return -EINVAL;
+
+	if (!run_op(FAKE_DRM_COMMIT))
+		return -EINVAL;
+
+	// Build the new state aside, it's only kept if the whole request is valid
+	fake_card next = *card;
+	for (auto &item : req->items)
+	{
+		fake_object *object = find_object(&next, item.object_id);
+		if (!object)
+			return -ENOENT;
+
+		if (!has_prop(object, item.property_id) || immutable(item.property_id))
+			return -EINVAL;
+
+		if (item.property_id == PROP_MODE_ID)
+		{
+			drmModeModeInfo mode = {};
+			auto blob = next.blobs.find(item.value);
+			if (item.value && (blob == next.blobs.end() || blob->second.size() != sizeof(drmModeModeInfo)))
+				return -EINVAL;
+			if (item.value)
+				memcpy(&mode, &blob->second[0], sizeof(mode));
+			((fake_crtc *)object)->mode = mode;
+		}
+
+		object->prop[item.property_id] = item.value;
+	}
+
+	std::vector<bool> modeset(next.crtcs.size()), retimed(next.crtcs.size());
+	for (size_t c = 0; c < next.crtcs.size(); c++)
+	{
+		fake_crtc *crtc = &next.crtcs[c], *old_crtc = &card->crtcs[c];
+		fake_object *plane = &next.planes[c];
+
+		int ret;
+		if (crtc->prop[PROP_ACTIVE] && !check_mode(&next, &crtc->mode, plane->prop[PROP_FB_ID], plane->prop[PROP_SRC_X] >> 16, plane->prop[PROP_SRC_Y] >> 16, &ret))
+			return ret;
+
+		bool active_changed = crtc->prop[PROP_ACTIVE] != old_crtc->prop[PROP_ACTIVE];
+		retimed[c] = crtc->prop[PROP_ACTIVE] && !same_timings(&crtc->mode, &old_crtc->mode);
+		modeset[c] = active_changed || (retimed[c] && !(s_config.seamless && seamless_change(&crtc->mode, &old_crtc->mode)));
+
+		for (size_t i = 0; i < next.connectors.size(); i++)
+			if (next.connectors[i].prop[PROP_CRTC_ID] != card->connectors[i].prop[PROP_CRTC_ID] &&
+				(next.connectors[i].prop[PROP_CRTC_ID] == crtc->id || card->connectors[i].prop[PROP_CRTC_ID] == crtc->id))
+				modeset[c] = true;
+
+		if (modeset[c] && !(flags & DRM_MODE_ATOMIC_ALLOW_MODESET))
+			return -EINVAL;
+	}
+
+	if (flags & DRM_MODE_ATOMIC_TEST_ONLY)
+		return 0;
+
+	for (size_t c = 0; c < next.crtcs.size(); c++)
+	{
+		if (modeset[c])
+			s_modesets++;
+		else if (retimed[c])
+			s_seamless++;
+	}
+
+	*card = next;
+	return 0;
+}
@@ -0,0 +1,84 @@
+/**************************************************************
+
+   fake_drm.h - Stand-in libdrm for the DRM/KMS backend
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#ifndef __FAKE_DRM__
+#define __FAKE_DRM__
+
+#include <stdint.h>
+#include <xf86drmMode.h>
+
+// tests/libdrm.so is built with the libdrm.so soname, so once it's loaded, the
+// dlopen("libdrm.so") of the DRM/KMS backend gets it instead of the real one.
+// Run any other binary on it with LD_LIBRARY_PATH=tests.
+//
+// The device is set up from FAKE_DRM in the environment, or with fake_drm_configure,
+// a list of key=value separated by commas or spaces:
+//   cards=1, connectors=1, connected=<connectors>   outputs, one crtc and primary plane each
+//   user_modes=1       drmModeAttachMode adds modes to the connector (patched kernel)
+//   atomic=1           DRM_CLIENT_CAP_ATOMIC is supported
+//   dumb=1             dumb buffers are supported
+//   vrr=0              connectors are vrr_capable
+//   edid=<min>-<max>   connectors have an EDID with that refresh range
+//   max_clock=0        modes above that pixel clock (kHz) are rejected, 0 = no limit
+//   seamless=0         timing changes that keep the horizontal timings and active
+//                      size don't need a modeset, like variable refresh drivers
+//   latency_<op>=<us>  time taken by each call of an operation
+//   fail_<op>=<n>      the nth call of an operation fails
+// with <op> one of the fake_drm_op names below. Objects live in a memfd per card, so
+// its node can be opened and the dumb buffers mapped. Not thread safe.
+
+typedef enum fake_drm_op
+{
+	FAKE_DRM_CONNECTOR,   // "connector", drmModeGetConnectorCurrent
+	FAKE_DRM_PROBE,       // "probe", drmModeGetConnector
+	FAKE_DRM_ATTACH,      // "attach", drmModeAttachMode
+	FAKE_DRM_DETACH,      // "detach", drmModeDetachMode
+	FAKE_DRM_SETCRTC,     // "setcrtc", drmModeSetCrtc
+	FAKE_DRM_COMMIT,      // "commit", drmModeAtomicCommit
+	FAKE_DRM_DUMB,        // "dumb", DRM_IOCTL_MODE_CREATE_DUMB
+	FAKE_DRM_ADDFB,       // "addfb", drmModeAddFB
+	FAKE_DRM_GETFB,       // "getfb", drmModeGetFB
+	FAKE_DRM_OPS
+} fake_drm_op;
+
+// State of the first connected connector of the first card, and of its crtc
+typedef struct fake_drm_state
+{
+	unsigned int calls[FAKE_DRM_OPS];
+	unsigned int modesets;
+	unsigned int seamless;    // timing changes done without a modeset
+	int dumb_buffers;
+	int framebuffers;         // not counting the console one
+	int blobs;                // created by the client
+	int modes;
+	int crtc_active;
+	int vrr_enabled;
+	uint32_t crtc_fb;
+	uint32_t console_fb;
+	drmModeModeInfo crtc_mode;
+} fake_drm_state;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Resets the device with a new configuration, returns 0 or -EINVAL for a bad one
+int fake_drm_configure(const char *config);
+void fake_drm_get_state(fake_drm_state *state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
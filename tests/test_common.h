@@ -0,0 +1,103 @@
+/**************************************************************
+
+   test_common.h - Checks and corpus shared by the tests
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#ifndef __TEST_COMMON__
+#define __TEST_COMMON__
+
+#include <cstdarg>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Only the first failures are printed, the rest are just counted
+#define MAX_PRINTED_FAILURES 10
+
+static uint64_t checks = 0;
+static uint64_t failures = 0;
+
+// Counts a failure, returns true when it must be printed
+static inline bool report_failure()
+{
+	return failures++ < MAX_PRINTED_FAILURES;
+}
+
+// Counts a check, a failed one is printed as "<label>: <message>"
+static inline void check(const char *label, bool passed, const char *format, ...) __attribute__((format(printf, 3, 4)));
+static inline void check(const char *label, bool passed, const char *format, ...)
+{
+	checks++;
+	if (passed || !report_failure())
+		return;
+
+	va_list args;
+	va_start(args, format);
+	printf("%s: ", label);
+	vprintf(format, args);
+	printf("\n");
+	va_end(args);
+}
+
+//============================================================
+//  load_corpus
+//============================================================
+
+// One line of tests/bench_corpus.txt: <width> <height> <refresh>[i] [r]
+typedef struct corpus_request
+{
+	int width;
+	int height;
+	double refresh;
+	int interlace;
+	int rotate;
+} corpus_request;
+
+static inline bool load_corpus(const char *file_name, std::vector<corpus_request> &requests)
+{
+	std::ifstream corpus(file_name);
+	if (!corpus.is_open())
+	{
+		printf("Error: can't open %s\n", file_name);
+		return false;
+	}
+
+	std::string line;
+	while (getline(corpus, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		std::istringstream fields(line);
+		std::string refresh, flag;
+		corpus_request request = {};
+
+		if (!(fields >> request.width >> request.height >> refresh))
+			continue;
+
+		request.refresh = atof(refresh.c_str());
+		request.interlace = refresh.back() == 'i';
+		while (fields >> flag)
+			if (flag == "r")
+				request.rotate = 1;
+
+		requests.push_back(request);
+	}
+
+	return requests.size() > 0;
+}
+
+#endif
@@ -0,0 +1,502 @@
+/**************************************************************
+
+   test_drmkms.cpp - DRM/KMS backend on the stand-in libdrm
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+#include <dlfcn.h>
+#include "../custom_video_drmkms.h"
+#include "../log.h"
+#include "../switchres_defines.h"
+#include "fake_drm.h"
+#include "test_common.h"
+
+using namespace std;
+
+static __typeof__(fake_drm_configure) *p_fake_drm_configure;
+static __typeof__(fake_drm_get_state) *p_fake_drm_get_state;
+
+static fake_drm_state get_state()
+{
+	fake_drm_state state;
+	p_fake_drm_get_state(&state);
+	return state;
+}
+
+//============================================================
+//  make_mode
+//============================================================
+
+static modeline make_mode(int width, int height, double vfreq, int type = MODE_ADD)
+{
+	modeline mode = {};
+	mode.type = type;
+	mode.hactive = mode.width = width;
+	mode.hbegin = width + 16;
+	mode.hend = width + 48;
+	mode.htotal = width + 96;
+	mode.vactive = mode.height = height;
+	mode.vbegin = height + 3;
+	mode.vend = height + 6;
+	mode.vtotal = height + 22;
+	mode.pclock = uint64_t(mode.htotal * mode.vtotal * vfreq / 1000 + 0.5) * 1000;
+	mode.hfreq = double(mode.pclock) / mode.htotal;
+	mode.vfreq = mode.hfreq / mode.vtotal;
+	mode.refresh = int(mode.vfreq);
+	return mode;
+}
+
+// Same horizontal timings and pixel clock, taller vertical total
+static modeline retime_mode(const modeline *mode, int lines)
+{
+	modeline retimed = *mode;
+	retimed.vtotal += lines;
+	retimed.vfreq = retimed.hfreq / retimed.vtotal;
+	return retimed;
+}
+
+//============================================================
+//  make_backend
+//============================================================
+
+static drmkms_timing *make_backend(const char *label, const char *config, bool atomic, const char *vrr = "0")
+{
+	if (p_fake_drm_configure(config))
+	{
+		check(label, false, "bad stand-in configuration %s", config);
+		return nullptr;
+	}
+
+	custom_video_settings vs = {};
+	vs.kms_fb_pool_size = 64;
+	vs.kms_atomic = atomic;
+	snprintf(vs.kms_vrr, sizeof(vs.kms_vrr), "%s", vrr);
+
+	char device_name[] = "auto";
+	drmkms_timing *video = new drmkms_timing(device_name, &vs);
+	if (!video->init())
+	{
+		check(label, false, "init failed with %s", config);
+		delete video;
+		return nullptr;
+	}
+
+	return video;
+}
+
+// Nothing of ours is left on the device once the backend is gone
+static void release_backend(const char *label, drmkms_timing *video)
+{
+	delete video;
+
+	fake_drm_state state = get_state();
+	check(label, state.dumb_buffers == 0 && state.framebuffers == 0 && state.blobs == 0, "leaked %d dumb buffers, %d frame buffers, %d blobs",
+		state.dumb_buffers, state.framebuffers, state.blobs);
+}
+
+//============================================================
+//  test_legacy
+//============================================================
+
+static void test_legacy()
+{
+	const char *label = "legacy";
+	drmkms_timing *video = make_backend(label, "atomic=0", false);
+	if (!video)
+		return;
+
+	modeline desktop = make_mode(1024, 768, 60, MODE_DESKTOP);
+	modeline a = make_mode(320, 240, 60), b = retime_mode(&a, 10), c = make_mode(640, 480, 60);
+	fake_drm_state start = get_state(), state;
+
+	check(label, video->caps() & CUSTOM_VIDEO_CAPS_ADD, "user modes not detected");
+	check(label, video->add_mode(&a) && video->add_mode(&c) && get_state().modes == start.modes + 2, "add_mode");
+
+	vector<modeline> modes;
+	check(label, video->get_timings(modes) && (int)modes.size() == start.modes + 2, "get_timings");
+
+	video->set_timing(&a);
+	state = get_state();
+	check(label, state.crtc_mode.hdisplay == 320 && state.crtc_fb != state.console_fb && state.dumb_buffers == 1, "set_timing to 320x240");
+
+	video->set_timing(&c);
+	video->set_timing(&a);
+	state = get_state();
+	check(label, state.crtc_mode.hdisplay == 320 && state.dumb_buffers == 2 && state.calls[FAKE_DRM_DUMB] == 2, "frame buffers not pooled");
+	check(label, state.calls[FAKE_DRM_GETFB] == start.calls[FAKE_DRM_GETFB] && state.calls[FAKE_DRM_SETCRTC] == start.calls[FAKE_DRM_SETCRTC] + 3,
+		"%u desktop frame buffer reads, %u crtc calls for 3 switches", state.calls[FAKE_DRM_GETFB] - start.calls[FAKE_DRM_GETFB], state.calls[FAKE_DRM_SETCRTC] - start.calls[FAKE_DRM_SETCRTC]);
+
+	uint32_t fb = state.crtc_fb;
+	check(label, video->update_timing(&b), "update_timing");
+	state = get_state();
+	check(label, state.crtc_mode.vtotal == b.vtotal && state.crtc_fb == fb, "update_timing didn't keep the frame buffer");
+
+	video->set_timing(&desktop);
+	state = get_state();
+	check(label, state.crtc_mode.hdisplay == 1024 && state.crtc_fb == state.console_fb, "desktop not restored");
+
+	check(label, video->delete_mode(&a) && video->delete_mode(&c) && get_state().modes == start.modes, "delete_mode");
+	release_backend(label, video);
+}
+
+//============================================================
+//  test_atomic
+//============================================================
+
+static void test_atomic()
+{
+	const char *label = "atomic";
+	modeline desktop = make_mode(1024, 768, 60, MODE_DESKTOP);
+	modeline a = make_mode(320, 240, 60), b = retime_mode(&a, 10);
+
+	// Without seamless changes, retiming falls back to a full modeset
+	drmkms_timing *video = make_backend(label, "", true);
+	if (!video)
+		return;
+
+	video->set_timing(&a);
+	fake_drm_state state = get_state();
+	check(label, state.crtc_mode.hdisplay == 320 && state.modesets == 1 && state.blobs == 1, "set_timing, %d modesets %d blobs", state.modesets, state.blobs);
+
+	video->update_timing(&b);
+	state = get_state();
+	check(label, state.crtc_mode.vtotal == b.vtotal && state.modesets == 2 && state.seamless == 0, "update_timing fallback, %d modesets", state.modesets);
+
+	// Horizontal changes go for the modeset at once, and the timings on screen need nothing
+	modeline c = b;
+	c.htotal += 8;
+	c.pclock += 24000;
+	unsigned int commits = state.calls[FAKE_DRM_COMMIT];
+	video->update_timing(&c);
+	video->update_timing(&c);
+	state = get_state();
+	check(label, state.crtc_mode.htotal == c.htotal && state.calls[FAKE_DRM_COMMIT] == commits + 1, "%u commits for a horizontal change", state.calls[FAKE_DRM_COMMIT] - commits);
+
+	video->set_timing(&desktop);
+	state = get_state();
+	check(label, state.crtc_fb == state.console_fb && state.blobs == 0, "desktop not restored, %d blobs", state.blobs);
+	release_backend(label, video);
+
+	// The driver takes the new vertical total on the fly
+	video = make_backend(label, "seamless=1", true);
+	if (!video)
+		return;
+
+	video->set_timing(&a);
+	video->update_timing(&b);
+	state = get_state();
+	check(label, state.crtc_mode.vtotal == b.vtotal && state.modesets == 1 && state.seamless == 1, "seamless update_timing, %d modesets", state.modesets);
+
+	video->set_timing(&desktop);
+	release_backend(label, video);
+
+	// A failed commit leaves the screen as it was
+	video = make_backend(label, "fail_commit=1", true);
+	if (!video)
+		return;
+
+	bool switched = video->set_timing(&a);
+	state = get_state();
+	check(label, !switched, "failed commit reported as a switch");
+	check(label, state.crtc_mode.hdisplay == 1024 && state.crtc_fb == state.console_fb, "failed commit changed the screen");
+
+	// The next switch doesn't take the failed mode for the one on screen
+	switched = video->set_timing(&a);
+	state = get_state();
+	check(label, switched && state.crtc_mode.hdisplay == 320, "no switch after a failed commit");
+
+	video->set_timing(&desktop);
+	release_backend(label, video);
+}
+
+//============================================================
+//  test_modelist
+//============================================================
+
+static void test_modelist()
+{
+	const char *label = "modelist";
+	modeline modes[] = { make_mode(320, 240, 60), make_mode(384, 224, 59.6), make_mode(256, 224, 60.1), make_mode(640, 480, 60) };
+	vector<modeline *> modelist;
+	for (auto &mode : modes)
+		modelist.push_back(&mode);
+
+	// The third mode can't be added, the first two are taken back
+	drmkms_timing *video = make_backend(label, "fail_attach=3,atomic=0", false);
+	if (!video)
+		return;
+
+	fake_drm_state start = get_state();
+	check(label, !video->process_modelist(modelist), "failure not reported");
+
+	const int expected[] = { MODELIST_ROLLED_BACK, MODELIST_ROLLED_BACK, MODELIST_FAILED, MODELIST_SKIPPED };
+	const vector<modelist_result> &results = video->modelist_results();
+	for (size_t i = 0; i < results.size() && i < 4; i++)
+		check(label, results.size() == 4 && results[i].status == expected[i], "mode %d status %d instead of %d", (int)i, results[i].status, expected[i]);
+	check(label, get_state().modes == start.modes, "%d modes left instead of %d", get_state().modes, start.modes);
+
+	// Once it goes through, they're all there
+	for (auto &mode : modes)
+		mode.type = MODE_ADD;
+	check(label, video->process_modelist(modelist) && get_state().modes == start.modes + 4, "modes not added");
+	release_backend(label, video);
+
+	// The driver rejects one of them in the atomic test, nothing is touched
+	for (auto &mode : modes)
+		mode.type = MODE_ADD;
+	modes[1].pclock = 200000000;
+
+	video = make_backend(label, "max_clock=100000", true);
+	if (!video)
+		return;
+
+	check(label, !video->process_modelist(modelist), "rejected mode not reported");
+	check(label, video->modelist_results()[1].status == MODELIST_FAILED && video->modelist_results()[0].status == MODELIST_SKIPPED, "rejected mode status");
+	check(label, get_state().modes == start.modes && get_state().calls[FAKE_DRM_ATTACH] == 0, "modes added after a rejection");
+	release_backend(label, video);
+
+	// Timings get_mode has tested already aren't tested again
+	modes[1] = make_mode(384, 224, 59.6);
+	video = make_backend(label, "", true);
+	if (!video)
+		return;
+
+	for (auto &mode : modes)
+	{
+		mode.type = MODE_ADD;
+		video->test_mode(&mode);
+	}
+	unsigned int commits = get_state().calls[FAKE_DRM_COMMIT];
+	bool applied = video->process_modelist(modelist);
+	commits = get_state().calls[FAKE_DRM_COMMIT] - commits;
+	check(label, applied && commits == 0, "%u modes tested again", commits);
+	release_backend(label, video);
+
+	// Same for a batch larger than a few modes, as sr_add_modes flushes them
+	vector<modeline> batch;
+	for (int i = 0; i < 40; i++)
+		batch.push_back(make_mode(256 + 8 * (i % 8), 224 + 16 * (i / 8), 59 + i * 0.05));
+	modelist.clear();
+	for (auto &mode : batch)
+		modelist.push_back(&mode);
+
+	video = make_backend(label, "", true);
+	if (!video)
+		return;
+
+	commits = get_state().calls[FAKE_DRM_COMMIT];
+	for (auto &mode : batch)
+		video->test_mode(&mode);
+	unsigned int tested = get_state().calls[FAKE_DRM_COMMIT] - commits;
+	commits = get_state().calls[FAKE_DRM_COMMIT];
+	applied = video->process_modelist(modelist);
+	commits = get_state().calls[FAKE_DRM_COMMIT] - commits;
+	check(label, tested == batch.size() && applied && commits == 0, "%u test commits, %u more to flush %d modes", tested, commits, (int)batch.size());
+	release_backend(label, video);
+}
+
+//============================================================
+//  test_framebuffers
+//============================================================
+
+static void test_framebuffers()
+{
+	const char *label = "framebuffers";
+	modeline desktop = make_mode(1024, 768, 60, MODE_DESKTOP);
+	modeline a = make_mode(320, 240, 60);
+
+	// Without a buffer of its own, the mode goes on the console one
+	drmkms_timing *video = make_backend(label, "fail_dumb=1,atomic=0", false);
+	if (!video)
+		return;
+
+	video->set_timing(&a);
+	fake_drm_state state = get_state();
+	check(label, state.crtc_mode.hdisplay == 320 && state.crtc_fb == state.console_fb && state.dumb_buffers == 0, "no fallback to the console buffer");
+
+	video->set_timing(&a);
+	state = get_state();
+	check(label, state.crtc_fb != state.console_fb && state.dumb_buffers == 1, "no buffer after the failure");
+
+	video->set_timing(&desktop);
+	release_backend(label, video);
+
+	// Without the desktop frame buffer, ours take the usual format
+	video = make_backend(label, "fail_getfb=1,atomic=0", false);
+	if (!video)
+		return;
+
+	bool switched = video->set_timing(&a);
+	int bpp = *(int *)video->get_resource(SR_RES_KMS_BPP);
+	state = get_state();
+	check(label, switched && state.crtc_fb != state.console_fb && bpp == 32, "no buffer without the desktop one, bpp %d", bpp);
+
+	video->set_timing(&desktop);
+	release_backend(label, video);
+
+	// A buffer that can't be added is destroyed right away
+	video = make_backend(label, "fail_addfb=1,atomic=0", false);
+	if (!video)
+		return;
+
+	video->set_timing(&a);
+	state = get_state();
+	check(label, state.crtc_fb == state.console_fb && state.dumb_buffers == 0, "dumb buffer leaked");
+
+	video->set_timing(&desktop);
+	release_backend(label, video);
+}
+
+//============================================================
+//  test_vrr
+//============================================================
+
+static void test_vrr()
+{
+	const char *label = "vrr";
+	modeline desktop = make_mode(1024, 768, 60, MODE_DESKTOP);
+	modeline a = make_mode(320, 240, 60);
+	double vrr_min = 0, vrr_max = 0;
+
+	drmkms_timing *video = make_backend(label, "vrr=1,edid=48-75", true, "auto");
+	if (!video)
+		return;
+
+	check(label, video->vrr_range(&vrr_min, &vrr_max) && vrr_min == 48 && vrr_max == 75, "EDID range %f-%f", vrr_min, vrr_max);
+
+	video->set_timing(&a);
+	check(label, get_state().vrr_enabled == 1, "not enabled with the mode");
+
+	video->set_timing(&desktop);
+	check(label, get_state().vrr_enabled == 0, "not disabled with the desktop");
+	release_backend(label, video);
+
+	video = make_backend(label, "vrr=1,edid=48-75", true, "40-100");
+	if (video)
+	{
+		check(label, video->vrr_range(&vrr_min, &vrr_max) && vrr_min == 40 && vrr_max == 100, "given range %f-%f", vrr_min, vrr_max);
+		release_backend(label, video);
+	}
+
+	video = make_backend(label, "vrr=0,edid=48-75", true, "auto");
+	if (video)
+	{
+		check(label, !video->vrr_range(&vrr_min, &vrr_max), "enabled on a connector that isn't vrr_capable");
+		release_backend(label, video);
+	}
+
+	video = make_backend(label, "vrr=1,edid=48-75,atomic=0", false, "auto");
+	if (video)
+	{
+		check(label, !video->vrr_range(&vrr_min, &vrr_max), "enabled without atomic modesetting");
+		release_backend(label, video);
+	}
+}
+
+//============================================================
+//  bench
+//============================================================
+
+static unsigned int total_calls()
+{
+	fake_drm_state state = get_state();
+	unsigned int calls = 0;
+	for (auto c : state.calls)
+		calls += c;
+
+	return calls;
+}
+
+// Mean time and device calls of the main operations, with the latencies given
+static void bench(const char *label, const string &config, bool atomic)
+{
+	const int count = 64;
+	modeline desktop = make_mode(1024, 768, 60, MODE_DESKTOP);
+	vector<modeline> modes;
+	vector<modeline *> modelist;
+	for (int i = 0; i < count; i++)
+		modes.push_back(make_mode(256 + 8 * (i % 16), 224 + 16 * (i / 16), 55 + i * 0.1));
+	for (auto &mode : modes)
+		modelist.push_back(&mode);
+
+	drmkms_timing *video = make_backend(label, config.c_str(), atomic);
+	if (!video)
+		return;
+
+	auto measure = [&](const char *name, int ops, function<void()> run)
+	{
+		unsigned int calls = total_calls();
+		auto start = chrono::steady_clock::now();
+		run();
+		double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+		printf("%s: %-16s %9.1f us, %5.1f device calls\n", label, name, us / ops, double(total_calls() - calls) / ops);
+	};
+
+	measure("add_mode", count, [&]() { for (auto &mode : modes) video->add_mode(&mode); });
+	measure("set_timing", count, [&]() { for (auto &mode : modes) video->set_timing(&mode); });
+	measure("update_timing", count, [&]() { for (auto &mode : modes) { modeline retimed = retime_mode(&mode, 2); video->update_timing(&retimed); } });
+	measure("delete_mode", count, [&]() { for (auto &mode : modes) video->delete_mode(&mode); });
+	measure("process_modelist", 1, [&]()
+	{
+		for (auto &mode : modes) mode.type = MODE_ADD;
+		video->process_modelist(modelist);
+		for (auto &mode : modes) mode.type = MODE_DELETE;
+		video->process_modelist(modelist);
+	});
+
+	video->set_timing(&desktop);
+	release_backend(label, video);
+}
+
+//============================================================
+//  main
+//============================================================
+
+int main(int argc, char **argv)
+{
+	// Loaded first, the stand-in is the one the backend gets when it opens libdrm.so
+	const char *library = argc > 1? argv[1] : "tests/libdrm.so";
+	void *fake_drm = dlopen(library, RTLD_NOW);
+	if (!fake_drm)
+	{
+		printf("Error: can't load %s: %s\n", library, dlerror());
+		return 1;
+	}
+
+	p_fake_drm_configure = (__typeof__(fake_drm_configure) *) dlsym(fake_drm, "fake_drm_configure");
+	p_fake_drm_get_state = (__typeof__(fake_drm_get_state) *) dlsym(fake_drm, "fake_drm_get_state");
+	if (!p_fake_drm_configure || !p_fake_drm_get_state || dlopen("libdrm.so", RTLD_NOW | RTLD_NOLOAD) != fake_drm)
+	{
+		printf("Error: %s isn't the stand-in libdrm\n", library);
+		return 1;
+	}
+
+	test_legacy();
+	test_atomic();
+	test_modelist();
+	test_framebuffers();
+	test_vrr();
+
+	// Extra options for the benchmark, e.g. latency_commit=16000
+	string latencies = argc > 2? argv[2] : "";
+	bench("bench legacy", "atomic=0," + latencies, false);
+	bench("bench atomic", latencies, true);
+
+	printf("drmkms: %lu checks, %lu failures\n", (unsigned long)checks, (unsigned long)failures);
+	return failures? 1 : 0;
+}
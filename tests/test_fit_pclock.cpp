@@ -0,0 +1,148 @@
+/**************************************************************
+
+   test_fit_pclock.cpp - Pixel clock granularity solver
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cmath>
+#include <vector>
+#include "../modeline.h"
+#include "test_common.h"
+
+using namespace std;
+
+static uint64_t fitted = 0;
+static uint64_t compared = 0;
+static uint64_t moved = 0;
+static double sum_plain_error = 0;
+static double sum_drift = 0;
+
+static void check(const char *preset, bool same, const modeline *mode, uint64_t step, const char *what)
+{
+	check(preset, same, "%s for %dx%d@%.6f, step %lu: %lu %d %d %d %d %d %d %d %d", what, mode->hactive, mode->vactive, mode->vfreq,
+		(unsigned long)step, (unsigned long)mode->pclock, mode->hactive, mode->hbegin, mode->hend, mode->htotal, mode->vactive, mode->vbegin, mode->vend, mode->vtotal);
+}
+
+//============================================================
+//  test_fit
+//============================================================
+
+// The fitted mode must keep its active and sync timings, use whole steps, and never
+// drift more than the plain rounding of its pclock to the nearest step would. Its
+// totals only move to halve that drift, by 1 ppm of the refresh at least
+static void test_fit(const char *preset, const modeline *created, const monitor_range *range, const generator_settings *cs)
+{
+	double scan_factor = (created->interlace? 2.0 : 1.0) * (created->doublescan? 0.5 : 1.0);
+	double target = created->vfreq;
+
+	modeline mode = *created;
+	if (modeline_fit_pclock(&mode, range, cs) != 0)
+		return;
+
+	uint64_t step = cs->pclock_step;
+	fitted++;
+	check(preset, mode.pclock % step == 0 && mode.pclock > cs->pclock_min, &mode, step, "pclock off the steps");
+	check(preset, mode.hactive == created->hactive && mode.hbegin == created->hbegin && mode.hend == created->hend &&
+		mode.vactive == created->vactive && mode.vbegin == created->vbegin && mode.vend == created->vend, &mode, step, "active or sync timings moved");
+	check(preset, mode.htotal > mode.hend && mode.vtotal > mode.vend && (mode.vtotal - created->vtotal) % (mode.interlace || mode.doublescan? 2 : 1) == 0,
+		&mode, step, "bad totals");
+
+	double vfreq = double(mode.pclock) / mode.htotal / mode.vtotal * scan_factor;
+	check(preset, fabs(mode.vfreq - vfreq) < 1e-9 * vfreq && fabs(mode.result.v_drift - (mode.vfreq - target)) < 1e-9, &mode, step, "wrong drift");
+
+	// The unmodified totals with the nearest pclock, when they're still in range
+	uint64_t plain = uint64_t(double(created->pclock) / step + 0.5) * step;
+	double hfreq = double(plain) / created->htotal;
+	double plain_vfreq = hfreq / created->vtotal * scan_factor;
+	if (plain > cs->pclock_min && hfreq >= min(range->hfreq_min, created->hfreq) && hfreq <= max(range->hfreq_max, created->hfreq) &&
+		plain_vfreq >= min(range->vfreq_min, target) && plain_vfreq <= max(range->vfreq_max, target))
+	{
+		check(preset, fabs(mode.result.v_drift) <= fabs(plain_vfreq - target) + 1e-12, &mode, step, "worse than plain rounding");
+		double gain = fabs(plain_vfreq - target) - fabs(mode.result.v_drift);
+		check(preset, (mode.htotal == created->htotal && mode.vtotal == created->vtotal) || (gain >= fabs(plain_vfreq - target) * 0.5 - 1e-12 && gain >= target * 1e-6 - 1e-12),
+			&mode, step, "totals moved for a small gain");
+		moved += mode.htotal != created->htotal || mode.vtotal != created->vtotal;
+		sum_plain_error += fabs(plain_vfreq - target);
+		sum_drift += fabs(mode.result.v_drift);
+		compared++;
+	}
+}
+
+//============================================================
+//  main
+//============================================================
+
+int main(int argc, char **argv)
+{
+	vector<corpus_request> corpus;
+	if (!load_corpus(argc > 1? argv[1] : "tests/bench_corpus.txt", corpus))
+		return 1;
+
+	vector<modeline> requests;
+	for (auto &line : corpus)
+	{
+		modeline request = {};
+		request.hactive = line.width;
+		request.vactive = line.height;
+		request.vfreq = line.refresh;
+		request.interlace = line.interlace;
+		requests.push_back(request);
+	}
+
+	const uint64_t steps[] = { 1, 1000, 10000, 100000 };
+	const monitor_preset *presets;
+	int preset_count = monitor_get_presets(&presets);
+
+	for (int settings = 0; settings < 4; settings++)
+	{
+		generator_settings cs = {};
+		cs.monitor_aspect = STANDARD_CRT_ASPECT;
+		cs.refresh_tolerance = 2.0;
+		cs.super_width = 2560;
+		cs.h_size = 1.0;
+		cs.interlace = 1;
+		cs.pixel_precision = settings & 1;
+		cs.doublescan = settings & 2;
+
+		for (int p = 0; p < preset_count; p++)
+		{
+			monitor_range range[MAX_RANGES] = {};
+			monitor_set_preset(presets[p].name, range);
+
+			for (int r = 0; r < MAX_RANGES && range[r].hfreq_min != 0; r++)
+				for (auto &request : requests)
+				{
+					modeline mode = {};
+					mode.type = XYV_EDITABLE | V_FREQ_EDITABLE | SCAN_EDITABLE;
+					mode.hactive = request.hactive;
+					mode.vactive = request.vactive;
+					mode.vfreq = request.vfreq;
+					mode.interlace = request.interlace;
+
+					if (modeline_create(&request, &mode, &range[r], &cs) != 0)
+						continue;
+
+					for (uint64_t step : steps)
+					{
+						cs.pclock_step = step;
+						test_fit(presets[p].name, &mode, &range[r], &cs);
+					}
+					cs.pclock_step = 0;
+				}
+		}
+	}
+
+	printf("fit_pclock: %lu checks, %lu modes fitted, %lu retimed, %lu failures, mean drift %.3g Hz vs %.3g Hz rounding the pclock\n", (unsigned long)checks,
+		(unsigned long)fitted, (unsigned long)moved, (unsigned long)failures, compared? sum_drift / compared : 0, compared? sum_plain_error / compared : 0);
+	return failures? 1 : 0;
+}
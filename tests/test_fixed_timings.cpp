@@ -0,0 +1,206 @@
+/**************************************************************
+
+   test_fixed_timings.cpp - Fixed-point vs double timing core
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "../modeline.h"
+#include "test_common.h"
+
+using namespace std;
+
+static uint64_t ties = 0;
+static double max_hfreq_diff = 0;
+static double max_vfreq_diff = 0;
+static int64_t max_pclock_diff = 0;
+
+//============================================================
+//  same_timings
+//============================================================
+
+// Integer timings must be the same, frequencies within the rounding of hfreq to the uHz
+static bool same_timings(int ret, const modeline *a, int fixed_ret, const modeline *b)
+{
+	if (ret != fixed_ret || a->hactive != b->hactive || a->hbegin != b->hbegin || a->hend != b->hend || a->htotal != b->htotal)
+		return false;
+
+	if (ret != 0)
+		return true;
+
+	return a->vactive == b->vactive && a->vbegin == b->vbegin && a->vend == b->vend && a->vtotal == b->vtotal &&
+		llabs(int64_t(a->pclock) - int64_t(b->pclock)) <= 1 && fabs(a->hfreq - b->hfreq) < 1e-6 && fabs(a->vfreq - b->vfreq) < 1e-9 * a->vfreq;
+}
+
+//============================================================
+//  check
+//============================================================
+
+// A different result is only fine when the double one changes with a nudge of the input,
+// because we're on a tie there and the fixed-point version can go either way
+static void check(const char *label, const modeline *input, const modeline *fixed_mode, int fixed_ret, function<int(modeline *)> create)
+{
+	modeline mode = *input;
+	int ret = create(&mode);
+	checks++;
+
+	if (same_timings(ret, &mode, fixed_ret, fixed_mode))
+	{
+		if (ret == 0)
+		{
+			max_pclock_diff = max(max_pclock_diff, (int64_t)llabs(int64_t(mode.pclock) - int64_t(fixed_mode->pclock)));
+			max_hfreq_diff = max(max_hfreq_diff, fabs(mode.hfreq - fixed_mode->hfreq));
+			max_vfreq_diff = max(max_vfreq_diff, fabs(mode.vfreq - fixed_mode->vfreq) / mode.vfreq);
+		}
+		return;
+	}
+
+	modeline lower = *input, upper = *input;
+	lower.vfreq *= 1 - 1e-9;
+	upper.vfreq *= 1 + 1e-9;
+	int lower_ret = create(&lower), upper_ret = create(&upper);
+
+	// On a tie, each value must be one the double version gives around it
+	if (!same_timings(lower_ret, &lower, ret, &mode) || !same_timings(upper_ret, &upper, ret, &mode))
+	{
+		auto any = [&](int modeline::*field) { return fixed_mode->*field == mode.*field || fixed_mode->*field == lower.*field || fixed_mode->*field == upper.*field; };
+		if ((fixed_ret == ret || fixed_ret == lower_ret || fixed_ret == upper_ret) && any(&modeline::hbegin) && any(&modeline::hend) &&
+			any(&modeline::htotal) && any(&modeline::vbegin) && any(&modeline::vend) && any(&modeline::vtotal))
+		{
+			ties++;
+			return;
+		}
+	}
+
+	if (report_failure())
+	{
+		printf("%s: mismatch for %dx%d@%.9f, returned %d / %d\n", label, input->hactive? input->hactive : input->width,
+			input->vactive? input->vactive : input->height, input->vfreq, ret, fixed_ret);
+		printf("  double: %lu %d %d %d %d %d %d %d %d %.9f %.9f\n", (unsigned long)mode.pclock, mode.hactive, mode.hbegin, mode.hend, mode.htotal,
+			mode.vactive, mode.vbegin, mode.vend, mode.vtotal, mode.hfreq, mode.vfreq);
+		printf("  fixed:  %lu %d %d %d %d %d %d %d %d %.9f %.9f\n", (unsigned long)fixed_mode->pclock, fixed_mode->hactive, fixed_mode->hbegin,
+			fixed_mode->hend, fixed_mode->htotal, fixed_mode->vactive, fixed_mode->vbegin, fixed_mode->vend, fixed_mode->vtotal, fixed_mode->hfreq, fixed_mode->vfreq);
+	}
+}
+
+//============================================================
+//  test_timings
+//============================================================
+
+// Both cores with the inputs modeline_create would give them, for every request and scan
+static void test_timings(const char *preset, const monitor_range *range, const corpus_request &request)
+{
+	const double scans[][2] = { { 1, 1 }, { 2, 1 }, { 1, 0.5 } };
+
+	for (int settings = 0; settings < 8; settings++)
+	{
+		generator_settings cs = {};
+		cs.interlace_force_even = settings & 1;
+		cs.v_shift_correct = settings & 2;
+		cs.pixel_precision = settings & 4;
+
+		int v_scale = scale_into_range(request.refresh, range->vfreq_min, range->vfreq_max);
+		double vfreq = v_scale? request.refresh * v_scale : range->vfreq_max;
+
+		for (auto &scan : scans)
+		{
+			double interlace = scan[0], doublescan = scan[1], scan_factor = interlace * doublescan;
+			int y_scale = interlace == 2?
+				(range->interlaced_lines_min? scale_into_range(request.height, range->interlaced_lines_min, range->interlaced_lines_max) : 0) :
+				scale_into_range(request.height, range->progressive_lines_min, range->progressive_lines_max);
+
+			if (!y_scale || (doublescan != 1 && y_scale % 2))
+				continue;
+
+			int vactive = request.height * y_scale * doublescan;
+			double borders = cs.v_shift_correct? (range->progressive_lines_max - vactive / interlace) * (1.0 / range->hfreq_min) / 2 : 0;
+			double vfreq_real = min(vfreq, max_vfreq_for_yres(vactive, range, borders, scan_factor));
+			double interlace_incr = !cs.interlace_force_even && interlace == 2? 0.5 : 0;
+			double vvt = total_lines_for_yres(vactive, vfreq_real, range, borders, scan_factor) + interlace_incr;
+
+			modeline input = {};
+			input.hactive = normalize(request.width * y_scale, cs.pixel_precision? 1 : 8);
+			input.vactive = vactive;
+			input.vfreq = vfreq_real;
+
+			modeline fixed_mode = input;
+			int fixed_ret = modeline_timings_fixed(&fixed_mode, range, &cs, vvt, borders, scan_factor, interlace);
+			check(preset, &input, &fixed_mode, fixed_ret, [&](modeline *mode) { return modeline_timings(mode, range, &cs, vvt, borders, scan_factor, interlace); });
+		}
+
+		// Stretched heights, from both ranges
+		for (int allowed = 0; allowed < 2; allowed++)
+		{
+			double interlace = 1, fixed_interlace = 1;
+			int yres = stretch_into_range(vfreq, range, 0, allowed, &interlace);
+			int fixed_yres = stretch_into_range_fixed(vfreq, range, 0, allowed, &fixed_interlace);
+
+			checks++;
+			if ((yres != fixed_yres || interlace != fixed_interlace) && report_failure())
+				printf("%s: stretch_into_range %d / %d for %f Hz\n", preset, yres, fixed_yres, vfreq);
+		}
+	}
+}
+
+//============================================================
+//  test_gtf
+//============================================================
+
+static void test_gtf(const corpus_request &request)
+{
+	for (int interlace = 0; interlace < 2; interlace++)
+	{
+		modeline input = {};
+		input.width = normalize(request.width, 8);
+		input.height = request.height;
+		input.vfreq = request.refresh;
+		input.interlace = interlace;
+
+		modeline fixed_mode = input;
+		modeline_vesa_gtf_fixed(&fixed_mode);
+		check("gtf", &input, &fixed_mode, true, modeline_vesa_gtf_double);
+	}
+}
+
+//============================================================
+//  main
+//============================================================
+
+int main(int argc, char **argv)
+{
+	vector<corpus_request> requests;
+	if (!load_corpus(argc > 1? argv[1] : "tests/bench_corpus.txt", requests))
+		return 1;
+
+	const monitor_preset *presets;
+	int preset_count = monitor_get_presets(&presets);
+
+	for (int p = 0; p < preset_count; p++)
+	{
+		monitor_range range[MAX_RANGES] = {};
+		monitor_set_preset(presets[p].name, range);
+
+		for (int i = 0; i < MAX_RANGES && range[i].hfreq_min != 0; i++)
+			for (auto &request : requests)
+				test_timings(presets[p].name, &range[i], request);
+	}
+
+	for (auto &request : requests)
+		test_gtf(request);
+
+	printf("fixed_timings: %lu checks, %lu ties, %lu failures, max diffs pclock %ld Hz, hfreq %.3g Hz, vfreq %.3g\n",
+		(unsigned long)checks, (unsigned long)ties, (unsigned long)failures, (long)max_pclock_diff, max_hfreq_diff, max_vfreq_diff);
+	return failures? 1 : 0;
+}
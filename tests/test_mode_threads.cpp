@@ -0,0 +1,157 @@
+/**************************************************************
+
+   test_mode_threads.cpp - Parallel vs serial mode search
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "../switchres.h"
+#include "test_common.h"
+
+using namespace std;
+
+// What get_mode returned for a request: the mode picked from the list and its timings
+typedef struct search_result
+{
+	ptrdiff_t index;
+	bool listed;      // one of the injected modes, not a new one
+	modeline mode;
+} search_result;
+
+//============================================================
+//  inject_modes
+//============================================================
+
+// A mode list like a backend would report: fixed modes, super resolutions and partly editable modes
+static size_t inject_modes(display_manager *display)
+{
+	const struct { int width, height; double vfreq; int interlace, type; } injected[] =
+	{
+		{ 640, 480, 60.0, 0, 0 }, { 640, 480, 59.94, 1, 0 }, { 320, 240, 60.0, 0, 0 }, { 720, 576, 50.0, 1, 0 },
+		{ 256, 224, 60.0, 0, V_FREQ_EDITABLE }, { 384, 288, 50.0, 0, V_FREQ_EDITABLE }, { 640, 480, 60.0, 1, V_FREQ_EDITABLE },
+		{ 2560, 240, 60.0, 0, X_RES_EDITABLE | V_FREQ_EDITABLE }, { 2560, 480, 60.0, 1, X_RES_EDITABLE | V_FREQ_EDITABLE },
+		{ 2560, 224, 60.0, 0, X_RES_EDITABLE | V_FREQ_EDITABLE }, { 320, 240, 60.0, 0, Y_RES_EDITABLE | V_FREQ_EDITABLE },
+		{ 800, 600, 60.0, 0, 0 }, { 1024, 768, 60.0, 0, 0 }, { 1280, 1024, 60.0, 0, 0 }, { 320, 240, 50.0, 0, 0 }
+	};
+
+	for (auto &m : injected)
+	{
+		modeline mode = {};
+		mode.type = m.type;
+		mode.hactive = mode.width = m.width;
+		mode.vactive = mode.height = m.height;
+		mode.vfreq = m.vfreq;
+		mode.refresh = int(m.vfreq);
+		mode.interlace = m.interlace;
+		mode.id = display->video_modes.size() + 1000;
+
+		display->video_modes.push_back(mode);
+		display->backup_modes.push_back(mode);
+	}
+
+	display->filter_modes();
+	return display->video_modes.size();
+}
+
+//============================================================
+//  search
+//============================================================
+
+static vector<search_result> search(const char *preset, int threads, const vector<corpus_request> &requests)
+{
+	switchres_manager switchres;
+	switchres.set_log_level(0);
+	switchres.display()->set_screen("dummy");
+	switchres.display()->set_monitor(preset);
+	switchres.display()->set_mode_threads(threads);
+
+	display_manager *display = switchres.add_display();
+	size_t listed = inject_modes(display);
+
+	vector<search_result> results;
+	for (auto &request : requests)
+	{
+		int flags = (request.interlace? SR_MODE_INTERLACED : 0) | (request.rotate? SR_MODE_ROTATED : 0);
+		modeline *mode = display->get_mode(request.width, request.height, request.refresh, flags);
+
+		search_result result = {};
+		result.index = mode != nullptr? mode - &display->video_modes[0] : -1;
+		result.listed = mode != nullptr && result.index < (ptrdiff_t)listed;
+		if (mode != nullptr)
+			result.mode = *mode;
+		results.push_back(result);
+
+		// Drop the new mode so every request starts from the same mode list
+		display->restore_modes();
+	}
+
+	return results;
+}
+
+//============================================================
+//  same_result
+//============================================================
+
+static bool same_result(const search_result &a, const search_result &b)
+{
+	const modeline &m = a.mode, &n = b.mode;
+	return a.index == b.index && m.pclock == n.pclock && m.hactive == n.hactive && m.hbegin == n.hbegin && m.hend == n.hend && m.htotal == n.htotal &&
+		m.vactive == n.vactive && m.vbegin == n.vbegin && m.vend == n.vend && m.vtotal == n.vtotal && m.interlace == n.interlace &&
+		m.doublescan == n.doublescan && m.vfreq == n.vfreq && m.hfreq == n.hfreq && m.id == n.id && m.type == n.type && m.range == n.range &&
+		!memcmp(&m.result, &n.result, sizeof(mode_result));
+}
+
+//============================================================
+//  main
+//============================================================
+
+int main(int argc, char **argv)
+{
+	vector<corpus_request> requests;
+	if (!load_corpus(argc > 1? argv[1] : "tests/bench_corpus.txt", requests))
+		return 1;
+
+	const monitor_preset *presets;
+	int preset_count = monitor_get_presets(&presets);
+	const int thread_counts[] = { 2, 4 };
+
+	// get_mode must pick the same mode with the same result, whatever the number of threads
+	uint64_t found = 0, listed = 0;
+	for (int p = 0; p < preset_count; p++)
+	{
+		const char *preset = presets[p].name;
+		vector<search_result> serial = search(preset, 0, requests);
+		for (auto &result : serial)
+		{
+			found += result.index != -1;
+			listed += result.listed;
+		}
+
+		for (int threads : thread_counts)
+		{
+			vector<search_result> parallel = search(preset, threads, requests);
+			for (size_t i = 0; i < requests.size(); i++)
+			{
+				const modeline &s = serial[i].mode, &t = parallel[i].mode;
+				check(preset, same_result(serial[i], parallel[i]), "%d threads, %dx%d@%f: mode %ld %dx%d@%f weight %d, serial mode %ld %dx%d@%f weight %d",
+					threads, requests[i].width, requests[i].height, requests[i].refresh, (long)parallel[i].index, t.hactive, t.vactive, t.vfreq, t.result.weight,
+					(long)serial[i].index, s.hactive, s.vactive, s.vfreq, s.result.weight);
+			}
+		}
+	}
+
+	printf("mode_threads: %lu checks, %lu modes found, %lu from the list, %lu failures\n", (unsigned long)checks, (unsigned long)found,
+		(unsigned long)listed, (unsigned long)failures);
+	return failures? 1 : 0;
+}
@@ -0,0 +1,274 @@
+/**************************************************************
+
+   test_modeline_batch.cpp - Batch kernels vs scalar functions
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "../modeline.h"
+#include "../candidate_table.h"
+#include "test_common.h"
+
+using namespace std;
+
+static const char *presets[] = { "generic_15", "arcade_15", "arcade_15ex", "arcade_25", "arcade_31", "arcade_15_25_31", "d9800", "pc_31_120", "pc_70_120", "vesa_1024" };
+
+static uint64_t bound_pairs = 0;
+static uint64_t perfect_pairs = 0;
+
+static double random_double(double min, double max)
+{
+	return min + (max - min) * (rand() / (double)RAND_MAX);
+}
+
+//============================================================
+//  test_kernels
+//============================================================
+
+// Each kernel against its scalar function, for the ranges of every preset
+static void test_kernels()
+{
+	const size_t count = 4096;
+	vector<int> ivalue(count), scale(count), lines(count), yres(count);
+	vector<double> dvalue(count), vfreq(count), borders(count), interlace(count), vfreq_max(count);
+	const double factors[] = { 0.5, 1.0, 2.0 };
+
+	srand(1);
+	for (const char *preset : presets)
+	{
+		monitor_range range[MAX_RANGES] = {};
+		monitor_set_preset(preset, range);
+
+		for (int r = 0; r < MAX_RANGES && range[r].hfreq_min != 0; r++)
+		{
+			monitor_range *rng = &range[r];
+
+			// Every height up to the limits, then refreshes around the edges of the range
+			for (size_t i = 0; i < count; i++)
+			{
+				ivalue[i] = 1 + i % 1200;
+				dvalue[i] = i < count / 2? random_double(1.0, 250.0) : rng->vfreq_min / (1 + i % 8) + (i % 3 - 1) * 1e-9;
+			}
+
+			scale_into_range_batch(ivalue.data(), rng->progressive_lines_min, rng->progressive_lines_max, scale.data(), count);
+			for (size_t i = 0; i < count; i++)
+				check(preset, scale[i] == scale_into_range(ivalue[i], rng->progressive_lines_min, rng->progressive_lines_max), "scale_into_range(%d)", ivalue[i]);
+
+			scale_into_range_batch(ivalue.data(), rng->interlaced_lines_min, rng->interlaced_lines_max, scale.data(), count);
+			for (size_t i = 0; i < count; i++)
+				check(preset, scale[i] == scale_into_range(ivalue[i], rng->interlaced_lines_min, rng->interlaced_lines_max), "scale_into_range(%d)", ivalue[i]);
+
+			scale_into_range_batch(dvalue.data(), rng->vfreq_min, rng->vfreq_max, scale.data(), count);
+			for (size_t i = 0; i < count; i++)
+				check(preset, scale[i] == scale_into_range(dvalue[i], rng->vfreq_min, rng->vfreq_max), "scale_into_range(%.17g)", dvalue[i]);
+
+			for (size_t i = 0; i < count; i++)
+			{
+				yres[i] = 1 + rand() % 1200;
+				vfreq[i] = random_double(rng->vfreq_min, rng->vfreq_max);
+				borders[i] = rand() % 2? random_double(0.0, 0.002) : 0.0;
+				interlace[i] = factors[rand() % 3];
+			}
+
+			total_lines_for_yres_batch(yres.data(), vfreq.data(), rng, borders.data(), interlace.data(), lines.data(), count);
+			max_vfreq_for_yres_batch(yres.data(), rng, borders.data(), interlace.data(), vfreq_max.data(), count);
+			for (size_t i = 0; i < count; i++)
+			{
+				check(preset, lines[i] == total_lines_for_yres(yres[i], vfreq[i], rng, borders[i], interlace[i]),
+					"total_lines_for_yres(%d, %.17g, %.17g, %g)", yres[i], vfreq[i], borders[i], interlace[i]);
+				check(preset, vfreq_max[i] == max_vfreq_for_yres(yres[i], rng, borders[i], interlace[i]),
+					"max_vfreq_for_yres(%d, %.17g, %g)", yres[i], borders[i], interlace[i]);
+			}
+		}
+	}
+}
+
+//============================================================
+//  test_table
+//============================================================
+
+// candidate_table bounds against modeline_lower_bound, mode by mode
+static void test_table()
+{
+	const int requests[][2] = { { 224, 288 }, { 256, 224 }, { 320, 240 }, { 384, 224 }, { 512, 448 }, { 640, 480 }, { 800, 600 }, { 1024, 768 } };
+	const double refreshes[] = { 25.0, 50.0, 53.2, 57.5, 59.94, 60.0, 61.0, 75.0, 120.0 };
+	const int types[] = { XYV_EDITABLE | SCAN_EDITABLE, XYV_EDITABLE, V_FREQ_EDITABLE, X_RES_EDITABLE | Y_RES_EDITABLE, Y_RES_EDITABLE, 0 };
+
+	generator_settings cs = {};
+	cs.monitor_aspect = STANDARD_CRT_ASPECT;
+	cs.refresh_tolerance = 2.0;
+	cs.super_width = 2560;
+	cs.h_size = 1.0;
+	cs.scale_proportional = 1;
+
+	for (int settings = 0; settings < 4; settings++)
+	{
+		cs.interlace = settings & 1;
+		cs.v_shift_correct = settings & 2;
+		cs.doublescan = settings == 3;
+
+		for (const char *preset : presets)
+		{
+			monitor_range range[MAX_RANGES] = {};
+			monitor_set_preset(preset, range);
+
+			for (auto &request : requests)
+			for (double refresh : refreshes)
+			{
+				modeline s_mode = {};
+				s_mode.hactive = request[0];
+				s_mode.vactive = request[1];
+				s_mode.vfreq = refresh;
+
+				candidate_table table;
+				vector<modeline> modes;
+				for (auto &target : requests)
+				for (double target_refresh : refreshes)
+				for (int type : types)
+				for (int interlace = 0; interlace < 2; interlace++)
+				{
+					modeline t_mode = {};
+					t_mode.type = type;
+					t_mode.interlace = interlace;
+					t_mode.hactive = type & X_RES_EDITABLE? s_mode.hactive : target[0];
+					t_mode.vactive = type & Y_RES_EDITABLE? s_mode.vactive : target[1];
+					t_mode.vfreq = type & V_FREQ_EDITABLE? s_mode.vfreq : target_refresh;
+					table.add(t_mode.hactive, t_mode.vactive, t_mode.vfreq, t_mode.interlace, t_mode.type);
+					modes.push_back(t_mode);
+				}
+
+				table.compute_bounds(&s_mode, range, &cs);
+				for (int r = 0; r < MAX_RANGES && range[r].hfreq_min != 0; r++)
+					for (size_t i = 0; i < modes.size(); i++)
+					{
+						int bound = modeline_lower_bound(&s_mode, &modes[i], &range[r], &cs);
+						check(preset, table.bound(r, i) == bound, "bound %d vs %d for %dx%d@%f type %d range %d",
+							table.bound(r, i), bound, modes[i].hactive, modes[i].vactive, modes[i].vfreq, modes[i].type, r);
+					}
+			}
+		}
+	}
+}
+
+//============================================================
+//  test_bounds
+//============================================================
+
+// The bounds must be sound, or get_mode would skip modes that win: no higher than the weight
+// modeline_create gives, out of range only when it is, and nothing beats a perfect match
+static void test_bounds(const vector<corpus_request> &requests)
+{
+	// A mode list as get_mode sees it: fixed modes, super resolutions, and the new mode entry
+	const struct { int width, height; double vfreq; int interlace, type; } injected[] =
+	{
+		{ 640, 480, 60.0, 0, 0 }, { 640, 480, 59.94, 1, 0 }, { 320, 240, 60.0, 0, 0 }, { 720, 576, 50.0, 1, 0 },
+		{ 256, 224, 60.0, 0, V_FREQ_EDITABLE }, { 384, 288, 50.0, 0, V_FREQ_EDITABLE }, { 640, 480, 60.0, 1, V_FREQ_EDITABLE },
+		{ 2560, 240, 60.0, 0, X_RES_EDITABLE | V_FREQ_EDITABLE }, { 2560, 480, 60.0, 1, X_RES_EDITABLE | V_FREQ_EDITABLE },
+		{ 0, 0, 0.0, 0, XYV_EDITABLE | SCAN_EDITABLE },
+		{ 2560, 224, 60.0, 0, X_RES_EDITABLE | V_FREQ_EDITABLE }, { 320, 240, 0.0, 0, Y_RES_EDITABLE | V_FREQ_EDITABLE },
+		{ 800, 600, 60.0, 0, 0 }, { 1024, 768, 60.0, 0, 0 }, { 1280, 1024, 60.0, 0, 0 }, { 320, 240, 50.0, 0, 0 }
+	};
+
+	generator_settings cs = {};
+	cs.monitor_aspect = STANDARD_CRT_ASPECT;
+	cs.refresh_tolerance = 2.0;
+	cs.super_width = 2560;
+	cs.h_size = 1.0;
+	cs.interlace = 1;
+
+	const monitor_preset *presets;
+	int preset_count = monitor_get_presets(&presets);
+
+	for (int settings = 0; settings < 2; settings++)
+	{
+		cs.doublescan = settings;
+		cs.v_shift_correct = settings;
+
+		for (int p = 0; p < preset_count; p++)
+		{
+			const char *preset = presets[p].name;
+			monitor_range range[MAX_RANGES] = {};
+			monitor_set_preset(preset, range);
+
+			for (auto &request : requests)
+			{
+				modeline s_mode = {};
+				s_mode.hactive = request.rotate? request.height : request.width;
+				s_mode.vactive = request.rotate? request.width : request.height;
+				s_mode.vfreq = float(request.refresh);
+				s_mode.interlace = request.interlace;
+				s_mode.type = request.rotate? MODE_ROTATED : 0;
+
+				// Every pair is created, in the order of the serial search
+				modeline best = {};
+				best.result.weight = R_OUT_OF_RANGE;
+				bool perfect = false;
+
+				for (auto &mode : injected)
+					for (int r = 0; r < MAX_RANGES && range[r].hfreq_min != 0; r++)
+					{
+						modeline t_mode = {};
+						t_mode.type = mode.type;
+						t_mode.interlace = mode.interlace;
+						t_mode.hactive = mode.type & X_RES_EDITABLE? s_mode.hactive : mode.width;
+						t_mode.vactive = mode.type & Y_RES_EDITABLE? s_mode.vactive : mode.height;
+						t_mode.vfreq = mode.type & V_FREQ_EDITABLE? s_mode.vfreq : mode.vfreq;
+
+						int bound = modeline_lower_bound(&s_mode, &t_mode, &range[r], &cs);
+						int ret = modeline_create(&s_mode, &t_mode, &range[r], &cs);
+						int weight = t_mode.result.weight;
+						bound_pairs++;
+
+						check(preset, bound <= weight, "bound %d above weight %d for %dx%d@%f on %dx%d@%f%s type %d range %d",
+							bound, weight, s_mode.hactive, s_mode.vactive, s_mode.vfreq, mode.width, mode.height, mode.vfreq, mode.interlace? "i" : "", mode.type, r);
+						if (bound & R_OUT_OF_RANGE)
+							check(preset, ret != 0 && (weight & R_OUT_OF_RANGE), "%dx%d@%f bound out of range on %dx%d@%f%s type %d range %d, weight %d",
+								s_mode.hactive, s_mode.vactive, s_mode.vfreq, mode.width, mode.height, mode.vfreq, mode.interlace? "i" : "", mode.type, r, weight);
+
+						if (perfect)
+						{
+							perfect_pairs++;
+							check(preset, !modeline_compare(&t_mode, &best), "%dx%d@%f on %dx%d@%f%s type %d range %d beats the perfect match %dx%d@%f",
+								s_mode.hactive, s_mode.vactive, s_mode.vfreq, mode.width, mode.height, mode.vfreq, mode.interlace? "i" : "", mode.type, r,
+								best.hactive, best.vactive, best.vfreq);
+						}
+						else if (modeline_compare(&t_mode, &best))
+						{
+							best = t_mode;
+							perfect = modeline_is_perfect(&s_mode, &best, &cs);
+						}
+					}
+			}
+		}
+	}
+}
+
+//============================================================
+//  main
+//============================================================
+
+int main(int argc, char **argv)
+{
+	vector<corpus_request> requests;
+	if (!load_corpus(argc > 1? argv[1] : "tests/bench_corpus.txt", requests))
+		return 1;
+
+	test_kernels();
+	test_table();
+	test_bounds(requests);
+
+	printf("modeline_batch: %lu checks, %lu bound pairs, %lu after a perfect match, %lu failures\n", (unsigned long)checks,
+		(unsigned long)bound_pairs, (unsigned long)perfect_pairs, (unsigned long)failures);
+	return failures? 1 : 0;
+}
@@ -0,0 +1,179 @@
+/**************************************************************
+
+   test_modeline_score.cpp - modeline_score vs modeline_compare
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include "../modeline.h"
+#include "test_common.h"
+
+using namespace std;
+
+static uint64_t skipped = 0;
+
+//============================================================
+//  check_pairs
+//============================================================
+
+// Every ordered pair must agree, unless modeline_score_comparable says it can't
+static void check_pairs(const char *label, vector<modeline> &modes)
+{
+	vector<modeline_score> scores(modes.size());
+	for (size_t i = 0; i < modes.size(); i++)
+		modeline_score_key(&modes[i], &scores[i]);
+
+	for (size_t i = 0; i < modes.size(); i++)
+		for (size_t j = 0; j < modes.size(); j++)
+		{
+			checks++;
+			if (!modeline_score_comparable(&scores[i], &scores[j]))
+			{
+				skipped++;
+				continue;
+			}
+
+			bool compare = modeline_compare(&modes[i], &modes[j]);
+			bool score = scores[i] < scores[j];
+
+			// modeline_score_better must always agree, it falls back to modeline_compare
+			bool better = modeline_score_better(&modes[i], &scores[i], &modes[j], &scores[j]);
+
+			if (compare != score || compare != better)
+			{
+				if (report_failure())
+				{
+					const mode_result *a = &modes[i].result, *b = &modes[j].result;
+					printf("%s: mismatch, compare %d score %d\n", label, compare, score);
+					printf("  t: weight %d hactive %d interlace %d scan %d x_scale %.17g y_scale %.17g x_diff %.17g y_diff %.17g v_diff %.17g\n",
+						a->weight, modes[i].hactive, modes[i].interlace, a->scan_penalty, a->x_scale, a->y_scale, a->x_diff, a->y_diff, a->v_diff);
+					printf("  b: weight %d hactive %d interlace %d scan %d x_scale %.17g y_scale %.17g x_diff %.17g y_diff %.17g v_diff %.17g\n",
+						b->weight, modes[j].hactive, modes[j].interlace, b->scan_penalty, b->x_scale, b->y_scale, b->x_diff, b->y_diff, b->v_diff);
+				}
+			}
+		}
+}
+
+//============================================================
+//  test_grid
+//============================================================
+
+// All the combinations of values around the edges of modeline_compare: ties, the 2/3
+// interlace factor, the rounding of xy diffs, signed zeros and vector modes
+static void test_grid()
+{
+	const int weights[] = { 0, R_V_FREQ_OFF, R_RES_STRETCH, R_OUT_OF_RANGE };
+	const int hactives[] = { 1, 2, 320 };
+	const double y_scales[] = { 1.0, 1.5, 2.0 };
+	const double x_diffs[] = { 0.0, 0.004, 0.006 };
+	const double y_diffs[] = { 0.0, 0.0049 };
+	const double x_scales[] = { 1.0, 1.5, 2.0 };
+	const double v_diffs[] = { -0.0, 0.0, 0.25, -0.5 };
+
+	vector<modeline> modes;
+	for (int weight : weights)
+	for (int interlace = 0; interlace < 2; interlace++)
+	for (int hactive : hactives)
+	for (double y_scale : y_scales)
+	for (int scan_penalty = 0; scan_penalty < 2; scan_penalty++)
+	for (double x_diff : x_diffs)
+	for (double y_diff : y_diffs)
+	for (double x_scale : x_scales)
+	for (double v_diff : v_diffs)
+	{
+		modeline mode = {};
+		mode.hactive = hactive;
+		mode.interlace = interlace;
+		mode.result.weight = weight;
+		mode.result.scan_penalty = scan_penalty;
+		mode.result.x_scale = x_scale;
+		mode.result.y_scale = y_scale;
+		mode.result.x_diff = x_diff;
+		mode.result.y_diff = y_diff;
+		mode.result.v_diff = v_diff;
+		modes.push_back(mode);
+	}
+
+	check_pairs("grid", modes);
+}
+
+//============================================================
+//  test_generated
+//============================================================
+
+// Candidates as get_mode sees them, for a few presets and requests
+static void test_generated()
+{
+	const char *presets[] = { "generic_15", "arcade_15", "arcade_15_25_31", "d9800", "pc_31_120", "vesa_1024" };
+	const int requests[][2] = { { 224, 288 }, { 256, 224 }, { 320, 240 }, { 384, 224 }, { 512, 448 }, { 640, 480 }, { 800, 600 }, { 1024, 768 } };
+	const double refreshes[] = { 50.0, 53.2, 57.5, 59.94, 60.0, 61.0, 75.0 };
+	const int types[] = { XYV_EDITABLE | SCAN_EDITABLE, V_FREQ_EDITABLE, X_RES_EDITABLE | Y_RES_EDITABLE, 0 };
+
+	generator_settings cs = {};
+	cs.interlace = 1;
+	cs.doublescan = 0;
+	cs.monitor_aspect = STANDARD_CRT_ASPECT;
+	cs.refresh_tolerance = 2.0;
+	cs.super_width = 2560;
+	cs.h_size = 1.0;
+	cs.scale_proportional = 1;
+
+	for (const char *preset : presets)
+	{
+		monitor_range range[MAX_RANGES] = {};
+		monitor_set_preset(preset, range);
+
+		for (auto &request : requests)
+		for (double refresh : refreshes)
+		{
+			modeline s_mode = {};
+			s_mode.hactive = request[0];
+			s_mode.vactive = request[1];
+			s_mode.vfreq = refresh;
+
+			// Target modes: the request itself, as editable, plus fixed modes from the other requests
+			vector<modeline> modes;
+			for (auto &target : requests)
+			for (int type : types)
+			for (int i = 0; i < MAX_RANGES; i++)
+			{
+				if (range[i].hfreq_min == 0)
+					continue;
+
+				modeline t_mode = {};
+				t_mode.type = type;
+				t_mode.hactive = type & X_RES_EDITABLE? s_mode.hactive : target[0];
+				t_mode.vactive = type & Y_RES_EDITABLE? s_mode.vactive : target[1];
+				t_mode.vfreq = type & V_FREQ_EDITABLE? s_mode.vfreq : 60.0;
+				modeline_create(&s_mode, &t_mode, &range[i], &cs);
+				modes.push_back(t_mode);
+			}
+
+			check_pairs(preset, modes);
+		}
+	}
+}
+
+//============================================================
+//  main
+//============================================================
+
+int main()
+{
+	test_grid();
+	test_generated();
+
+	printf("modeline_score: %lu pairs, %lu not comparable, %lu failures\n", (unsigned long)checks, (unsigned long)skipped, (unsigned long)failures);
+	return failures? 1 : 0;
+}
@@ -0,0 +1,108 @@
+/**************************************************************
+
+   worker_pool.cpp - Small thread pool for parallel loops
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#include "worker_pool.h"
+
+//============================================================
+//  worker_pool::worker_pool
+//============================================================
+
+worker_pool::worker_pool(int threads)
+{
+	// The calling thread is one of the workers
+	for (int i = 1; i < threads; i++)
+		m_threads.emplace_back(&worker_pool::worker, this);
+}
+
+//============================================================
+//  worker_pool::~worker_pool
+//============================================================
+
+worker_pool::~worker_pool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_quit = true;
+	}
+	m_start.notify_all();
+
+	for (auto &thread : m_threads)
+		thread.join();
+}
+
+//============================================================
+//  worker_pool::run
+//============================================================
+
+void worker_pool::run(int count, const std::function<void(int)> &job)
+{
+	if (m_threads.empty())
+	{
+		for (int i = 0; i < count; i++)
+			job(i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_job = &job;
+		m_count = count;
+		m_next = 0;
+		m_busy = m_threads.size();
+		m_generation++;
+	}
+	m_start.notify_all();
+
+	work();
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [this] { return m_busy == 0; });
+	m_job = nullptr;
+}
+
+//============================================================
+//  worker_pool::worker
+//============================================================
+
+void worker_pool::worker()
+{
+	unsigned int generation = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_start.wait(lock, [&] { return m_quit || m_generation != generation; });
+			if (m_quit)
+				return;
+			generation = m_generation;
+		}
+
+		work();
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (--m_busy == 0)
+			m_done.notify_one();
+	}
+}
+
+//============================================================
+//  worker_pool::work
+//============================================================
+
+void worker_pool::work()
+{
+	for (int i = m_next++; i < m_count; i = m_next++)
+		(*m_job)(i);
+}
@@ -0,0 +1,58 @@
+/**************************************************************
+
+   worker_pool.h - Small thread pool for parallel loops
+
+   ---------------------------------------------------------
+
+   Switchres   Modeline generation engine for emulation
+
+   License     GPL-2.0+
+   Copyright   2010-2021 Chris Kennedy, Antonio Giner,
+                         Alexandre Wodarczyk, Gil Delescluse
+
+ **************************************************************/
+
+#ifndef __WORKER_POOL_H__
+#define __WORKER_POOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class worker_pool
+{
+public:
+
+	worker_pool(int threads);
+	worker_pool(const worker_pool&) = delete;
+	worker_pool &operator=(const worker_pool&) = delete;
+	~worker_pool();
+
+	// Number of threads working on a job, including the caller's
+	int size() const { return (int)m_threads.size() + 1; }
+
+	// Call job(i) for every i in [0, count), in no particular order, and wait for all of them
+	void run(int count, const std::function<void(int)> &job);
+
+private:
+
+	std::vector<std::thread> m_threads;
+	std::mutex m_mutex;
+	std::condition_variable m_start;
+	std::condition_variable m_done;
+
+	const std::function<void(int)> *m_job = nullptr;
+	int m_count = 0;
+	std::atomic<int> m_next{0};
+	int m_busy = 0;
+	unsigned int m_generation = 0;
+	bool m_quit = false;
+
+	void worker();
+	void work();
+};
+
+#endif